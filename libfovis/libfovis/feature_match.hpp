@@ -90,14 +90,9 @@ class FeatureMatch
     KeypointData refined_target_keypoint;
 
     /**
-     * binary vector, one entry for every feature match.  Each entry is 1 if
-     * the motion according to this match is compatible with the motion
-     * according to the other match.
-     */
-    std::vector<int> consistency_vec;
-
-    /**
-     * number of 1s in consistency_vec
+     * number of other feature matches whose motion is compatible with the
+     * motion according to this match.  The pairwise compatibility graph
+     * itself is kept by MotionEstimator.
      */
     int compatibility_degree;
 
@@ -84,18 +84,30 @@ FeatureMatcher::matchFeatures(PyramidLevel* ref_level,
   // feature in the reference frame.
   // Match score is defined as the sum of absolute differences between two feature
   // descriptors.  Lower scores (less difference) are better.
+  //
+  // All of the candidates for a reference feature are scored in one batch so
+  // the SAD loop stays inside the vectorized code, then the book-keeping is
+  // updated in the same order as the candidate list.
+  const uint8_t* target_descs = target_level->getDescriptor(0);
+  int target_stride = target_level->getDescriptorStride();
   for (int ref_ind = 0; ref_ind < num_ref_features; ref_ind++) {
     const uint8_t * ref_desc = ref_level->getDescriptor(ref_ind);
 
     const std::vector<int>& ref_candidates(candidates[ref_ind]);
-    for (std::vector<int>::const_iterator ref_candidates_itr = ref_candidates.begin(),
-         ref_candidates_end = ref_candidates.end();
-         ref_candidates_itr != ref_candidates_end;
-         ++ref_candidates_itr) {
-      int target_ind = *ref_candidates_itr;
-      const uint8_t * target_desc = target_level->getDescriptor(target_ind);
-
-      int score = sad.score(ref_desc, target_desc);
+    int num_candidates = ref_candidates.size();
+    if (num_candidates == 0) {
+      continue;
+    }
+    if (num_candidates > static_cast<int>(_candidate_scores.size())) {
+      _candidate_scores.resize(num_candidates);
+    }
+    sad.scoreCandidates(ref_desc, target_descs, target_stride,
+                        &ref_candidates[0], num_candidates,
+                        &_candidate_scores[0]);
+
+    for (int i = 0; i < num_candidates; i++) {
+      int target_ind = ref_candidates[i];
+      int score = _candidate_scores[i];
       assert(score <= worst_score);
 
       // see if this score is the best for either descriptor
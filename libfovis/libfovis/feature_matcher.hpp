@@ -1,6 +1,8 @@
 #ifndef __fovis_feature_matcher_hpp__
 #define __fovis_feature_matcher_hpp__
 
+#include <vector>
+
 #include "feature_match.hpp"
 
 namespace fovis
@@ -55,6 +57,9 @@ private:
   int32_t* _ref_to_target_scores;
   int32_t* _target_to_ref_indices;
   int32_t* _target_to_ref_scores;
+
+  // SAD scores for the candidates of a single reference feature
+  std::vector<int32_t> _candidate_scores;
 };
 
 
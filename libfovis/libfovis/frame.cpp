@@ -13,6 +13,7 @@
 #include "depth_source.hpp"
 #include "internal_utils.hpp"
 #include "normalize_image.hpp"
+#include "task_pool.hpp"
 
 #include "tictoc.hpp"
 
@@ -63,10 +64,18 @@ OdometryFrame::OdometryFrame(const Rectification* rectification,
                                            grid_filter);
     _levels.push_back(level);
   }
+
+  // The calling thread handles the last level itself, so one worker per
+  // remaining level is enough to run them all at once
+  _task_pool = NULL;
+  if (_num_levels > 1) {
+    _task_pool = new TaskPool(_num_levels - 1);
+  }
 }
 
 OdometryFrame::~OdometryFrame()
 {
+  delete _task_pool;
   for (unsigned i=0; i<_levels.size(); i++)
     delete _levels[i];
   _levels.clear();
@@ -93,7 +102,15 @@ OdometryFrame::prepareFrame(const uint8_t* raw_gray,
 
   }
 
-  // compute image pyramid and detect initial features
+  // compute image pyramid and detect initial features.
+  //
+  // Only the downsampling has to happen in order, since each level is
+  // built from the one before it.  Once a level's image is ready, feature
+  // detection, bucketing and descriptor extraction for it are handed off to
+  // the task pool while this thread moves on to the next level.  Tasks only
+  // read their level's image, so downsampling from it at the same time is
+  // safe.
+  tictoc("extract_features");
   for (int level_num=0; level_num<_num_levels; level_num++) {
     PyramidLevel* level = _levels[level_num];
 
@@ -108,94 +125,115 @@ OdometryFrame::prepareFrame(const uint8_t* raw_gray,
           prev_level->_pyrbuf);
     }
 
-    level->_initial_keypoints.clear();
-    FAST(level->_raw_gray, level->_width, level->_height, level->_raw_gray_stride,
-        &level->_initial_keypoints, fast_threshold, 1);
+    if (_task_pool && level_num < _num_levels - 1) {
+      _task_pool->submit(std::bind(&OdometryFrame::extractLevelFeatures, this,
+                                   level_num, fast_threshold, depth_source));
+    } else {
+      extractLevelFeatures(level_num, fast_threshold, depth_source);
+    }
+  }
+  if (_task_pool) {
+    _task_pool->wait();
+  }
+  tictoc("extract_features");
 
-    // Keep track of this number before filtering out keyoints with the
-    // grid bucketing, to use it as a signal for FAST threshold adjustment.
-    level->_num_detected_keypoints = static_cast<int>(level->_initial_keypoints.size());
+  // populate 3D position for descriptors. Depth calculation may fail for some
+  // of these keypoints.
+  depth_source->getXyz(this);
 
-    if (_use_bucketing) {
-      tictoc("bucketing");
-      level->_grid_filter.filter(&level->_initial_keypoints);
-      tictoc("bucketing");
-    }
+  // Get rid of keypoints with no depth.
+  purgeBadKeypoints();
 
-    level->_num_keypoints = 0;
+}
 
-    int num_kp_candidates = level->_initial_keypoints.size();
+/**
+ * Detect, bucket and describe the features in a single pyramid level.  The
+ * level's image must already be computed.  Touches nothing outside the
+ * level, so it can run for several levels in parallel.
+ */
+void
+OdometryFrame::extractLevelFeatures(int level_num, int fast_threshold,
+                                    DepthSource* depth_source)
+{
+  PyramidLevel* level = _levels[level_num];
 
-    // increase buffer size if needed
-    if (num_kp_candidates > level->_keypoints_capacity) {
-      level->increase_capacity(static_cast<int>(num_kp_candidates*1.2));
-    }
+  level->_initial_keypoints.clear();
+  FAST(level->_raw_gray, level->_width, level->_height, level->_raw_gray_stride,
+      &level->_initial_keypoints, fast_threshold, 1);
 
-    int min_dist_from_edge = (_feature_window_size - 1) / 2 + 1;
-    int min_x = min_dist_from_edge;
-    int min_y = min_dist_from_edge;
-    int max_x = level->_width - (min_dist_from_edge + 1);
-    int max_y = level->_height - (min_dist_from_edge + 1);
-
-    // filter the keypoint candidates, and compute derived data
-    for (int kp_ind=0; kp_ind<num_kp_candidates; kp_ind++) {
-      KeyPoint& kp_cand = level->_initial_keypoints[kp_ind];
-
-      // ignore features too close to border
-      if(kp_cand.u < min_x || kp_cand.u > max_x || kp_cand.v < min_y ||
-         kp_cand.v > max_y)
-        continue;
-
-      KeypointData kpdata;
-      kpdata.kp = kp_cand;
-      kpdata.base_uv(0) = kp_cand.u * (1 << level_num);
-      kpdata.base_uv(1) = kp_cand.v * (1 << level_num);
-      kpdata.pyramid_level = level_num;
-
-      assert(kpdata.base_uv(0) >= 0);
-      assert(kpdata.base_uv(1) < _orig_width);
-      assert(kpdata.base_uv(0) >= 0);
-      assert(kpdata.base_uv(1) < _orig_height);
-
-      // lookup rectified pixel coordinates
-      int pixel_index = static_cast<int>(kpdata.base_uv(1) * _orig_width + kpdata.base_uv(0));
-      _rectification->rectifyLookupByIndex(pixel_index, &kpdata.rect_base_uv);
-
-      // Ignore the points that fall
-      // outside the original image region when undistorted.
-      if (kpdata.rect_base_uv(0) < 0 || kpdata.rect_base_uv(0) >= _orig_width ||
-          kpdata.rect_base_uv(1) < 0 || kpdata.rect_base_uv(1) >= _orig_height) {
-        continue;
-      }
+  // Keep track of this number before filtering out keyoints with the
+  // grid bucketing, to use it as a signal for FAST threshold adjustment.
+  level->_num_detected_keypoints = static_cast<int>(level->_initial_keypoints.size());
 
-      // ignore features with unknown depth
-      int du = static_cast<int>(kpdata.rect_base_uv(0)+0.5);
-      int dv = static_cast<int>(kpdata.rect_base_uv(1)+0.5);
-      if (!depth_source->haveXyz(du, dv)) { continue; }
+  if (_use_bucketing) {
+    level->_grid_filter.filter(&level->_initial_keypoints);
+  }
 
-      // We will calculate depth of all the keypoints later
-      kpdata.xyzw = Eigen::Vector4d(NAN, NAN, NAN, NAN);
-      kpdata.has_depth = false;
-      kpdata.keypoint_index = level->_num_keypoints;
+  level->_num_keypoints = 0;
 
-      kpdata.track_id = -1; //hasn't been associated with a track yet
+  int num_kp_candidates = level->_initial_keypoints.size();
 
-      level->_keypoints[level->_num_keypoints] = kpdata;
-      level->_num_keypoints++;
+  // increase buffer size if needed
+  if (num_kp_candidates > level->_keypoints_capacity) {
+    level->increase_capacity(static_cast<int>(num_kp_candidates*1.2));
+  }
+
+  int min_dist_from_edge = (_feature_window_size - 1) / 2 + 1;
+  int min_x = min_dist_from_edge;
+  int min_y = min_dist_from_edge;
+  int max_x = level->_width - (min_dist_from_edge + 1);
+  int max_y = level->_height - (min_dist_from_edge + 1);
+
+  // filter the keypoint candidates, and compute derived data
+  for (int kp_ind=0; kp_ind<num_kp_candidates; kp_ind++) {
+    KeyPoint& kp_cand = level->_initial_keypoints[kp_ind];
+
+    // ignore features too close to border
+    if(kp_cand.u < min_x || kp_cand.u > max_x || kp_cand.v < min_y ||
+       kp_cand.v > max_y)
+      continue;
+
+    KeypointData kpdata;
+    kpdata.kp = kp_cand;
+    kpdata.base_uv(0) = kp_cand.u * (1 << level_num);
+    kpdata.base_uv(1) = kp_cand.v * (1 << level_num);
+    kpdata.pyramid_level = level_num;
+
+    assert(kpdata.base_uv(0) >= 0);
+    assert(kpdata.base_uv(1) < _orig_width);
+    assert(kpdata.base_uv(0) >= 0);
+    assert(kpdata.base_uv(1) < _orig_height);
+
+    // lookup rectified pixel coordinates
+    int pixel_index = static_cast<int>(kpdata.base_uv(1) * _orig_width + kpdata.base_uv(0));
+    _rectification->rectifyLookupByIndex(pixel_index, &kpdata.rect_base_uv);
+
+    // Ignore the points that fall
+    // outside the original image region when undistorted.
+    if (kpdata.rect_base_uv(0) < 0 || kpdata.rect_base_uv(0) >= _orig_width ||
+        kpdata.rect_base_uv(1) < 0 || kpdata.rect_base_uv(1) >= _orig_height) {
+      continue;
     }
 
-    // extract features
-    level->populateDescriptorsAligned(level->_keypoints, level->_num_keypoints,
-                                      level->_descriptors);
-  }
+    // ignore features with unknown depth
+    int du = static_cast<int>(kpdata.rect_base_uv(0)+0.5);
+    int dv = static_cast<int>(kpdata.rect_base_uv(1)+0.5);
+    if (!depth_source->haveXyz(du, dv)) { continue; }
 
-  // populate 3D position for descriptors. Depth calculation may fail for some
-  // of these keypoints.
-  depth_source->getXyz(this);
+    // We will calculate depth of all the keypoints later
+    kpdata.xyzw = Eigen::Vector4d(NAN, NAN, NAN, NAN);
+    kpdata.has_depth = false;
+    kpdata.keypoint_index = level->_num_keypoints;
 
-  // Get rid of keypoints with no depth.
-  purgeBadKeypoints();
+    kpdata.track_id = -1; //hasn't been associated with a track yet
+
+    level->_keypoints[level->_num_keypoints] = kpdata;
+    level->_num_keypoints++;
+  }
 
+  // extract features
+  level->populateDescriptorsAligned(level->_keypoints, level->_num_keypoints,
+                                    level->_descriptors);
 }
 
 /**
@@ -20,6 +20,7 @@ namespace fovis
 class CameraIntrinsics;
 class Rectification;
 class DepthSource;
+class TaskPool;
 
 /**
  * @ingroup FovisCore
@@ -76,6 +77,9 @@ class OdometryFrame
 
     void purgeBadKeypoints();
 
+    void extractLevelFeatures(int level_num, int fast_threshold,
+                              DepthSource* depth_source);
+
     int _orig_width;
     int _orig_height;
 
@@ -88,6 +92,10 @@ class OdometryFrame
     const Rectification* _rectification;
 
     std::vector<PyramidLevel*> _levels;
+
+    // Runs feature detection and descriptor extraction for each pyramid
+    // level in parallel.  NULL if there's only one level.
+    TaskPool* _task_pool;
 };
 
 }
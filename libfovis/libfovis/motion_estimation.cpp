@@ -54,6 +54,7 @@ MotionEstimator::MotionEstimator(const Rectification* rectification,
   _matches = NULL;
   _num_matches = 0;
   _matches_capacity = 0;
+  _consistency_words = 0;
   _num_tracks = 0;
   _num_frames = 0;
 
@@ -338,6 +339,10 @@ void MotionEstimator::matchFeatures(PyramidLevel* ref_level, PyramidLevel* targe
 
 }
 
+#ifndef USE_ROBUST_STEREO_COMPATIBILITY
+static inline double sqr(double x) { return x * x; }
+#endif
+
 // used for sorting feature matches.
 static bool consistencyCompare(const FeatureMatch &ca, const FeatureMatch& cb)
 {
@@ -353,36 +358,41 @@ static bool consistencyCompare(const FeatureMatch &ca, const FeatureMatch& cb)
 
 static inline double sqr(double x) { return x * x; }
 
+// Points are passed as separate coordinates so the compatibility loop in
+// computeMaximallyConsistentClique can work straight from flat arrays and be
+// vectorized by the compiler.
 static inline
 double robustStereoCompatibility_computeDL(double L,
-                                           const  Eigen::Vector3d & p1,
-                                           const  Eigen::Vector3d & p2,
+                                           double p1x, double p1y, double p1z,
+                                           double p2x, double p2y, double p2z,
                                            double t, double f, double De)
 {
-  double A = sqr((p1(0) - p2(0)) * (t - p1(0)) - (p1(1) - p2(1)) * p1(1) - (p1(2) - p2(2)) * p1(2));
-  double B = sqr((p1(0) - p2(0)) * p1(0) + (p1(1) - p2(1)) * p1(1) + (p1(2) - p2(2)) * p1(2));
-  double C = 0.5 * sqr(t * (p1(1) - p2(1)));
-  double D = sqr((p1(0) - p2(0)) * (t - p2(0)) - (p1(1) - p2(1)) * p2(1) - (p1(2) - p2(2)) * p2(2));
-  double E = sqr((p1(0) - p2(0)) * p2(0) + (p1(1) - p2(1)) * p2(1) + (p1(2) - p2(2)) * p2(2));
-  double F = 0.5 * sqr(t * (p1(1) - p2(1)));
-  return De / (L * f * t) * sqrt(sqr(p1(2)) * (A + B + C) + sqr(p2(2)) * (D + E + F));
+  double A = sqr((p1x - p2x) * (t - p1x) - (p1y - p2y) * p1y - (p1z - p2z) * p1z);
+  double B = sqr((p1x - p2x) * p1x + (p1y - p2y) * p1y + (p1z - p2z) * p1z);
+  double C = 0.5 * sqr(t * (p1y - p2y));
+  double D = sqr((p1x - p2x) * (t - p2x) - (p1y - p2y) * p2y - (p1z - p2z) * p2z);
+  double E = sqr((p1x - p2x) * p2x + (p1y - p2y) * p2y + (p1z - p2z) * p2z);
+  double F = 0.5 * sqr(t * (p1y - p2y));
+  return De / (L * f * t) * sqrt(sqr(p1z) * (A + B + C) + sqr(p2z) * (D + E + F));
 }
 
 static inline bool
-robustStereoCompatibility(const Eigen::Vector3d & C1,
-                          const Eigen::Vector3d & C2,
-                          const Eigen::Vector3d & P1,
-                          const Eigen::Vector3d & P2,
+robustStereoCompatibility(double c1x, double c1y, double c1z,
+                          double c2x, double c2y, double c2z,
+                          double p1x, double p1y, double p1z,
+                          double p2x, double p2y, double p2z,
                           double baseline,
                           double focal_length,
                           double De)
 {
   //compute the L quantities (ie dist between pairs of points)
-  double L1 = (C2-C1).norm();
-  double L2 = (P2-P1).norm();
+  double L1 = sqrt(sqr(c2x - c1x) + sqr(c2y - c1y) + sqr(c2z - c1z));
+  double L2 = sqrt(sqr(p2x - p1x) + sqr(p2y - p1y) + sqr(p2z - p1z));
   //compute the DLs (delta L)
-  double DL1 = robustStereoCompatibility_computeDL(L1, C1, C2, baseline, focal_length, De);
-  double DL2 = robustStereoCompatibility_computeDL(L2, P1, P2, baseline, focal_length, De);
+  double DL1 = robustStereoCompatibility_computeDL(L1, c1x, c1y, c1z, c2x, c2y, c2z,
+                                                   baseline, focal_length, De);
+  double DL2 = robustStereoCompatibility_computeDL(L2, p1x, p1y, p1z, p2x, p2y, p2z,
+                                                   baseline, focal_length, De);
   return (fabs(L1-L2) <= 3*sqrt(sqr(DL1)+sqr(DL2)));
 }
 #endif
@@ -392,9 +402,43 @@ void MotionEstimator::computeMaximallyConsistentClique()
   if (!_num_matches)
     return;
 
-  for (int m_ind = 0; m_ind < _num_matches; m_ind++) {
-    FeatureMatch& match = _matches[m_ind];
-    match.consistency_vec.resize(_num_matches);
+  const int num_matches = _num_matches;
+
+  // The consistency graph is stored as one bitset row per match, indexed by
+  // match id.  Bit j of row i is set if matches i and j are consistent.
+  const int num_words = (num_matches + 63) / 64;
+  _consistency_words = num_words;
+  _consistency_bits.assign(static_cast<size_t>(num_matches) * num_words, 0);
+
+  // Copy the 3D points out into flat arrays so the pairwise checks below
+  // run over contiguous memory and can be vectorized.
+  _clique_points.resize(6 * num_matches);
+  double* ref_x = &_clique_points[0];
+  double* ref_y = ref_x + num_matches;
+  double* ref_z = ref_y + num_matches;
+  double* target_x = ref_z + num_matches;
+  double* target_y = target_x + num_matches;
+  double* target_z = target_y + num_matches;
+  _clique_at_infinity.resize(2 * num_matches);
+  uint8_t* ref_infinity = &_clique_at_infinity[0];
+  uint8_t* target_infinity = ref_infinity + num_matches;
+  _clique_row.resize(num_matches);
+  uint8_t* consistent = &_clique_row[0];
+
+  for (int m_ind = 0; m_ind < num_matches; m_ind++) {
+    const FeatureMatch& match = _matches[m_ind];
+    assert(match.id == m_ind);
+    const Eigen::Vector3d& ref_xyz = match.ref_keypoint->xyz;
+    const Eigen::Vector3d& target_xyz = match.refined_target_keypoint.xyz;
+    ref_x[m_ind] = ref_xyz(0);
+    ref_y[m_ind] = ref_xyz(1);
+    ref_z[m_ind] = ref_xyz(2);
+    target_x[m_ind] = target_xyz(0);
+    target_y[m_ind] = target_xyz(1);
+    target_z[m_ind] = target_xyz(2);
+    // are the features points at infinity?
+    ref_infinity[m_ind] = match.ref_keypoint->xyzw.w() < 1e-9;
+    target_infinity[m_ind] = match.refined_target_keypoint.xyzw.w() < 1e-9;
   }
 
 #ifdef USE_ROBUST_STEREO_COMPATIBILITY
@@ -404,6 +448,7 @@ void MotionEstimator::computeMaximallyConsistentClique()
   const CameraIntrinsicsParameters& rparams = _rectification->getRectifiedCameraParameters();
   double stereo_focal_length = rparams.fx;
 #endif
+  const double threshold = _clique_inlier_threshold;
 
   // For each pair of matches, compute the distance between features in the
   // reference frame, and the distance between features in the target frame.
@@ -413,61 +458,59 @@ void MotionEstimator::computeMaximallyConsistentClique()
   //
   // If the depth comes from a stereo camera, then apply a consistency metric that
   // allows for disparity error resulting from the stereo baseline.
+  for (int m_ind = 0; m_ind < num_matches; m_ind++) {
+    const double rx = ref_x[m_ind], ry = ref_y[m_ind], rz = ref_z[m_ind];
+    const double tx = target_x[m_ind], ty = target_y[m_ind], tz = target_z[m_ind];
 
-  // FIXME using both homogeneous and cartesian coordinates is a bit gross here...
-  for (int m_ind = 0; m_ind < _num_matches; m_ind++) {
-    FeatureMatch& match = _matches[m_ind];
-
-    const Eigen::Vector4d& ref_xyzw_1 = match.ref_keypoint->xyzw;
-    const Eigen::Vector4d& target_xyzw_1 = match.refined_target_keypoint.xyzw;
-    const Eigen::Vector3d& ref_xyz_1 = match.ref_keypoint->xyz;
-    const Eigen::Vector3d& target_xyz_1 = match.refined_target_keypoint.xyz;
-    assert(match.id == m_ind);
-
-    // are the features points at infinity?
-    bool ref_infinity = ref_xyzw_1.w() < 1e-9;
-    bool target_infinity = target_xyzw_1.w() < 1e-9;
-
-    for (int m_ind2 = m_ind + 1; m_ind2 < _num_matches; m_ind2++) {
-      FeatureMatch& match2 = _matches[m_ind2];
-      assert(match2.id == m_ind2);
-      const Eigen::Vector4d& ref_xyzw_2 = match2.ref_keypoint->xyzw;
-      const Eigen::Vector4d& target_xyzw_2 = match2.refined_target_keypoint.xyzw;
-      const Eigen::Vector3d& ref_xyz_2 = match2.ref_keypoint->xyz;
-      const Eigen::Vector3d& target_xyz_2 = match2.refined_target_keypoint.xyz;
-
-      bool consistent;
-      // special case:  if either of the features are points at infinity, then
-      // we can't compare their distances.
-      if((ref_infinity && ref_xyzw_2.w() < 1e-9) ||
-         (target_infinity && target_xyzw_2.w() < 1e-9)) {
-        consistent = true;
-      } else {
 #ifdef USE_ROBUST_STEREO_COMPATIBILITY
-        if (have_baseline) {
-          consistent = robustStereoCompatibility(ref_xyz_1, ref_xyz_2,
-                                                 target_xyz_1 ,target_xyz_2,
-                                                 baseline, stereo_focal_length,
-                                                 _clique_inlier_threshold);
-        } else {
-          double ref_dist = (ref_xyz_2 - ref_xyz_1).norm();
-          double target_dist = (target_xyz_2 - target_xyz_1).norm();
-          consistent = fabs(ref_dist - target_dist) < _clique_inlier_threshold;
-        }
-#else
-        double ref_dist = (ref_xyz_2 - ref_xyz_1).norm();
-        double target_dist = (target_xyz_2 - target_xyz_1).norm();
-        consistent = fabs(ref_dist - target_dist) < _clique_inlier_threshold;
+    if (have_baseline) {
+      for (int m_ind2 = m_ind + 1; m_ind2 < num_matches; m_ind2++) {
+        consistent[m_ind2] = robustStereoCompatibility(
+            rx, ry, rz, ref_x[m_ind2], ref_y[m_ind2], ref_z[m_ind2],
+            tx, ty, tz, target_x[m_ind2], target_y[m_ind2], target_z[m_ind2],
+            baseline, stereo_focal_length, threshold);
+      }
+    } else
 #endif
+    {
+      for (int m_ind2 = m_ind + 1; m_ind2 < num_matches; m_ind2++) {
+        double ref_dist = sqrt(sqr(ref_x[m_ind2] - rx) +
+                               sqr(ref_y[m_ind2] - ry) +
+                               sqr(ref_z[m_ind2] - rz));
+        double target_dist = sqrt(sqr(target_x[m_ind2] - tx) +
+                                  sqr(target_y[m_ind2] - ty) +
+                                  sqr(target_z[m_ind2] - tz));
+        consistent[m_ind2] = fabs(ref_dist - target_dist) < threshold;
       }
+    }
 
-      if (consistent) {
-        match.consistency_vec[match2.id] = 1;
-        match.compatibility_degree++;
-        match2.consistency_vec[match.id] = 1;
-        match2.compatibility_degree++;
+    // special case:  if either of the features are points at infinity, then
+    // we can't compare their distances.
+    if (ref_infinity[m_ind] || target_infinity[m_ind]) {
+      for (int m_ind2 = m_ind + 1; m_ind2 < num_matches; m_ind2++) {
+        if ((ref_infinity[m_ind] && ref_infinity[m_ind2]) ||
+            (target_infinity[m_ind] && target_infinity[m_ind2]))
+          consistent[m_ind2] = 1;
       }
     }
+
+    // pack the results into the graph, both directions
+    uint64_t* row = consistencyRow(m_ind);
+    for (int m_ind2 = m_ind + 1; m_ind2 < num_matches; m_ind2++) {
+      if (consistent[m_ind2]) {
+        row[m_ind2 >> 6] |= uint64_t(1) << (m_ind2 & 63);
+        consistencyRow(m_ind2)[m_ind >> 6] |= uint64_t(1) << (m_ind & 63);
+      }
+    }
+  }
+
+  // degree of each match is the number of bits set in its row
+  for (int m_ind = 0; m_ind < num_matches; m_ind++) {
+    const uint64_t* row = consistencyRow(m_ind);
+    int degree = 0;
+    for (int w = 0; w < num_words; w++)
+      degree += __builtin_popcountll(row[w]);
+    _matches[m_ind].compatibility_degree = degree;
   }
 
   // sort the features based on their consistency with other features
@@ -480,14 +523,16 @@ void MotionEstimator::computeMaximallyConsistentClique()
   _num_inliers = 1;
 
   // start a list of quick-reject features (features that are known to be
-  // inconsistent with any of the existing inliers)
-  int reject[_num_matches];
-  std::fill(reject, reject+_num_matches, 0);
-  for (int m_ind = 1; m_ind < _num_matches; m_ind++) {
-    int other_id = _matches[m_ind].id;
-    if (!best_candidate.consistency_vec[other_id])
-      reject[other_id] = 1;
-  }
+  // inconsistent with any of the existing inliers).  This is also a bitset
+  // indexed by match id, so rejecting everything inconsistent with a new
+  // inlier is a word-wise OR with the complement of its row.  Setting the
+  // reject bit on matches already visited is harmless since they aren't
+  // looked at again.
+  _clique_reject.resize(num_words);
+  uint64_t* reject = &_clique_reject[0];
+  const uint64_t* best_row = consistencyRow(best_candidate.id);
+  for (int w = 0; w < num_words; w++)
+    reject[w] = ~best_row[w];
 
   // now start adding inliers that are consistent with all existing
   // inliers
@@ -501,7 +546,7 @@ void MotionEstimator::computeMaximallyConsistentClique()
       break;
 
     // skip if it's a quick reject
-    if (reject[cand.id])
+    if (reject[cand.id >> 6] & (uint64_t(1) << (cand.id & 63)))
       continue;
 
     cand.in_maximal_clique = true;
@@ -509,11 +554,9 @@ void MotionEstimator::computeMaximallyConsistentClique()
     _num_inliers++;
 
     // mark some more features for rejection
-    for (int r_ind = m_ind + 1; r_ind < _num_matches; r_ind++) {
-      int other_id = _matches[r_ind].id;
-      if (!reject[other_id] && !cand.consistency_vec[other_id])
-        reject[other_id] = 1;
-    }
+    const uint64_t* cand_row = consistencyRow(cand.id);
+    for (int w = 0; w < num_words; w++)
+      reject[w] |= ~cand_row[w];
   }
 }
 
@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
 
@@ -91,6 +93,10 @@ class MotionEstimator
     void refineMotionEstimate();
     void computeReprojectionError();
 
+    uint64_t* consistencyRow(int match_id) {
+      return &_consistency_bits[static_cast<size_t>(match_id) * _consistency_words];
+    }
+
     // convenience variable
     DepthSource* _depth_source;
 
@@ -101,6 +107,19 @@ class MotionEstimator
     int _num_matches;
     int _matches_capacity;
 
+    // Pairwise consistency graph used by computeMaximallyConsistentClique.
+    // One row of _consistency_words 64-bit words per match, bit j of row i
+    // set if matches i and j are consistent.
+    std::vector<uint64_t> _consistency_bits;
+    int _consistency_words;
+
+    // scratch space for computeMaximallyConsistentClique, kept around to
+    // avoid reallocating every frame
+    std::vector<double> _clique_points;
+    std::vector<uint8_t> _clique_at_infinity;
+    std::vector<uint8_t> _clique_row;
+    std::vector<uint64_t> _clique_reject;
+
     // total number of feature tracks we've seen
     int _num_tracks;
 
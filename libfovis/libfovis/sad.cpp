@@ -0,0 +1,248 @@
+#include "sad.hpp"
+
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FOVIS_SAD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FOVIS_SAD_NEON
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+namespace fovis
+{
+
+// Each implementation comes as a pair : a single descriptor comparison and a
+// loop over a list of candidates.  The candidate loop lives next to the
+// kernel so the kernel can be inlined into it - the compiler won't inline a
+// function built for AVX2 into one that isn't.
+//
+// The vector kernels only look at whole 16 or 32 byte blocks inside
+// descriptor_len and finish off any remainder with the scalar loop, so the
+// result never depends on what is in the pad bytes.
+
+static inline int32_t
+sadTail(const uint8_t *a, const uint8_t *b, int start, int len)
+{
+  int32_t score = 0;
+  for (int i = start; i < len; i++) {
+    score += abs(a[i] - b[i]);
+  }
+  return score;
+}
+
+static int32_t
+sadScalar(const uint8_t *a, const uint8_t *b, int len)
+{
+  return sadTail(a, b, 0, len);
+}
+
+static void
+sadCandidatesScalar(const uint8_t *ref_desc, const uint8_t *target_descs,
+                    int target_stride, const int *target_inds, int num_targets,
+                    int len, int32_t *scores)
+{
+  for (int i = 0; i < num_targets; i++) {
+    scores[i] = sadScalar(ref_desc,
+                          target_descs + target_inds[i] * target_stride, len);
+  }
+}
+
+#ifdef FOVIS_SAD_X86
+__attribute__((target("sse2"))) static inline int32_t
+sadSSE2(const uint8_t *a, const uint8_t *b, int len)
+{
+  __m128i acc = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+  }
+  acc = _mm_add_epi64(acc, _mm_srli_si128(acc, 8));
+  return _mm_cvtsi128_si32(acc) + sadTail(a, b, i, len);
+}
+
+__attribute__((target("sse2"))) static void
+sadCandidatesSSE2(const uint8_t *ref_desc, const uint8_t *target_descs,
+                  int target_stride, const int *target_inds, int num_targets,
+                  int len, int32_t *scores)
+{
+  for (int i = 0; i < num_targets; i++) {
+    scores[i] = sadSSE2(ref_desc,
+                        target_descs + target_inds[i] * target_stride, len);
+  }
+}
+
+__attribute__((target("avx2"))) static inline int32_t
+sadAVX2(const uint8_t *a, const uint8_t *b, int len)
+{
+  __m256i acc = _mm256_setzero_si256();
+  int i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+  }
+  __m128i acc128 = _mm_add_epi64(_mm256_castsi256_si128(acc),
+                                 _mm256_extracti128_si256(acc, 1));
+  if (i + 16 <= len) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    acc128 = _mm_add_epi64(acc128, _mm_sad_epu8(va, vb));
+    i += 16;
+  }
+  acc128 = _mm_add_epi64(acc128, _mm_srli_si128(acc128, 8));
+  return _mm_cvtsi128_si32(acc128) + sadTail(a, b, i, len);
+}
+
+__attribute__((target("avx2"))) static void
+sadCandidatesAVX2(const uint8_t *ref_desc, const uint8_t *target_descs,
+                  int target_stride, const int *target_inds, int num_targets,
+                  int len, int32_t *scores)
+{
+  for (int i = 0; i < num_targets; i++) {
+    scores[i] = sadAVX2(ref_desc,
+                        target_descs + target_inds[i] * target_stride, len);
+  }
+}
+#endif
+
+#ifdef FOVIS_SAD_NEON
+static inline int32_t
+sadNEON(const uint8_t *a, const uint8_t *b, int len)
+{
+  // Pairwise-accumulate absolute differences into 16 bit lanes.  Each
+  // block adds at most 2*255 per lane, so widen to 32 bits every 64 blocks
+  // before the 16 bit lanes can overflow.
+  uint32x4_t acc32 = vdupq_n_u32(0);
+  int i = 0;
+  while (i + 16 <= len) {
+    uint16x8_t acc16 = vdupq_n_u16(0);
+    for (int blocks = 0; blocks < 64 && i + 16 <= len; blocks++, i += 16) {
+      acc16 = vpadalq_u8(acc16, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+    acc32 = vpadalq_u16(acc32, acc16);
+  }
+  uint64x2_t acc64 = vpaddlq_u32(acc32);
+  int32_t score = (int32_t)(vgetq_lane_u64(acc64, 0) + vgetq_lane_u64(acc64, 1));
+  return score + sadTail(a, b, i, len);
+}
+
+static void
+sadCandidatesNEON(const uint8_t *ref_desc, const uint8_t *target_descs,
+                  int target_stride, const int *target_inds, int num_targets,
+                  int len, int32_t *scores)
+{
+  for (int i = 0; i < num_targets; i++) {
+    scores[i] = sadNEON(ref_desc,
+                        target_descs + target_inds[i] * target_stride, len);
+  }
+}
+#endif
+
+static bool
+implementationSupported(SAD::Implementation impl)
+{
+  switch (impl) {
+    case SAD::SCALAR:
+      return true;
+#ifdef FOVIS_SAD_X86
+    case SAD::SSE2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse2");
+    case SAD::AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+#endif
+#ifdef FOVIS_SAD_NEON
+    case SAD::NEON:
+#if defined(__aarch64__)
+      return true;
+#else
+      return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+#endif
+    default:
+      return false;
+  }
+}
+
+static SAD::Implementation
+pickImplementation()
+{
+  const SAD::Implementation order[] = { SAD::AVX2, SAD::NEON, SAD::SSE2 };
+  for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+    if (implementationSupported(order[i])) {
+      return order[i];
+    }
+  }
+  return SAD::SCALAR;
+}
+
+static SAD::Implementation
+bestImplementation()
+{
+  // Checked once, the answer doesn't change while we're running
+  static const SAD::Implementation best = pickImplementation();
+  return best;
+}
+
+SAD::SAD(int descriptor_len) :
+    _descriptor_len(descriptor_len),
+    _score_fn(sadScalar),
+    _candidates_fn(sadCandidatesScalar)
+{
+  setImplementation(bestImplementation());
+}
+
+bool
+SAD::setImplementation(Implementation impl)
+{
+  if (!implementationSupported(impl)) {
+    return false;
+  }
+  switch (impl) {
+#ifdef FOVIS_SAD_X86
+    case SSE2:
+      _score_fn = sadSSE2;
+      _candidates_fn = sadCandidatesSSE2;
+      break;
+    case AVX2:
+      _score_fn = sadAVX2;
+      _candidates_fn = sadCandidatesAVX2;
+      break;
+#endif
+#ifdef FOVIS_SAD_NEON
+    case NEON:
+      _score_fn = sadNEON;
+      _candidates_fn = sadCandidatesNEON;
+      break;
+#endif
+    default:
+      _score_fn = sadScalar;
+      _candidates_fn = sadCandidatesScalar;
+      break;
+  }
+  return true;
+}
+
+const char*
+SAD::implementationName()
+{
+  switch (bestImplementation()) {
+    case SSE2: return "sse2";
+    case AVX2: return "avx2";
+    case NEON: return "neon";
+    default:   return "scalar";
+  }
+}
+
+}
@@ -1,9 +1,7 @@
 #ifndef __fovis_sad_hpp__
 #define __fovis_sad_hpp__
 
-#ifdef FOVIS_USE_SSE
-#include <emmintrin.h>
-#endif
+#include <stdint.h>
 
 namespace fovis
 {
@@ -13,52 +11,82 @@ namespace fovis
  * \brief Calculates the Sum of Absolute Deviations (SAD) score between two vectors
  * of length descriptor_len.
  *
+ * The SIMD implementation (scalar, SSE2, AVX2 or NEON) is picked once at run
+ * time based on what the CPU supports, so a single build runs the fastest
+ * code available on both the desktop and the Jetson.  All implementations
+ * produce scores identical to the scalar loop.
+ *
  */
 class SAD {
 public:
-  SAD(int descriptor_len) :
-      _descriptor_len(descriptor_len),
-      _nsad_ops(descriptor_len / 16 + ((descriptor_len % 16) ? 1 : 0))
-      { }
+  SAD(int descriptor_len);
 
   /**
-   * Calculate SAD score between ref_desc and target_desc. ref_desc
-   * and target_desc must be padded with zero-filled pad bytes up to
-   * multiple of 16.
+   * Calculate SAD score between ref_desc and target_desc.  Only the first
+   * descriptor_len bytes of each descriptor are compared.
    */
-  int32_t score(const uint8_t *ref_desc, const uint8_t *target_desc) {
-#ifdef FOVIS_USE_SSE
-    // compute sum of absolute differences (fast)
-    const uint8_t * pp = ref_desc;
-    const uint8_t * cp = target_desc;
-    __m128i d = _mm_setzero_si128();
-    for (int i = 0; i < _nsad_ops; i++) {
-      __m128i c = _mm_sad_epu8(*(__m128i *) pp, *(__m128i *) cp);
-      d = _mm_add_epi16(c, d);
-      pp += 16;
-      cp += 16;
-    }
-
-    __m128i e = _mm_srli_si128(d, 8);
-    __m128i f = _mm_add_epi32(d, e);
+  int32_t score(const uint8_t *ref_desc, const uint8_t *target_desc) const {
+    return _score_fn(ref_desc, target_desc, _descriptor_len);
+  }
 
-    int32_t score = _mm_cvtsi128_si32(f);
-#else
-    int32_t score = 0;
-    for(int i=0; i<_descriptor_len; i++) {
-      score += abs(ref_desc[i] - target_desc[i]);
-    }
-#endif
-    return score;
+  /**
+   * Score ref_desc against a list of candidate descriptors in one call.
+   * Candidate \p i is at \p target_descs + \p target_inds[i] * \p target_stride.
+   * This keeps the inner loop inside the SIMD code rather than making a call
+   * per candidate.
+   *
+   * \param scores output array, must have room for \p num_targets entries.
+   */
+  void scoreCandidates(const uint8_t *ref_desc,
+                       const uint8_t *target_descs,
+                       int target_stride,
+                       const int *target_inds,
+                       int num_targets,
+                       int32_t *scores) const {
+    _candidates_fn(ref_desc, target_descs, target_stride, target_inds,
+                   num_targets, _descriptor_len, scores);
   }
 
   int getWorstScore() const {
     return _descriptor_len * 255;
   }
 
+  /**
+   * Name of the implementation selected for this CPU, e.g. "avx2".
+   */
+  static const char* implementationName();
+
+  /**
+   * Names the implementations the test programs can ask for.
+   */
+  enum Implementation {
+    SCALAR = 0,
+    SSE2,
+    AVX2,
+    NEON,
+    NUM_IMPLEMENTATIONS
+  };
+
+  /**
+   * Force a particular implementation.  Returns false (and leaves this
+   * object unchanged) if it isn't supported by this build or CPU.  Normally
+   * only useful for testing.
+   */
+  bool setImplementation(Implementation impl);
+
+  typedef int32_t (*ScoreFn)(const uint8_t *a, const uint8_t *b, int len);
+  typedef void (*CandidatesFn)(const uint8_t *ref_desc,
+                               const uint8_t *target_descs,
+                               int target_stride,
+                               const int *target_inds,
+                               int num_targets,
+                               int len,
+                               int32_t *scores);
+
 private:
   int _descriptor_len;
-  int _nsad_ops;
+  ScoreFn _score_fn;
+  CandidatesFn _candidates_fn;
 };
 
 }
@@ -0,0 +1,74 @@
+#include "task_pool.hpp"
+
+namespace fovis
+{
+
+TaskPool::TaskPool(int num_threads) :
+    _num_pending(0),
+    _shutdown(false)
+{
+  for (int i = 0; i < num_threads; i++) {
+    _threads.push_back(std::thread(&TaskPool::workerLoop, this));
+  }
+}
+
+TaskPool::~TaskPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _shutdown = true;
+  }
+  _task_cond.notify_all();
+  for (size_t i = 0; i < _threads.size(); i++) {
+    _threads[i].join();
+  }
+}
+
+void
+TaskPool::submit(const std::function<void()>& task)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tasks.push_back(task);
+    _num_pending++;
+  }
+  _task_cond.notify_one();
+}
+
+void
+TaskPool::wait()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_num_pending > 0) {
+    _done_cond.wait(lock);
+  }
+}
+
+void
+TaskPool::workerLoop()
+{
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (!_shutdown && _tasks.empty()) {
+        _task_cond.wait(lock);
+      }
+      if (_tasks.empty()) {
+        return;
+      }
+      task.swap(_tasks.front());
+      _tasks.pop_front();
+    }
+
+    task();
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _num_pending--;
+    }
+    _done_cond.notify_all();
+  }
+}
+
+}
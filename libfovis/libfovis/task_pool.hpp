@@ -0,0 +1,56 @@
+#ifndef __fovis_task_pool_hpp__
+#define __fovis_task_pool_hpp__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fovis
+{
+
+/**
+ * \brief Small fixed-size pool of worker threads.
+ *
+ * Tasks are run in the order they're submitted, on whichever worker is free.
+ * wait() blocks until every task submitted so far has finished.  Only one
+ * thread should submit and wait on a given pool at a time.
+ */
+class TaskPool
+{
+  public:
+    /**
+     * \param num_threads number of worker threads to start.
+     */
+    explicit TaskPool(int num_threads);
+    ~TaskPool();
+
+    void submit(const std::function<void()>& task);
+
+    void wait();
+
+    int getNumThreads() const { return static_cast<int>(_threads.size()); }
+
+  private:
+    TaskPool(const TaskPool& other);
+    TaskPool& operator=(const TaskPool& other);
+
+    void workerLoop();
+
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void()> > _tasks;
+
+    std::mutex _mutex;
+    std::condition_variable _task_cond;
+    std::condition_variable _done_cond;
+
+    // tasks submitted but not yet finished
+    int _num_pending;
+    bool _shutdown;
+};
+
+}
+
+#endif
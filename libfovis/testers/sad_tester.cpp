@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../libfovis/sad.hpp"
+
+using namespace fovis;
+
+// Checks that every SAD implementation this CPU supports gives exactly
+// the same scores as the scalar code, for descriptor lengths that are and
+// aren't multiples of the SIMD width, including worst case descriptors.
+
+static const char* kNames[] = { "scalar", "sse2", "avx2", "neon" };
+
+static bool
+testLength(int len, int stride, int num_descs)
+{
+  std::vector<uint8_t> descs(num_descs * stride);
+  for (size_t i = 0; i < descs.size(); i++) {
+    descs[i] = rand() & 0xff;
+  }
+  // a pair of worst case descriptors
+  memset(&descs[0], 0, stride);
+  memset(&descs[stride], 0xff, stride);
+
+  std::vector<int> inds(num_descs);
+  for (int i = 0; i < num_descs; i++) {
+    inds[i] = rand() % num_descs;
+  }
+  inds[0] = 1;
+
+  SAD reference(len);
+  reference.setImplementation(SAD::SCALAR);
+  std::vector<int32_t> expected(num_descs);
+  reference.scoreCandidates(&descs[0], &descs[0], stride, &inds[0], num_descs,
+                            &expected[0]);
+  if (expected[0] != reference.getWorstScore()) {
+    printf("len %d : worst case score %d, expected %d\n", len, expected[0],
+           reference.getWorstScore());
+    return false;
+  }
+
+  bool ok = true;
+  for (int impl = SAD::SCALAR; impl < SAD::NUM_IMPLEMENTATIONS; impl++) {
+    SAD sad(len);
+    if (!sad.setImplementation(static_cast<SAD::Implementation>(impl))) {
+      continue;
+    }
+    std::vector<int32_t> scores(num_descs);
+    sad.scoreCandidates(&descs[0], &descs[0], stride, &inds[0], num_descs,
+                        &scores[0]);
+    for (int i = 0; i < num_descs; i++) {
+      int32_t single = sad.score(&descs[0], &descs[inds[i] * stride]);
+      if (scores[i] != expected[i] || single != expected[i]) {
+        printf("%s len %d candidate %d : got %d / %d, expected %d\n",
+               kNames[impl], len, i, scores[i], single, expected[i]);
+        ok = false;
+        break;
+      }
+    }
+  }
+  return ok;
+}
+
+int main(void)
+{
+  srand(1);
+  printf("SAD implementation : %s\n", SAD::implementationName());
+
+  bool ok = true;
+  for (int len = 1; len <= 300; len++) {
+    int stride = (len + 15) & ~15;
+    ok &= testLength(len, stride, 200);
+  }
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
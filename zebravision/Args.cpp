@@ -21,6 +21,7 @@ static void Usage(void)
    cout << "\t--calibrate          bring up crosshair to calibrate camera position" << endl;
    cout << "\t--capture            write raw camera video to output file" << endl;
    cout << "\t--captureSkip=       only write one of every N frames" << endl;
+   cout << "\t--captureCodec=      compression for captured ZMS video : none, zlib, lz4 (default), zstd" << endl;
    cout << "\t--save               write processed video to output file" << endl;
    cout << "\t--saveSkip=          only write one of every N processed frames" << endl;
    cout << "\t--no-rects           start with detection rectangles disabled" << endl;
@@ -44,6 +45,8 @@ static void Usage(void)
    cout << "\t--c24Threshold=      set c24 detection threshold" << endl;
    cout << "\t--groundTruth        only test frames which have ground truth data " << endl;
    cout << "\t--xmlFile=           XML file to read/write settings to/from" << endl;
+   cout << "\t--pipeline           overlap capture, goal detect and object detect in separate threads - batch mode only" << endl;
+   cout << "\t--cpuNet             run detection nets on the CPU without Caffe" << endl;
    cout << endl;
    cout << "Examples:" << endl;
    cout << "test : start in GUI mode, open default camera, start detecting and tracking while displaying results in the GUI" << endl;
@@ -84,6 +87,9 @@ Args::Args(void)
 	frameStart         = 0.0;
 	groundTruth        = false;
 	xmlFilename        = "/home/ubuntu/2016VisionCode/zebravision/settings.xml";
+	pipeline           = false;
+	cpuNet             = false;
+	captureCodec       = "lz4";
 }
 
 bool Args::processArgs(int argc, const char **argv)
@@ -96,6 +102,7 @@ bool Args::processArgs(int argc, const char **argv)
 	const string calibrateOpt       = "--calibrate";       // bring up crosshair to calibrate camera position
 	const string writeVideoOpt      = "--capture";         // save camera video to output file
 	const string writeVideoSkipOpt  = "--captureSkip=";    // skip frames in output video file
+	const string captureCodecOpt    = "--captureCodec=";   // codec for ZMS output
 	const string saveVideoOpt       = "--save";            // write processed video to output file
 	const string saveVideoSkipOpt   = "--saveSkip=";       // only write every N frames of processed video
 	const string rectsOpt           = "--no-rects";        // start with detection rectangles disabled
@@ -119,6 +126,8 @@ bool Args::processArgs(int argc, const char **argv)
 	const string c24ThresholdOpt    = "--c24Threshold=";    
 	const string groundTruthOpt     = "--groundTruth";     // only test frames which have ground truth data
 	const string xmlFileOpt         = "--xmlFile=";        // read camera settings from XML file
+	const string pipelineOpt        = "--pipeline";        // run per-frame stages in separate threads
+	const string cpuNetOpt          = "--cpuNet";          // use CPUNet engine rather than Caffe
 	const string badOpt             = "--";
 	// Read through command line args, extract
 	// cmd line parameters and input filename
@@ -139,6 +148,8 @@ bool Args::processArgs(int argc, const char **argv)
 			calibrate = true;
 		else if (writeVideoSkipOpt.compare(0, writeVideoSkipOpt.length(), argv[fileArgc], writeVideoSkipOpt.length()) == 0)
 			writeVideoSkip = atoi(argv[fileArgc] + writeVideoSkipOpt.length());
+		else if (captureCodecOpt.compare(0, captureCodecOpt.length(), argv[fileArgc], captureCodecOpt.length()) == 0)
+			captureCodec = string(argv[fileArgc] + captureCodecOpt.length());
 		else if (writeVideoOpt.compare(0, writeVideoOpt.length(), argv[fileArgc], writeVideoOpt.length()) == 0)
 			writeVideo = true;
 		else if (saveVideoSkipOpt.compare(0, saveVideoSkipOpt.length(), argv[fileArgc], saveVideoSkipOpt.length()) == 0)
@@ -187,6 +198,10 @@ bool Args::processArgs(int argc, const char **argv)
 			groundTruth = true;
 		else if (xmlFileOpt.compare(0, xmlFileOpt.length(), argv[fileArgc], xmlFileOpt.length()) == 0)
 			xmlFilename = string(argv[fileArgc] + xmlFileOpt.length());
+		else if (pipelineOpt.compare(0, pipelineOpt.length(), argv[fileArgc], pipelineOpt.length()) == 0)
+			pipeline = true;
+		else if (cpuNetOpt.compare(0, cpuNetOpt.length(), argv[fileArgc], cpuNetOpt.length()) == 0)
+			cpuNet = true;
 		else if (badOpt.compare(0, badOpt.length(), argv[fileArgc], badOpt.length()) == 0) // unknown option
 		{
 			cerr << "Unknown command line option " << argv[fileArgc] << endl;
@@ -39,6 +39,9 @@ class Args //class for processing arguments
 		std::string inputName; // input file name or camera number
 		bool groundTruth;      // only test frames with ground truth data
 		std::string xmlFilename;   // XML settings file
+		bool pipeline;         // run per-frame stages in separate threads
+		bool cpuNet;           // run nets with built-in CPU code rather than Caffe
+		std::string captureCodec;  // compression used for --capture ZMS files
 
 		Args(void);
 		bool processArgs(int argc, const char **argv);
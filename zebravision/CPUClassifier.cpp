@@ -0,0 +1,122 @@
+#include <iostream>
+
+#include "opencv2_3_shim.hpp"
+
+#include "CPUClassifier.hpp"
+
+using namespace std;
+using namespace cv;
+
+template <class MatT>
+CPUClassifier<MatT>::CPUClassifier(const string& modelFile,
+      const string& trainedFile,
+      const string& zcaWeightFile,
+      const string& labelFile,
+      const size_t  batchSize) :
+	Classifier<MatT>(modelFile, trainedFile, zcaWeightFile, labelFile, batchSize),
+	initialized_(false)
+{
+	// Base class loads labels and ZCA preprocessing data.
+	// If those fail, bail out immediately.
+	if (!Classifier<MatT>::initialized())
+		return;
+
+	// Make sure the model definition and 
+	// weight files exist
+	if (!this->fileExists(modelFile))
+	{
+		cerr << "Could not find model " << modelFile << endl;
+		return;
+	}
+	if (!this->fileExists(trainedFile))
+	{
+		cerr << "Could not find trained weights " << trainedFile << endl;
+		return;
+	}
+
+	cout << "Loading CPU model " << modelFile << endl << "\t" << trainedFile << endl << "\t" << zcaWeightFile << endl << "\t" << labelFile << endl;
+
+	if (!net_.load(modelFile, trainedFile))
+		return;
+
+	// Same sanity checks as the Caffe version - 3 channel
+	// color input, sized to match the ZCA filters, and
+	// one label per output
+	if (net_.inputChannels() != 3)
+	{
+		cerr << "Input layer should have 3 channels." << endl;
+		return;
+	}
+	if (this->inputGeometry_ != Size(net_.inputWidth(), net_.inputHeight()))
+	{
+		cerr << "Net size != ZCA size" << endl;
+		return;
+	}
+	if (this->labels_.size() != (size_t)net_.outputSize())
+	{
+		cerr << "Number of labels is different from the output layer dimension." << endl;
+		return;
+	}
+
+	// Allocate input buffers up front
+	// so the first batch isn't any slower
+	// than the rest
+	input_.resize(batchSize * 3 * net_.inputWidth() * net_.inputHeight());
+
+	// We made it!
+	initialized_ = true;
+}
+
+template <class MatT>
+CPUClassifier<MatT>::~CPUClassifier()
+{
+}
+
+// Get the output values for a set of images in one flat buffer
+// These values will be in the same order as the labels for each
+// image, and each set of labels for an image next adjacent to the
+// one for the next image.
+// That is, [0] = value for label 0 for the first image up to 
+// [n] = value for label n for the first image. It then starts again
+// for the next image - [n+1] = label 0 for image #2.
+template <>
+const float *CPUClassifier<Mat>::PredictBatch(const vector<Mat> &imgs)
+{
+	if (imgs.size() > this->batchSize_)
+	{
+		cerr << "PredictBatch() : too many input images : batch size is " << this->batchSize_ << " imgs.size() = " << imgs.size() << endl;
+		return NULL;
+	}
+
+	vector<Mat> zcaImgs = this->zca_.Transform32FC3(imgs);
+
+	// Split each image into separate B, G, R planes
+	// written directly into the net input buffer
+	const int    rows      = net_.inputHeight();
+	const int    cols      = net_.inputWidth();
+	const size_t planeSize = rows * cols;
+	for (size_t i = 0; i < zcaImgs.size(); i++)
+	{
+		float *inputData = &input_[i * 3 * planeSize];
+		vector<Mat> inputChannels;
+		for (int c = 0; c < 3; c++)
+			inputChannels.push_back(Mat(rows, cols, CV_32FC1, inputData + c * planeSize));
+		split(zcaImgs[i], inputChannels);
+	}
+
+	net_.forward(&input_[0], zcaImgs.size(), output_);
+	return output_.data();
+}
+
+template <class MatT>
+bool CPUClassifier<MatT>::initialized(void) const
+{
+	if (!Classifier<MatT>::initialized())
+		return false;
+	
+	return initialized_;
+}
+
+// Only a Mat version - the whole point is
+// to run without a GPU
+template class CPUClassifier<Mat>;
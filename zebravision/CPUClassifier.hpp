@@ -0,0 +1,40 @@
+#pragma once
+#include "Classifier.hpp"
+#include "cpunet.hpp"
+
+// Classifier which runs nets using the self-contained
+// CPUNet engine rather than Caffe.  Loads the same
+// deploy.prototxt and .caffemodel files but starts up
+// much quicker and doesn't need Caffe installed.
+// Only makes sense for cv::Mat inputs - use
+// CaffeClassifier<GpuMat> or GIE for GPU code
+template <class MatT>
+class CPUClassifier : public Classifier<MatT>
+{
+	public:
+		CPUClassifier(const std::string& modelFile,
+					const std::string& trainedFile,
+					const std::string& zcaWeightFile,
+					const std::string& labelFile,
+					const size_t batchSize);
+		~CPUClassifier();
+
+		bool initialized(void) const;
+
+	private:
+		// Get the output values for a set of images
+		// These values will be in the same order as the labels for each
+		// image, and each set of labels for an image next adjacent to the
+		// one for the next image.
+		// That is, [0] = value for label 0 for the first image up to 
+		// [n] = value for label n for the first image. It then starts again
+		// for the next image - [n+1] = label 0 for image #2.
+		// Returns a pointer to a buffer owned by this object which
+		// is valid until the next call.
+		const float *PredictBatch(const std::vector<MatT> &imgs);
+
+		CPUNet net_;                // the net itself
+		std::vector<float> input_;  // net input, one image after another
+		std::vector<float> output_; // net output for the whole batch
+		bool initialized_;          // set to true once the net is correctly initialzied
+};
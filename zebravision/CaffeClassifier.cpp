@@ -160,7 +160,7 @@ CaffeClassifier<MatT>::~CaffeClassifier()
 {
 }
 
-// Get the output values for a set of images in one flat vector
+// Get the output values for a set of images in one flat buffer
 // These values will be in the same order as the labels for each
 // image, and each set of labels for an image next adjacent to the
 // one for the next image.
@@ -168,7 +168,7 @@ CaffeClassifier<MatT>::~CaffeClassifier()
 // [n] = value for label n for the first image. It then starts again
 // for the next image - [n+1] = label 0 for image #2.
 template <class MatT>
-vector<float> CaffeClassifier<MatT>::PredictBatch(const vector<MatT> &imgs) 
+const float *CaffeClassifier<MatT>::PredictBatch(const vector<MatT> &imgs) 
 {
 	// Process each image so they match the format
 	// expected by the net, then copy the images
@@ -182,15 +182,14 @@ vector<float> CaffeClassifier<MatT>::PredictBatch(const vector<MatT> &imgs)
 	//cout << "Forward " << gtod_wrapper() - start << endl;
 
 	//start = gtod_wrapper();
-	// Copy the output layer to a flat vector 
+	// Hand back the output layer directly rather than
+	// copying it. It stays valid until the next Forward()
 	// Use CPU data output unconditionally - it has
 	// to end up back at the CPU eventually so do it
 	// now ... just as good as any other time
 	Blob<float>* outputLayer = net_->output_blobs()[0];
-	const float* begin = outputLayer->cpu_data();
-	const float* end = begin + outputLayer->channels()*imgs.size();
 	//cout << "Output " << gtod_wrapper() - start << endl;
-	return vector<float>(begin, end);
+	return outputLayer->cpu_data();
 }
 
 // Take each image in Mat, convert it to the correct image size,
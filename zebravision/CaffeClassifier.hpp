@@ -34,7 +34,9 @@ class CaffeClassifier : public Classifier<MatT>
 		// That is, [0] = value for label 0 for the first image up to 
 		// [n] = value for label n for the first image. It then starts again
 		// for the next image - [n+1] = label 0 for image #2.
-		std::vector<float> PredictBatch(const std::vector<MatT> &imgs);
+		// Returns a pointer to a buffer owned by this object which
+		// is valid until the next call.
+		const float *PredictBatch(const std::vector<MatT> &imgs);
 
 		// Method specialized to return either true or false depending
 		// on whether we're using GpuMats or Mats
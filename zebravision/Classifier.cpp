@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sys/stat.h>
@@ -69,18 +70,14 @@ static bool PairCompare(const pair<float, int>& lhs,
 	return lhs.first > rhs.first;
 }
 
-/* Return the indices of the top N values of vector v. */
-static vector<int> Argmax(const vector<float>& v, size_t N) 
+// Fill pairs with the indices of the top N values of v[0..count).
+// pairs[0..N) are the value, index pairs sorted best first.
+static void Argmax(const float *v, size_t count, size_t N, vector<pair<float, int> > &pairs)
 {
-	vector<pair<float, int> > pairs;
-	for (size_t i = 0; i < v.size(); ++i)
+	pairs.clear();
+	for (size_t i = 0; i < count; ++i)
 		pairs.push_back(make_pair(v[i], i));
 	partial_sort(pairs.begin(), pairs.begin() + N, pairs.end(), PairCompare);
-
-	vector<int> result;
-	for (size_t i = 0; i < N; ++i)
-		result.push_back(pairs[i].second);
-	return result;
 }
 
 // Given X input images, return X vectors of predictions.
@@ -91,45 +88,93 @@ template <class MatT>
 vector< vector<Prediction> > Classifier<MatT>::ClassifyBatch(
 		const vector<MatT> &imgs, const size_t numClasses)
 {
-	// outputBatch will be a flat vector of N floating point values 
+	// outputBatch will be a flat array of N floating point values 
 	// per image (1 per N output labels), repeated
 	// times the number of input images batched per run
 	// Convert that into the output vector of vectors
-	vector<float> outputBatch = PredictBatch(imgs);
+	const float *outputBatch = PredictBatch(imgs);
+	if (outputBatch == NULL)
+		return vector<vector<Prediction>>(imgs.size());
 	return floatsToPredictions(outputBatch, imgs.size(), numClasses);
 }
 
 template <class MatT>
-vector<vector<Prediction>> Classifier<MatT>::floatsToPredictions(const vector<float> &floats, const size_t imgSize, const size_t numClasses)
+vector<vector<Prediction>> Classifier<MatT>::floatsToPredictions(const float *floats, const size_t imgSize, const size_t numClasses)
 {
-	vector< vector<Prediction> > predictions;
+	vector< vector<Prediction> > predictions(imgSize);
 	const size_t labelsSize = labels_.size();
 	const size_t classes = min(numClasses, labelsSize);
 	// For each image, find the top numClasses values
 	for(size_t j = 0; j < imgSize; j++)
 	{
-		// Create an output vector just for values for this image. Since
-		// each image has labelsSize values, that's floats[j*labelsSize]
-		// through floats[(j+1) * labelsSize]
-		vector<float> output(floats.begin() + j*labelsSize, floats.begin() + (j+1)*labelsSize);
+		// The output specific to the jth image is
+		// floats[j*labelsSize] through floats[(j+1) * labelsSize]
+		const float *output = floats + j * labelsSize;
 		// For the output specific to the jth image, grab the
 		// indexes of the top classes predictions
-		vector<int> maxN = Argmax(output, classes);
+		Argmax(output, labelsSize, classes, argmaxPairs_);
 		// Using those top N indexes, create a set of labels/value predictions
 		// specific to this jth image
-		vector<Prediction> predictionSingle;
+		predictions[j].reserve(classes);
 		for (size_t i = 0; i < classes; ++i) 
 		{
-			int idx = maxN[i];
-			predictionSingle.push_back(make_pair(labels_[idx], output[idx]));
+			int idx = argmaxPairs_[i].second;
+			predictions[j].push_back(make_pair(labels_[idx], output[idx]));
 		}
-		// Add the predictions for this image to the list of
-		// predictions for all images
-		predictions.push_back(vector<Prediction>(predictionSingle));
 	}
 	return predictions;
 }
 
+// For each image, return the score for label labelIndex
+template <class MatT>
+void Classifier<MatT>::ClassifyBatchScore(const vector<MatT> &imgs, const int labelIndex, vector<float> &scores)
+{
+	scores.resize(imgs.size());
+	const float *outputBatch = PredictBatch(imgs);
+	if ((outputBatch == NULL) || (labelIndex < 0) || (labelIndex >= (int)labels_.size()))
+	{
+		fill(scores.begin(), scores.end(), 0.0f);
+		return;
+	}
+	const size_t labelsSize = labels_.size();
+	for (size_t j = 0; j < imgs.size(); j++)
+		scores[j] = outputBatch[j * labelsSize + labelIndex];
+}
+
+// Copy out the scores for every label for every image
+template <class MatT>
+void Classifier<MatT>::ClassifyBatchScores(const vector<MatT> &imgs, vector<float> &scores)
+{
+	const float *outputBatch = PredictBatch(imgs);
+	if (outputBatch == NULL)
+	{
+		scores.assign(imgs.size() * labels_.size(), 0.0f);
+		return;
+	}
+	scores.assign(outputBatch, outputBatch + imgs.size() * labels_.size());
+}
+
+template <class MatT>
+int Classifier<MatT>::labelIndex(const string &label) const
+{
+	for (size_t i = 0; i < labels_.size(); i++)
+		if (labels_[i] == label)
+			return i;
+	return -1;
+}
+
+template <class MatT>
+const string &Classifier<MatT>::labelName(const int index) const
+{
+	return labels_[index];
+}
+
+template <class MatT>
+size_t Classifier<MatT>::labelCount(void) const
+{
+	return labels_.size();
+}
+
 // Assorted helper functions
 template <class MatT>
 size_t Classifier<MatT>::batchSize(void) const
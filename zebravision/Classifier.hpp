@@ -30,6 +30,24 @@ class Classifier
 		// input image
 		std::vector<std::vector<Prediction>> ClassifyBatch(const std::vector<MatT> &imgs, const size_t numClasses);
 
+		// Batched versions of the above which skip building
+		// label strings.  Results go into caller-owned buffers
+		// which are resized to imgs.size() - reuse them from
+		// call to call to avoid reallocating.
+		// ClassifyBatchScore returns the score of one
+		// particular label for each image.
+		// Use labelIndex() and labelName() to map between
+		// indexes and label strings when needed for display
+		void ClassifyBatchScore(const std::vector<MatT> &imgs, const int labelIndex, std::vector<float> &scores);
+		// Scores for every label, labelCount() per image
+		// one image after another
+		void ClassifyBatchScores(const std::vector<MatT> &imgs, std::vector<float> &scores);
+
+		// Index of label in the net's output, -1 if not found
+		int labelIndex(const std::string &label) const;
+		const std::string &labelName(const int index) const;
+		size_t labelCount(void) const;
+
 		// Get the width and height of an input image to the net
 		cv::Size getInputGeometry(void) const;
 
@@ -54,6 +72,11 @@ class Classifier
 		// That is, [0] = value for label 0 for the first image up to 
 		// [n] = value for label n for the first image. It then starts again
 		// for the next image - [n+1] = label 0 for image #2.
-		virtual std::vector<float> PredictBatch(const std::vector<MatT> &imgs) = 0;
-		std::vector<std::vector<Prediction>> floatsToPredictions(const std::vector<float> &floats, const size_t imgSize, const size_t numClasses);
+		// The returned buffer belongs to the derived class and
+		// is only valid until the next call. Returns NULL on error.
+		virtual const float *PredictBatch(const std::vector<MatT> &imgs) = 0;
+		std::vector<std::vector<Prediction>> floatsToPredictions(const float *floats, const size_t imgSize, const size_t numClasses);
+
+		// Scratch space for sorting outputs in floatsToPredictions
+		std::vector<std::pair<float, int>> argmaxPairs_;
 };
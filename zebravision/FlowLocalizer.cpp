@@ -5,34 +5,53 @@
 using namespace cv;
 using namespace std;
 
-FlowLocalizer::FlowLocalizer(const cv::Mat &initial_frame)
+// Number of corners to look for when (re)detecting
+const int maxCorners = 200;
+
+// Redetect corners once fewer than this many are still
+// being tracked
+const size_t minTrackedCorners = maxCorners / 2;
+
+// LK search window and pyramid depth.  Pyramids are built with
+// these so calcOpticalFlowPyrLK has to be called with them too
+const Size lkWinSize(21, 21);
+const int  lkMaxLevel = 3;
+
+FlowLocalizer::FlowLocalizer(const cv::Mat &initial_frame, bool printTransform) :
+	_transform_mat(Mat::eye(3, 3, CV_64FC1)),
+	_printTransform(printTransform)
 {
 	cvtColor(initial_frame, _prevFrame, CV_BGR2GRAY);
+	_pyramidLevels = buildOpticalFlowPyramid(_prevFrame, _prevPyramid, lkWinSize, lkMaxLevel);
 }
 
 void FlowLocalizer::processFrame(const Mat &frame) 
 {
-	Mat currFrame;
-	cvtColor(frame, currFrame, CV_BGR2GRAY);
-	vector<Point2f> prevCorner, currCorner;
-	vector<Point2f> prevCorner2, currCorner2;
-	vector<uchar> status;
-	vector<float> err;
-	// Grab a set of features to track. Use optical flow to see
-	// how how they move between frames.
-	goodFeaturesToTrack(_prevFrame, prevCorner, 200, 0.01, 30);
-	if (prevCorner.size())
+	cvtColor(frame, _currFrame, CV_BGR2GRAY);
+	const int currLevels = buildOpticalFlowPyramid(_currFrame, _currPyramid, lkWinSize, lkMaxLevel);
+
+	// Grab a new set of features to track if too many of the
+	// old ones have been lost. Otherwise keep following the
+	// corners which made it through the last frame
+	if (_prevCorners.size() < minTrackedCorners)
+		goodFeaturesToTrack(_prevFrame, _prevCorners, maxCorners, 0.01, 30);
+
+	// Use optical flow to see how the features move between frames.
+	_prevMatched.clear();
+	_currMatched.clear();
+	if (_prevCorners.size())
 	{
-		calcOpticalFlowPyrLK(_prevFrame, currFrame, prevCorner, currCorner, status, err);
+		calcOpticalFlowPyrLK(_prevPyramid, _currPyramid, _prevCorners, _currCorners, _status, _err,
+				lkWinSize, min(_pyramidLevels, currLevels));
 
 		// Status is set to true for each point where a match was found.
 		// Use only these points for the rest of the calculations
-		for (size_t i = 0; i < status.size(); i++)
+		for (size_t i = 0; i < _status.size(); i++)
 		{
-			if (status[i])
+			if (_status[i])
 			{
-				prevCorner2.push_back(prevCorner[i]);
-				currCorner2.push_back(currCorner[i]);
+				_prevMatched.push_back(_prevCorners[i]);
+				_currMatched.push_back(_currCorners[i]);
 			}
 		}
 	}
@@ -43,8 +62,8 @@ void FlowLocalizer::processFrame(const Mat &frame)
 	//     [-sin(angle) cos(angle) translation-y ] 
 	Mat T;
 
-	if (prevCorner2.size() && currCorner2.size())
-		T = estimateRigidTransform(prevCorner2, currCorner2, false);
+	if (_prevMatched.size() && _currMatched.size())
+		T = estimateRigidTransform(_prevMatched, _currMatched, false);
 
 	// If a valid transformation is found, update predicted position
 	// using it
@@ -61,15 +80,26 @@ void FlowLocalizer::processFrame(const Mat &frame)
 
 		T.push_back(Tpad);
 		
-		cout << "Optical Flow Transformation Matrix: " << T << endl;
+		if (_printTransform)
+			cout << "Optical Flow Transformation Matrix: " << T << endl;
 
-		_transform_mat = T.clone();
+		// T is freshly allocated each frame so there's no
+		// need to copy it
+		_transform_mat = T;
 	}
 	else
 	{
 		_transform_mat = Mat::eye(3, 3, CV_64FC1);
 	}
 
-	//copy current frame to previous for next iteration
-	_prevFrame = currFrame.clone();
+	// Corners found in this frame are the ones to track from it
+	// in the next frame
+	_prevCorners.swap(_currMatched);
+
+	// Current frame and pyramid become previous for the next
+	// iteration. Swapping headers instead of cloning means the
+	// buffers just trade places and get reused
+	swap(_prevFrame, _currFrame);
+	_prevPyramid.swap(_currPyramid);
+	_pyramidLevels = currLevels;
 }
@@ -1,14 +1,39 @@
+#include <vector>
 #include <opencv2/core/core.hpp>
 
+// Estimates camera motion between frames from the optical
+// flow of a set of corners.  Corners are tracked from frame
+// to frame and only redetected when too many have been lost,
+// and each frame's LK image pyramid is kept so it can be
+// reused as the previous frame's pyramid on the next call
 class FlowLocalizer 
 {
 
 public:
-	FlowLocalizer(const cv::Mat &initial_frame);
+	FlowLocalizer(const cv::Mat &initial_frame, bool printTransform = false);
 	void processFrame(const cv::Mat &frame);
 	cv::Mat transform_mat() const { return _transform_mat; }
 	//cv::Point transform_point(cv::Point input) const { return _transform_mat * input; } 
 private:
 	cv::Mat _prevFrame;
+	cv::Mat _currFrame;
 	cv::Mat _transform_mat;
+
+	// LK pyramids for the previous and current frame. The
+	// current one becomes the previous one for the next frame
+	std::vector<cv::Mat> _prevPyramid;
+	std::vector<cv::Mat> _currPyramid;
+	int                  _pyramidLevels;
+
+	// Corners being tracked, located in _prevFrame
+	std::vector<cv::Point2f> _prevCorners;
+
+	// Scratch space reused from frame to frame
+	std::vector<cv::Point2f> _currCorners;
+	std::vector<cv::Point2f> _prevMatched;
+	std::vector<cv::Point2f> _currMatched;
+	std::vector<uchar>       _status;
+	std::vector<float>       _err;
+
+	bool _printTransform;
 };
@@ -195,7 +195,7 @@ void GIEClassifier<MatT>::WrapBatchInputLayer(void)
 }
 
 template <>
-vector<float> GIEClassifier<Mat>::PredictBatch(const vector<Mat> &imgs)
+const float *GIEClassifier<Mat>::PredictBatch(const vector<Mat> &imgs)
 {
 	if (imgs.size() > this->batchSize_) 
 		cerr <<
@@ -216,18 +216,18 @@ vector<float> GIEClassifier<Mat>::PredictBatch(const vector<Mat> &imgs)
 		vector<Mat> *inputChannels = &inputBatch_.at(i);
 		split(zcaImgs[i], *inputChannels);
 	}
-	float output[this->labels_.size() * this->batchSize_];
+	output_.resize(this->labels_.size() * this->batchSize_);
 	// DMA the input to the GPU,  execute the batch asynchronously, and DMA it back:
 	CHECK_CUDA(cudaMemcpyAsync(buffers_[inputIndex_], inputCPU_, this->batchSize_ * this->inputGeometry_.area() * sizeof(float), cudaMemcpyHostToDevice, stream_));
 	context_->enqueue(this->batchSize_, buffers_, stream_, nullptr);
-	CHECK_CUDA(cudaMemcpyAsync(output, buffers_[outputIndex_], this->batchSize_ * this->labels_.size() * sizeof(float), cudaMemcpyDeviceToHost, stream_));
+	CHECK_CUDA(cudaMemcpyAsync(&output_[0], buffers_[outputIndex_], this->batchSize_ * this->labels_.size() * sizeof(float), cudaMemcpyDeviceToHost, stream_));
 	cudaStreamSynchronize(stream_);
 
-	return vector<float>(output, output + sizeof(output)/sizeof(output[0]));
+	return &output_[0];
 }
 
 template <>
-vector<float> GIEClassifier<GpuMat>::PredictBatch(const vector<GpuMat> &imgs)
+const float *GIEClassifier<GpuMat>::PredictBatch(const vector<GpuMat> &imgs)
 {
 	if (imgs.size() > this->batchSize_) 
 		cerr <<
@@ -247,11 +247,11 @@ vector<float> GIEClassifier<GpuMat>::PredictBatch(const vector<GpuMat> &imgs)
 
 	// Setup an output buffer and enqueue a copy
 	// into it once the net has been run
-	float output[this->labels_.size() * this->batchSize_];
-	CHECK_CUDA(cudaMemcpyAsync(output, buffers_[outputIndex_], this->batchSize_ * this->labels_.size() * sizeof(float), cudaMemcpyDeviceToHost, stream_));
+	output_.resize(this->labels_.size() * this->batchSize_);
+	CHECK_CUDA(cudaMemcpyAsync(&output_[0], buffers_[outputIndex_], this->batchSize_ * this->labels_.size() * sizeof(float), cudaMemcpyDeviceToHost, stream_));
 	cudaStreamSynchronize(stream_);
 
-	return vector<float>(output, output + sizeof(output)/sizeof(output[0]));
+	return &output_[0];
 }
 #else
 #include <vector>
@@ -285,10 +285,11 @@ bool GIEClassifier<MatT>::initialized(void) const
 }
 
 template <class MatT>
-vector<float> GIEClassifier<MatT>::PredictBatch(const vector<MatT> &imgs)
+const float *GIEClassifier<MatT>::PredictBatch(const vector<MatT> &imgs)
 {
 	cerr << "GIE support not available" << endl;
-	return vector<float>(imgs.size() * this->labels_.size(), 0.0);
+	output_.assign(imgs.size() * this->labels_.size(), 0.0);
+	return output_.data();
 }
 #endif
 
@@ -33,7 +33,9 @@ class GIEClassifier : public Classifier<MatT>
 		// That is, [0] = value for label 0 for the first image up to 
 		// [n] = value for label n for the first image. It then starts again
 		// for the next image - [n+1] = label 0 for image #2.
-		std::vector<float> PredictBatch(const std::vector<MatT> &imgs);
+		// Returns a pointer to a buffer owned by this object which
+		// is valid until the next call.
+		const float *PredictBatch(const std::vector<MatT> &imgs);
 
 	private:
 #ifdef USE_GIE
@@ -52,5 +54,6 @@ class GIEClassifier : public Classifier<MatT>
 		std::vector<std::vector<MatT>> inputBatch_; // net input buffers wrapped in Mats
 #endif
 
+		std::vector<float> output_;  // net output for the whole batch
 		bool initialized_;
 };
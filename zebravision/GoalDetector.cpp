@@ -1,3 +1,4 @@
+#include <cfloat>
 #include <iomanip>
 #include <opencv2/highgui/highgui.hpp>
 #include "GoalDetector.hpp"
@@ -17,7 +18,9 @@ GoalDetector::GoalDetector(cv::Point2f fov_size, cv::Size frame_size, bool gui)
 	_otsu_threshold(5),
 	_blue_scale(87),
 	_red_scale(60),
-	_camera_angle(90)
+	_camera_angle(90),
+	_lutBlueScale(-1),
+	_lutRedScale(-1)
 {
 	if (gui)
 	{
@@ -52,12 +55,23 @@ struct GoalInfo
 };
 
 
-void GoalDetector::processFrame(const Mat& image, const Mat& depth)
+// True if any pixel in a CV_8UC1 image is non-zero.
+// Used on small ROIs of the threshold image - stops at
+// the first set pixel rather than scanning everything
+static bool anyNonZero(const Mat &img)
 {
-	// Use to mask the contour off from the rest of the
-	// image - used when grabbing depth data for the contour
-	Mat contour_mask(image.rows, image.cols, CV_8UC1, Scalar(0));
+	for (int r = 0; r < img.rows; r++)
+	{
+		const uchar *p = img.ptr<uchar>(r);
+		for (int c = 0; c < img.cols; c++)
+			if (p[c])
+				return true;
+	}
+	return false;
+}
 
+void GoalDetector::processFrame(const Mat& image, const Mat& depth)
+{
 	// Reset previous detection vars
 	_isValid = false;
 	_dist_to_goal = -1.0;
@@ -98,8 +112,8 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 
 	for (size_t i = 0; i < _contours.size(); i++)
 	{
-		// ObjectType computes a ton of useful properties so create
-		// one for what we're looking at
+		// Cheap checks using just the bounding rect go first,
+		// followed by ones which look at pixels inside it
 		Rect br(boundingRect(_contours[i]));
 
 		// Remove objects which are obviously too small
@@ -125,14 +139,25 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 			continue;
 		}
 
+		//width to height ratio. ObjectType measures width and height
+		//as max - min of the contour coords, which is one less than
+		//the bounding rect size.  Checking it here using just the
+		//bounding rect throws out a lot of noise before doing any of
+		//the more expensive per-pixel checks below
+		float actualRatio = (float)(br.width - 1) / (br.height - 1);
+		if ((actualRatio <= (1.0/2.25)) || (actualRatio >= 2.25))
+		{
+#ifdef VERBOSE
+			cout << "Contour " << i << " aspectRatio out of range:" << actualRatio << endl;
+#endif
+			_confidence.push_back(0);
+			continue;
+		}
 
-		//create a mask which is the same shape as the contour
-		contour_mask.setTo(Scalar(0));
-		drawContours(contour_mask, _contours, i, Scalar(255), CV_FILLED);
 
 		// get the minimum and maximum depth values in the contour,
 		// copy them into individual floats
-		pair<float, float> minMax = utils::minOfDepthMat(depth, contour_mask, br, 10);
+		pair<float, float> minMax = _depthStats.minMax(depth, _contours, i, 10);
 		float depth_z_min = minMax.first;
 		float depth_z_max = minMax.second;
 
@@ -157,17 +182,14 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 		// middle going towards the top. Check for that here
 		Mat topMidCol(threshold_image(Rect(cvRound(br.tl().x + br.width * .35f), br.tl().y, cvRound(br.width * .3f), cvRound(br.height * .4f))));
 		Mat botMidCol(threshold_image(Rect(br.tl().x, cvRound(br.tl().y + br.height * .85f), br.width, cvRound(br.height * .15f))));
-		double topMaxCol;
-		minMaxLoc(topMidCol, NULL, &topMaxCol);
-		double botMaxCol;
-		minMaxLoc(botMidCol, NULL, &botMaxCol);
-		// The max pixel value in the bottom rows of the
-		// middle column should be > 0 and the max pixel
-		// value in the top rows of that same column should be 0
-		if ((topMaxCol >= 1.0) || (botMaxCol < 1.0))
+		// There should be set pixels in the bottom rows of the
+		// middle column and none in the top rows of that same column
+		const bool topMaxCol = anyNonZero(topMidCol);
+		const bool botMaxCol = anyNonZero(botMidCol);
+		if (topMaxCol || !botMaxCol)
 		{
 #ifdef VERBOSE
-			cout << "Contour " << i << " middle column values wrong (top/bot):" << (int)topMaxCol << "/" << (int)botMaxCol << endl;
+			cout << "Contour " << i << " middle column values wrong (top/bot):" << topMaxCol << "/" << botMaxCol << endl;
 #endif
 			_confidence.push_back(0);
 			continue;
@@ -185,21 +207,13 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 		Mat rightTopMidRow(threshold_image(Rect(br.tl().x + cvRound(br.width * .85f), cvRound(br.tl().y + br.height * .35f), cvRound(br.width * .15f), 1)));
 		Mat rightBotMidRow(threshold_image(Rect(br.tl().x + cvRound(br.width * .85f), cvRound(br.tl().y + br.height * .65f), cvRound(br.width * .15f), 1)));
 		Mat centerMidRow(threshold_image(Rect(br.tl().x + cvRound(br.width * 3.f / 8.f), cvRound(br.tl().y + br.height / 4.f), cvRound(br.width / 4.f), 1)));
-		double dummy;
-		double rightMaxRow;
-		minMaxLoc(rightTopMidRow, NULL, &dummy);
-		minMaxLoc(rightBotMidRow, NULL, &rightMaxRow);
-		rightMaxRow = max(dummy, rightMaxRow);
-		double leftMaxRow;
-		minMaxLoc(leftTopMidRow, NULL, &dummy);
-		minMaxLoc(leftBotMidRow, NULL, &leftMaxRow);
-		leftMaxRow = max(dummy, leftMaxRow);
-		double centerMaxRow;
-		minMaxLoc(centerMidRow, NULL, &centerMaxRow);
-		if ((leftMaxRow < 1.0) || (centerMaxRow > 0.) || (rightMaxRow < 1.0))
+		const bool rightMaxRow  = anyNonZero(rightTopMidRow) || anyNonZero(rightBotMidRow);
+		const bool leftMaxRow   = anyNonZero(leftTopMidRow) || anyNonZero(leftBotMidRow);
+		const bool centerMaxRow = anyNonZero(centerMidRow);
+		if (!leftMaxRow || centerMaxRow || !rightMaxRow)
 		{
 #ifdef VERBOSE
-			cout << "Contour " << i << " middle row wrong (left / center / right):" << (int)leftMaxRow << "/" <<(int)centerMaxRow << "/" << (int)rightMaxRow << endl;
+			cout << "Contour " << i << " middle row wrong (left / center / right):" << leftMaxRow << "/" << centerMaxRow << "/" << rightMaxRow << endl;
 			cout << "\tRight(x2): " << rightTopMidRow << "/" << rightBotMidRow << " Center: " << centerMidRow << " Left(x2): " << leftTopMidRow << "/" << leftBotMidRow << endl;
 #endif
 			_confidence.push_back(0);
@@ -208,7 +222,6 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 
 		//create a trackedobject to get various statistics
 		//including area and x,y,z position of the goal
-		ObjectType goal_actual(_contours[i]);
 		TrackedObject goal_tracked_obj(0, _goal_shape, br, depth_z_max, _fov_size, _frame_size, -((float)_camera_angle/10.) * M_PI / 180.0);
 		//TrackedObject goal_tracked_obj(0, _goal_shape, br, depth_z_max, _fov_size, _frame_size, -16 * M_PI / 180.0);
 
@@ -227,6 +240,12 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 			_confidence.push_back(0);
 			continue;
 		}
+		// ObjectType computes a ton of useful properties - area,
+		// center of mass and so on - so create one for what
+		// we're looking at.  This is the most expensive part of
+		// the checks so only do it for contours which got this far
+		ObjectType goal_actual(_contours[i]);
+
 		//percentage of the object filled in
 		float filledPercentageActual = goal_actual.area() / goal_actual.boundingArea();
 
@@ -234,17 +253,6 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 		Point2f com_percent_actual((goal_actual.com().x - br.tl().x) / goal_actual.width(),
 								   (goal_actual.com().y - br.tl().y) / goal_actual.height());
 
-		//width to height ratio
-		float actualRatio = goal_actual.width() / goal_actual.height();
-		if ((actualRatio <= (1.0/2.25)) || (actualRatio >= 2.25))
-		{
-#ifdef VERBOSE
-			cout << "Contour " << i << " aspectRatio out of range:" << actualRatio << endl;
-#endif
-			_confidence.push_back(0);
-			continue;
-		}
-
 		//parameters for the normal distributions
 		//values for standard deviation were determined by
 		//taking the standard deviation of a bunch of values from the goal
@@ -366,6 +374,111 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 }
 
 
+// Min of a and b for erode, max for dilate
+template <bool isErode>
+static inline uchar morphOp(uchar a, uchar b)
+{
+	return isErode ? (a < b ? a : b) : (a > b ? a : b);
+}
+
+// One pass of a 3x3 erode (min) or dilate (max) over
+// rows [outLo, outHi) of an image held in a band buffer.
+// src must hold rows [outLo - 1, outHi + 1), clipped to the
+// image, and row y of the image is at (y - base) * cols in
+// each buffer. Pixels off the edge of the image are ignored,
+// same as OpenCV's default border for erode and dilate.
+// Written as plain loops over rows so the compiler can
+// vectorize them
+template <bool isErode>
+static void morphBand(const uchar *src, uchar *dst, uchar *tmp,
+					  int rows, int cols, int base, int outLo, int outHi)
+{
+	const int inLo = max(outLo - 1, 0);
+	const int inHi = min(outHi + 1, rows);
+
+	// Horizontal pass into tmp
+	for (int y = inLo; y < inHi; y++)
+	{
+		const uchar *s = src + (y - base) * cols;
+		uchar       *t = tmp + (y - base) * cols;
+		if (cols == 1)
+		{
+			t[0] = s[0];
+			continue;
+		}
+		t[0] = morphOp<isErode>(s[0], s[1]);
+		for (int x = 1; x < cols - 1; x++)
+			t[x] = morphOp<isErode>(morphOp<isErode>(s[x - 1], s[x]), s[x + 1]);
+		t[cols - 1] = morphOp<isErode>(s[cols - 2], s[cols - 1]);
+	}
+
+	// Vertical pass from tmp into dst. Rows off the edge
+	// of the image are replaced by the center row, which
+	// doesn't change the min or max
+	for (int y = outLo; y < outHi; y++)
+	{
+		const uchar *t0 = tmp + (max(y - 1, 0) - base) * cols;
+		const uchar *t1 = tmp + (y - base) * cols;
+		const uchar *t2 = tmp + (min(y + 1, rows - 1) - base) * cols;
+		uchar       *d  = dst + (y - base) * cols;
+		for (int x = 0; x < cols; x++)
+			d[x] = morphOp<isErode>(morphOp<isErode>(t0[x], t1[x]), t2[x]);
+	}
+}
+
+// Same as the threshold value OpenCV's THRESH_OTSU picks,
+// computed from a histogram which has already been built
+static double otsuThresholdFromHist(const int *hist, int total)
+{
+	const int N = 256;
+	double mu = 0, scale = 1. / total;
+	for (int i = 0; i < N; i++)
+		mu += i * (double)hist[i];
+	mu *= scale;
+
+	double mu1 = 0, q1 = 0;
+	double max_sigma = 0, max_val = 0;
+	for (int i = 0; i < N; i++)
+	{
+		double p_i, q2, mu2, sigma;
+
+		p_i = hist[i] * scale;
+		mu1 *= q1;
+		q1 += p_i;
+		q2 = 1. - q1;
+
+		if ((min(q1, q2) < FLT_EPSILON) || (max(q1, q2) > 1. - FLT_EPSILON))
+			continue;
+
+		mu1 = (mu1 + i * p_i) / q1;
+		mu2 = (mu - q1 * mu1) / q2;
+		sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+		if (sigma > max_sigma)
+		{
+			max_sigma = sigma;
+			max_val = i;
+		}
+	}
+	return max_val;
+}
+
+// Rebuild the table of weighted blue + red values if the
+// scales have changed.  Entry (blue << 8) | red is the same
+// value addWeighted() would produce for those inputs
+void GoalDetector::updateBluePlusRedLUT(void)
+{
+	if ((_lutBlueScale == _blue_scale) && (_lutRedScale == _red_scale))
+		return;
+	const float blueScale = _blue_scale / 100.0;
+	const float redScale  = _red_scale / 100.0;
+	_bluePlusRedLUT.resize(256 * 256);
+	for (int b = 0; b < 256; b++)
+		for (int r = 0; r < 256; r++)
+			_bluePlusRedLUT[(b << 8) | r] = saturate_cast<uchar>(b * blueScale + r * redScale + 0.0f);
+	_lutBlueScale = _blue_scale;
+	_lutRedScale  = _red_scale;
+}
+
 // We're looking for pixels which are mostly green
 // with a little bit of blue - that should match
 // the LED reflected color.
@@ -378,23 +491,85 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 // blue, except multiply the pixel values by a weight
 // < 1. Using this weight will let blue-green pixels
 // show up in the output grayscale
+//
+// Generate a black and white image of likely goal pixels.
+// Pixels which are much more green than blue or red are candidates.
+// Noise is cleaned up with a couple of erode / dilate passes,
+// then Otsu thresholding splits the result into black and white.
+//
+// Rather than doing each step as a separate pass over the full
+// frame, the image is processed in horizontal bands small enough
+// to stay in cache. Each band plus a few rows above and below it
+// goes through the green - (blue + red) math and all four morphology
+// passes, building a histogram of the results as it goes. The
+// Otsu threshold is then computed from that histogram and applied
+// in one last pass.  Results are identical to running split,
+// addWeighted, subtract, erode/dilate and threshold separately.
 bool GoalDetector::generateThresholdAddSubtract(const Mat& imageIn, Mat& imageOut)
 {
-    vector<Mat> splitImage;
-    Mat         bluePlusRed;
-
-    split(imageIn, splitImage);
-	addWeighted(splitImage[0], _blue_scale / 100.0,
-			    splitImage[2], _red_scale / 100.0, 0.0,
-				bluePlusRed);
-	subtract(splitImage[1], bluePlusRed, imageOut);
-
-    Mat erodeElement(getStructuringElement(MORPH_RECT, Size(3, 3)));
-    Mat dilateElement(getStructuringElement(MORPH_RECT, Size(3, 3)));
-	for (int i = 0; i < 2; ++i)
+	const int rows = imageIn.rows;
+	const int cols = imageIn.cols;
+	imageOut.create(rows, cols, CV_8UC1);
+	if ((rows == 0) || (cols == 0))
+		return false;
+
+	updateBluePlusRedLUT();
+	const uchar *lut = &_bluePlusRedLUT[0];
+
+	// Each morphology pass needs one row above and below
+	// each output row, so 4 passes need 4 extra rows
+	// above and below the band
+	const int halo     = 4;
+	const int bandRows = 32;
+	const size_t bufSize = (bandRows + 2 * halo) * cols;
+	_bandA.resize(bufSize);
+	_bandB.resize(bufSize);
+	_bandTmp.resize(bufSize);
+	uchar *bandA   = &_bandA[0];
+	uchar *bandB   = &_bandB[0];
+	uchar *bandTmp = &_bandTmp[0];
+
+	int hist[256] = {0};
+	for (int y0 = 0; y0 < rows; y0 += bandRows)
 	{
-		erode(imageOut, imageOut, erodeElement, Point(-1, -1), 1);
-		dilate(imageOut, imageOut, dilateElement, Point(-1, -1), 1);
+		const int y1   = min(y0 + bandRows, rows);
+		const int base = y0 - halo;
+
+		// green - (blue * blueScale + red * redScale),
+		// saturating at 0
+		const int inLo = max(y0 - halo, 0);
+		const int inHi = min(y1 + halo, rows);
+		for (int y = inLo; y < inHi; y++)
+		{
+			const uchar *s = imageIn.ptr<uchar>(y);
+			uchar       *d = bandA + (y - base) * cols;
+			for (int x = 0; x < cols; x++, s += 3)
+			{
+				const int bpr = lut[(s[0] << 8) | s[2]];
+				const int g   = s[1];
+				d[x] = g > bpr ? g - bpr : 0;
+			}
+		}
+
+		// Two rounds of erode then dilate. Each pass
+		// produces one fewer row of halo than the last
+		morphBand<true> (bandA, bandB, bandTmp, rows, cols, base, max(y0 - 3, 0), min(y1 + 3, rows));
+		morphBand<false>(bandB, bandA, bandTmp, rows, cols, base, max(y0 - 2, 0), min(y1 + 2, rows));
+		morphBand<true> (bandA, bandB, bandTmp, rows, cols, base, max(y0 - 1, 0), min(y1 + 1, rows));
+		morphBand<false>(bandB, bandA, bandTmp, rows, cols, base, y0, y1);
+
+		// Copy the finished rows out and add them
+		// to the histogram for the Otsu threshold
+		for (int y = y0; y < y1; y++)
+		{
+			const uchar *s = bandA + (y - base) * cols;
+			uchar       *d = imageOut.ptr<uchar>(y);
+			for (int x = 0; x < cols; x++)
+			{
+				d[x] = s[x];
+				hist[s[x]] += 1;
+			}
+		}
 	}
 
 	// Use Ostu adaptive thresholding.  This will turn
@@ -404,13 +579,28 @@ bool GoalDetector::generateThresholdAddSubtract(const Mat& imageIn, Mat& imageOu
 	// from the function.  If this value is too low, it means the image is
 	// really dark and the returned threshold image will be mostly noise.
 	// In that case, skip processing it entirely.
-	double otsuThreshold = threshold(imageOut, imageOut, 0., 255., CV_THRESH_BINARY | CV_THRESH_OTSU);
+	const double otsuThreshold = otsuThresholdFromHist(hist, rows * cols);
+	const int    ithresh       = cvFloor(otsuThreshold);
+	uchar thresholdLUT[256];
+	int   nonZero = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		thresholdLUT[i] = (i > ithresh) ? 255 : 0;
+		if (i > ithresh)
+			nonZero += hist[i];
+	}
+	for (int y = 0; y < rows; y++)
+	{
+		uchar *p = imageOut.ptr<uchar>(y);
+		for (int x = 0; x < cols; x++)
+			p[x] = thresholdLUT[p[x]];
+	}
 #ifdef VERBOSE
 	cout << "OSTU THRESHOLD " << otsuThreshold << endl;
 #endif
 	if (otsuThreshold < _otsu_threshold)
 		return false;
-    return countNonZero(imageOut) != 0;
+	return nonZero != 0;
 }
 
 // Use the camera FOV, image size and rect size to
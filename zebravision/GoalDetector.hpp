@@ -50,6 +50,9 @@ class GoalDetector
 		std::vector<std::vector<cv::Point> > _contours;
 		std::vector<float> _confidence;
 
+		// Used to get depth info for each contour
+		utils::DepthStats _depthStats;
+
 		float _min_valid_confidence;
 
 		int   _otsu_threshold;
@@ -58,8 +61,19 @@ class GoalDetector
 
 int _camera_angle;
 
+		// Weighted blue + red lookup table and the scales it
+		// was built for, plus band buffers reused from frame
+		// to frame by generateThresholdAddSubtract
+		int _lutBlueScale;
+		int _lutRedScale;
+		std::vector<uchar> _bluePlusRedLUT;
+		std::vector<uchar> _bandA;
+		std::vector<uchar> _bandB;
+		std::vector<uchar> _bandTmp;
+
 		float createConfidence(float expectedVal, float expectedStddev, float actualVal);
 		float distanceUsingFOV(const cv::Rect &rect) const;
 		bool generateThresholdAddSubtract(const cv::Mat& imageIn, cv::Mat& imageOut);
+		void updateBluePlusRedLUT(void);
 		void isValid();
 };
@@ -90,6 +90,110 @@ namespace utils {
 		return std::make_pair(min_dist, max_dist);
 	}
 
+	// Valid depth values are positive and not NaN
+	static inline bool validDepth(float d)
+	{
+		return !(isnan(d) || (d <= 0));
+	}
+
+	pair<float, float> DepthStats::minMax(const cv::Mat &depth, const cv::Rect &rect, int range)
+	{
+		if (depth.empty())
+			return make_pair(-1, -1);
+		return minMaxMasked(depth, rect & cv::Rect(0, 0, depth.cols, depth.rows), cv::Mat(), range);
+	}
+
+	pair<float, float> DepthStats::minMax(const cv::Mat &depth,
+			const vector<vector<cv::Point> > &contours,
+			int contourIdx, int range)
+	{
+		if (depth.empty())
+			return make_pair(-1, -1);
+		const cv::Rect roi = cv::boundingRect(contours[contourIdx]) & cv::Rect(0, 0, depth.cols, depth.rows);
+
+		// Draw the contour into a mask covering just its
+		// bounding rect rather than the full frame
+		if ((_maskBuffer.rows < roi.height) || (_maskBuffer.cols < roi.width))
+			_maskBuffer.create(max(roi.height, _maskBuffer.rows), max(roi.width, _maskBuffer.cols), CV_8UC1);
+		cv::Mat mask(_maskBuffer(cv::Rect(0, 0, roi.width, roi.height)));
+		mask.setTo(cv::Scalar(0));
+		cv::drawContours(mask, contours, contourIdx, cv::Scalar(255), CV_FILLED, 8, cv::noArray(), INT_MAX, cv::Point(-roi.x, -roi.y));
+
+		return minMaxMasked(depth, roi, mask, range);
+	}
+
+	// mask is either empty, meaning use every pixel in the image,
+	// or the same size as roi, in which case only pixels set to
+	// 255 are used
+	pair<float, float> DepthStats::minMaxMasked(const cv::Mat &depth, const cv::Rect &roi, const cv::Mat &mask, int range)
+	{
+		const bool useMask = !mask.empty();
+
+		// Find the min and max in a single pass
+		float min = numeric_limits<float>::max();
+		float max = numeric_limits<float>::min();
+		cv::Point minLoc;
+		cv::Point maxLoc;
+		bool found = false;
+		for (int j = 0; j < roi.height; j++)
+		{
+			const float *ptr_img  = depth.ptr<float>(roi.y + j) + roi.x;
+			const uchar *ptr_mask = useMask ? mask.ptr<uchar>(j) : NULL;
+			for (int i = 0; i < roi.width; i++)
+			{
+				if ((!useMask || (ptr_mask[i] == 255)) && validDepth(ptr_img[i]))
+				{
+					found = true;
+					if (ptr_img[i] > max)
+					{
+						max = ptr_img[i];
+						maxLoc = cv::Point(i, j);
+					}
+					if (ptr_img[i] < min)
+					{
+						min = ptr_img[i];
+						minLoc = cv::Point(i, j);
+					}
+				}
+			}
+		}
+		if (!found)
+			return make_pair(-3, -3);
+
+		// Average valid depths in the +/- range window
+		// around a point.  With a mask, only look at pixels
+		// in the mask. Without, anything in the image is OK.
+		// Coords here are relative to roi
+		auto average = [&](const cv::Point &loc) -> float
+		{
+			cv::Rect window(loc.x - range, loc.y - range, 2 * range, 2 * range);
+			if (useMask)
+				window &= cv::Rect(0, 0, roi.width, roi.height);
+			else
+				window &= cv::Rect(-roi.x, -roi.y, depth.cols, depth.rows);
+			float sum = 0;
+			int   num = 0;
+			for (int j = window.y; j < window.br().y; j++)
+			{
+				const float *ptr_img  = depth.ptr<float>(roi.y + j) + roi.x;
+				const uchar *ptr_mask = useMask ? mask.ptr<uchar>(j) : NULL;
+				for (int i = window.x; i < window.br().x; i++)
+				{
+					if ((!useMask || (ptr_mask[i] == 255)) && validDepth(ptr_img[i]))
+					{
+						sum += ptr_img[i];
+						num++;
+					}
+				}
+			}
+			if (num == 0)
+				return -4;
+			return sum / (num * 1000.);
+		};
+
+		return make_pair(average(minLoc), average(maxLoc));
+	}
+
 	void shrinkRect(cv::Rect &rect_in, float shrink_factor) {
 
 		rect_in.tl() = rect_in.tl() + cv::Point(shrink_factor/2.0 * rect_in.width, shrink_factor/2.0 * rect_in.height);
@@ -5,6 +5,7 @@
 
 //#include <Eigen/Geometry>
 #include <cmath>
+#include <vector>
 
 //opencv include
 #include "opencv2/imgproc/imgproc.hpp"
@@ -16,6 +17,34 @@
 namespace utils {
 
 std::pair<float, float> minOfDepthMat(const cv::Mat& img, const cv::Mat& mask, const cv::Rect& bound_rect, int range);
+
+// Same idea as minOfDepthMat but without needing a full-frame
+// mask for each call. Finds the min and max valid depth in a
+// region in one pass, then averages the depths within +/- range
+// pixels of each to get a less noisy value. Returns a
+// (min, max) pair in meters, or negative values on error
+// (-1 = no depth data, -3 = no valid pixels in the region).
+// Keep one of these around and reuse it - scratch space is
+// only reallocated when a bigger region comes along
+class DepthStats
+{
+	public:
+		// Every pixel in rect
+		std::pair<float, float> minMax(const cv::Mat &depth, const cv::Rect &rect, int range);
+
+		// Only pixels inside contours[contourIdx]
+		std::pair<float, float> minMax(const cv::Mat &depth,
+				const std::vector<std::vector<cv::Point> > &contours,
+				int contourIdx, int range);
+
+	private:
+		std::pair<float, float> minMaxMasked(const cv::Mat &depth, const cv::Rect &roi, const cv::Mat &mask, int range);
+
+		// Contour mask, only as big as the largest
+		// contour bounding rect seen so far
+		cv::Mat _maskBuffer;
+};
+
 void shrinkRect(cv::Rect &rect_in, float shrink_factor);
 
 //void printIsometry(const Eigen::Transform<double, 3, Eigen::Isometry> m);
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#include "assignment.hpp"
+#include "hungarian.hpp"
+
+using namespace std;
+
+SparseAssignmentSolver::SparseAssignmentSolver(TMethod method) :
+	method_(method),
+	stamp_(0)
+{
+}
+
+double SparseAssignmentSolver::Solve(int rows, int cols, vector<AssignmentEdge> &edges, vector<int> &assignment)
+{
+	assignment.assign(rows, -1);
+	if (edges.empty())
+		return 0;
+
+	switch (method_)
+	{
+		case munkres:          solveMunkres(rows, cols, edges, assignment); break;
+		case jonker_volgenant: solveJV(rows, cols, edges, assignment); break;
+		case greedy:           solveGreedy(rows, cols, edges, assignment); break;
+	}
+
+	double cost = 0;
+	for (auto it = edges.cbegin(); it != edges.cend(); ++it)
+		if (assignment[it->row] == it->col)
+			cost += it->cost;
+	return cost;
+}
+
+// Union-find root lookup with path halving
+int SparseAssignmentSolver::findComponent(int node)
+{
+	while (componentParent_[node] != node)
+	{
+		componentParent_[node] = componentParent_[componentParent_[node]];
+		node = componentParent_[node];
+	}
+	return node;
+}
+
+// Rows and columns which share edges form connected groups
+// which can be solved independently - for tracking each one
+// is typically one or two objects, so run Munkres on lots
+// of tiny cost matrices rather than one big one. Pairs not
+// connected by an edge get a cost large enough that they're
+// only picked when nothing else fits, and are then thrown out
+void SparseAssignmentSolver::solveMunkres(int rows, int cols, vector<AssignmentEdge> &edges, vector<int> &assignment)
+{
+	componentParent_.resize(rows + cols);
+	for (int i = 0; i < rows + cols; i++)
+		componentParent_[i] = i;
+	double forbiddenCost = 1;
+	for (auto it = edges.cbegin(); it != edges.cend(); ++it)
+	{
+		const int a = findComponent(it->row);
+		const int b = findComponent(rows + it->col);
+		if (a != b)
+			componentParent_[b] = a;
+		forbiddenCost += fabs(it->cost);
+	}
+
+	// Group edges by component. Reuse localIndex_ to hold
+	// the component of each edge's row while sorting
+	localIndex_.resize(rows + cols);
+	for (int i = 0; i < rows; i++)
+		localIndex_[i] = findComponent(i);
+	sort(edges.begin(), edges.end(),
+		 [this](const AssignmentEdge &a, const AssignmentEdge &b)
+		 {
+			 if (localIndex_[a.row] != localIndex_[b.row])
+				 return localIndex_[a.row] < localIndex_[b.row];
+			 if (a.row != b.row)
+				 return a.row < b.row;
+			 return a.col < b.col;
+		 });
+	fill(localIndex_.begin(), localIndex_.end(), -1);
+
+	AssignmentProblemSolver APS;
+	for (size_t begin = 0; begin < edges.size(); )
+	{
+		const int component = findComponent(edges[begin].row);
+		size_t end = begin + 1;
+		while ((end < edges.size()) && (findComponent(edges[end].row) == component))
+			end += 1;
+
+		// One row, one column, nothing else connected
+		if ((end - begin) == 1)
+		{
+			assignment[edges[begin].row] = edges[begin].col;
+			begin = end;
+			continue;
+		}
+
+		componentRows_.clear();
+		componentCols_.clear();
+		for (size_t e = begin; e < end; e++)
+		{
+			if (localIndex_[edges[e].row] < 0)
+			{
+				localIndex_[edges[e].row] = componentRows_.size();
+				componentRows_.push_back(edges[e].row);
+			}
+			if (localIndex_[rows + edges[e].col] < 0)
+			{
+				localIndex_[rows + edges[e].col] = componentCols_.size();
+				componentCols_.push_back(edges[e].col);
+			}
+		}
+		componentCost_.resize(componentRows_.size());
+		for (size_t r = 0; r < componentRows_.size(); r++)
+			componentCost_[r].assign(componentCols_.size(), forbiddenCost);
+		for (size_t e = begin; e < end; e++)
+			componentCost_[localIndex_[edges[e].row]][localIndex_[rows + edges[e].col]] = edges[e].cost;
+
+		APS.Solve(componentCost_, componentAssignment_, AssignmentProblemSolver::optimal);
+		for (size_t r = 0; r < componentRows_.size(); r++)
+		{
+			const int c = componentAssignment_[r];
+			if ((c != -1) && (componentCost_[r][c] < forbiddenCost))
+				assignment[componentRows_[r]] = componentCols_[c];
+		}
+
+		for (auto it = componentRows_.cbegin(); it != componentRows_.cend(); ++it)
+			localIndex_[*it] = -1;
+		for (auto it = componentCols_.cbegin(); it != componentCols_.cend(); ++it)
+			localIndex_[rows + *it] = -1;
+		begin = end;
+	}
+}
+
+// Shortest augmenting path assignment (the core of
+// Jonker-Volgenant) over the sparse edge list. Rows are added
+// one at a time. For each, Dijkstra over reduced costs
+// c(r,c) - rowPotential_[r] - colPotential_[c] finds the
+// cheapest way to fit it in by shifting already matched rows
+// along alternating paths, then potentials are updated to keep
+// every reduced cost non-negative.
+//
+// Each row also gets a private "unmatched" column costing more
+// than all the real edges together, so every row can always be
+// placed and only ends up there if there's no way to match it
+// without unmatching some other row.  Costs must not be negative
+void SparseAssignmentSolver::solveJV(int rows, int cols, vector<AssignmentEdge> &edges, vector<int> &assignment)
+{
+	// Bucket edges by row
+	sort(edges.begin(), edges.end(),
+		 [](const AssignmentEdge &a, const AssignmentEdge &b)
+		 {
+			 if (a.row != b.row)
+				 return a.row < b.row;
+			 return a.col < b.col;
+		 });
+	rowStart_.assign(rows + 1, 0);
+	double unmatchedCost = 1;
+	for (auto it = edges.cbegin(); it != edges.cend(); ++it)
+	{
+		rowStart_[it->row + 1] += 1;
+		unmatchedCost += it->cost;
+	}
+	for (int r = 0; r < rows; r++)
+		rowStart_[r + 1] += rowStart_[r];
+
+	// Column cols + r is row r's unmatched column
+	const int totalCols = cols + rows;
+	rowPotential_.assign(rows, 0);
+	colPotential_.assign(totalCols, 0);
+	colMatch_.assign(totalCols, -1);
+	colDist_.resize(totalCols);
+	colPred_.resize(totalCols);
+	if ((int)colDone_.size() < totalCols)
+	{
+		colDone_.resize(totalCols, stamp_);
+		colSeen_.resize(totalCols, stamp_);
+	}
+
+	const greater<pair<double, int> > heapCompare;
+	for (int r = 0; r < rows; r++)
+	{
+		// Skip rows with no edges - they can only be unmatched
+		if (rowStart_[r] == rowStart_[r + 1])
+			continue;
+
+		stamp_ += 1;
+		doneCols_.clear();
+		heap_.clear();
+
+		int    row     = r;
+		double rowDist = 0;
+		int    sink    = -1;
+		double sinkDist = 0;
+		while (true)
+		{
+			// Relax edges out of row, including its unmatched column
+			const double base = rowDist - rowPotential_[row];
+			for (int e = rowStart_[row]; e <= rowStart_[row + 1]; e++)
+			{
+				const bool   unmatched = (e == rowStart_[row + 1]);
+				const int    c    = unmatched ? (cols + row) : edges[e].col;
+				const double cost = unmatched ? unmatchedCost : edges[e].cost;
+				if (colDone_[c] == stamp_)
+					continue;
+				const double d = base + cost - colPotential_[c];
+				if ((colSeen_[c] != stamp_) || (d < colDist_[c]))
+				{
+					colSeen_[c] = stamp_;
+					colDist_[c] = d;
+					colPred_[c] = row;
+					heap_.push_back(make_pair(d, c));
+					push_heap(heap_.begin(), heap_.end(), heapCompare);
+				}
+			}
+
+			// Closest column not yet finalized. The row's own
+			// unmatched column is always reachable, so the heap
+			// can't run dry before a free column is found
+			int c;
+			double d;
+			do
+			{
+				pop_heap(heap_.begin(), heap_.end(), heapCompare);
+				d = heap_.back().first;
+				c = heap_.back().second;
+				heap_.pop_back();
+			}
+			while ((colDone_[c] == stamp_) || (d > colDist_[c]));
+
+			colDone_[c] = stamp_;
+			doneCols_.push_back(c);
+			if (colMatch_[c] == -1)
+			{
+				sink     = c;
+				sinkDist = d;
+				break;
+			}
+			row     = colMatch_[c];
+			rowDist = d;
+		}
+
+		// Update potentials for everything finalized this search
+		rowPotential_[r] += sinkDist;
+		for (auto it = doneCols_.cbegin(); it != doneCols_.cend(); ++it)
+		{
+			const double delta = sinkDist - colDist_[*it];
+			colPotential_[*it] -= delta;
+			if (colMatch_[*it] != -1)
+				rowPotential_[colMatch_[*it]] += delta;
+		}
+
+		// Flip matches along the path back to r
+		int c = sink;
+		while (true)
+		{
+			const int pred = colPred_[c];
+			const int prev = assignment[pred];
+			colMatch_[c]     = pred;
+			assignment[pred] = c;
+			if (pred == r)
+				break;
+			c = prev;
+		}
+	}
+
+	for (int r = 0; r < rows; r++)
+		if (assignment[r] >= cols)
+			assignment[r] = -1;
+}
+
+// Take edges cheapest first as long as neither end is
+// already used
+void SparseAssignmentSolver::solveGreedy(int rows, int cols, vector<AssignmentEdge> &edges, vector<int> &assignment)
+{
+	(void)rows;
+	sort(edges.begin(), edges.end(),
+		 [](const AssignmentEdge &a, const AssignmentEdge &b)
+		 {
+			 if (a.cost != b.cost)
+				 return a.cost < b.cost;
+			 if (a.row != b.row)
+				 return a.row < b.row;
+			 return a.col < b.col;
+		 });
+	colUsed_.assign(cols, 0);
+	for (auto it = edges.cbegin(); it != edges.cend(); ++it)
+	{
+		if ((assignment[it->row] == -1) && !colUsed_[it->col])
+		{
+			assignment[it->row] = it->col;
+			colUsed_[it->col]   = 1;
+		}
+	}
+}
@@ -0,0 +1,79 @@
+// Assignment solvers working on a sparse list of allowed
+// row / column pairs rather than a dense cost matrix.
+//
+// Pairs not in the list can never be matched.  Each solver
+// matches as many rows as it can, then among those picks the
+// lowest total cost (greedy only approximates this).
+//
+// Methods :
+//   munkres          - split the pairs into independent connected
+//                      groups and run the dense Munkres solver
+//                      from hungarian.cpp on each one
+//   jonker_volgenant - shortest augmenting path on the sparse
+//                      edge list with dual potentials. Same results
+//                      as munkres, without building any dense matrix
+//   greedy           - take pairs cheapest first. Not optimal when
+//                      candidates compete, but fine when objects are
+//                      spread out, which is the usual case
+//
+// Scratch space is kept between calls, so reuse one solver
+// rather than creating one per frame.
+#pragma once
+
+#include <vector>
+
+struct AssignmentEdge
+{
+	int    row;
+	int    col;
+	double cost;
+};
+
+class SparseAssignmentSolver
+{
+	public:
+		enum TMethod { munkres, jonker_volgenant, greedy };
+
+		SparseAssignmentSolver(TMethod method = jonker_volgenant);
+
+		void    setMethod(TMethod method) { method_ = method; }
+		TMethod method(void) const { return method_; }
+
+		// Fills assignment[row] with the column matched to each
+		// of the rows, or -1 if that row is unmatched. The edge
+		// list may be reordered. Returns the total cost of the
+		// matched pairs
+		double Solve(int rows, int cols, std::vector<AssignmentEdge> &edges, std::vector<int> &assignment);
+
+	private:
+		TMethod method_;
+
+		void solveMunkres(int rows, int cols, std::vector<AssignmentEdge> &edges, std::vector<int> &assignment);
+		void solveJV(int rows, int cols, std::vector<AssignmentEdge> &edges, std::vector<int> &assignment);
+		void solveGreedy(int rows, int cols, std::vector<AssignmentEdge> &edges, std::vector<int> &assignment);
+		int  findComponent(int node);
+
+		// munkres scratch
+		std::vector<int>                  componentParent_;
+		std::vector<int>                  localIndex_;
+		std::vector<int>                  componentRows_;
+		std::vector<int>                  componentCols_;
+		std::vector<std::vector<double> > componentCost_;
+		std::vector<int>                  componentAssignment_;
+
+		// jonker_volgenant scratch
+		std::vector<int>    rowStart_;     // edges_ for row r are rowStart_[r] .. rowStart_[r+1]-1
+		std::vector<double> rowPotential_;
+		std::vector<double> colPotential_;
+		std::vector<int>    colMatch_;
+		std::vector<double> colDist_;
+		std::vector<int>    colPred_;
+		std::vector<int>    colDone_;      // stamp of the last search which finalized the column
+		std::vector<int>    colSeen_;      // stamp of the last search which reached the column
+		std::vector<int>    doneCols_;
+		std::vector<std::pair<double, int> > heap_;
+		int                 stamp_;
+
+		// greedy scratch
+		std::vector<unsigned char> colUsed_;
+};
@@ -0,0 +1,206 @@
+// Benchmark the SparseAssignmentSolver methods against the
+// dense Munkres solver the tracker used to run on every frame.
+// Builds random tracking scenes - tracks scattered over a field,
+// detections near most of them plus a few spurious ones - and
+// times each solver on the same scenes.  Also checks that the
+// munkres and jonker_volgenant methods agree with each other
+// and reports how far greedy is from optimal.
+// Usage : assignment_bench [frames per scene]
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "assignment.hpp"
+#include "hungarian.hpp"
+
+using namespace std;
+
+// Same gate as the tracker - pairs further apart than
+// this are never matched
+const double gateDist = 1.0;
+
+struct Scene
+{
+	int rows;
+	int cols;
+	vector<double> rowX, rowY;
+	vector<double> colX, colY;
+	vector<AssignmentEdge> edges;
+};
+
+static double dist(const Scene &s, int r, int c)
+{
+	const double dx = s.rowX[r] - s.colX[c];
+	const double dy = s.rowY[r] - s.colY[c];
+	return sqrt(dx * dx + dy * dy);
+}
+
+// objects tracks spread over a square field sized so there are
+// density objects per square meter.  90% of them are redetected
+// with some position noise, plus 10% extra random detections
+static Scene makeScene(mt19937 &rng, int objects, double density)
+{
+	const double fieldSize = sqrt(objects / density);
+	uniform_real_distribution<double> field(0, fieldSize);
+	normal_distribution<double>       noise(0, 0.2);
+	uniform_real_distribution<double> unit(0, 1);
+
+	Scene s;
+	s.rows = objects;
+	for (int r = 0; r < objects; r++)
+	{
+		s.rowX.push_back(field(rng));
+		s.rowY.push_back(field(rng));
+		if (unit(rng) < 0.9)
+		{
+			s.colX.push_back(s.rowX.back() + noise(rng));
+			s.colY.push_back(s.rowY.back() + noise(rng));
+		}
+	}
+	for (int i = 0; i < objects / 10; i++)
+	{
+		s.colX.push_back(field(rng));
+		s.colY.push_back(field(rng));
+	}
+	s.cols = s.colX.size();
+
+	for (int r = 0; r < s.rows; r++)
+	{
+		for (int c = 0; c < s.cols; c++)
+		{
+			const double d = dist(s, r, c);
+			if (d <= gateDist)
+			{
+				AssignmentEdge edge;
+				edge.row  = r;
+				edge.col  = c;
+				edge.cost = d;
+				s.edges.push_back(edge);
+			}
+		}
+	}
+	return s;
+}
+
+struct Result
+{
+	double usec;
+	double matched;
+	double cost;
+};
+
+// What the tracker used to do - full tracks x detections
+// distance matrix, Munkres, then drop pairs over the gate
+static Result runDense(const vector<Scene> &scenes)
+{
+	Result res = {0, 0, 0};
+	AssignmentProblemSolver APS;
+	vector<int> assignment;
+	const auto start = chrono::steady_clock::now();
+	for (auto s = scenes.cbegin(); s != scenes.cend(); ++s)
+	{
+		if (s->cols == 0)
+			continue;
+		vector<vector<double> > cost(s->rows, vector<double>(s->cols));
+		for (int r = 0; r < s->rows; r++)
+			for (int c = 0; c < s->cols; c++)
+				cost[r][c] = dist(*s, r, c);
+		APS.Solve(cost, assignment, AssignmentProblemSolver::optimal);
+		for (int r = 0; r < s->rows; r++)
+		{
+			if ((assignment[r] != -1) && (cost[r][assignment[r]] <= gateDist))
+			{
+				res.matched += 1;
+				res.cost    += cost[r][assignment[r]];
+			}
+		}
+	}
+	res.usec = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / scenes.size();
+	return res;
+}
+
+static Result runSparse(const vector<Scene> &scenes, SparseAssignmentSolver::TMethod method)
+{
+	Result res = {0, 0, 0};
+	SparseAssignmentSolver solver(method);
+	vector<AssignmentEdge> edges;
+	vector<int> assignment;
+	double usec = 0;
+	for (size_t i = 0; i < scenes.size(); i++)
+	{
+		// Solve() reorders edges, so time it on a fresh copy
+		edges = scenes[i].edges;
+		const auto start = chrono::steady_clock::now();
+		res.cost += solver.Solve(scenes[i].rows, scenes[i].cols, edges, assignment);
+		usec += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+		for (auto it = assignment.cbegin(); it != assignment.cend(); ++it)
+			if (*it != -1)
+				res.matched += 1;
+	}
+	res.usec = usec / scenes.size();
+	return res;
+}
+
+static void printResult(const char *name, const Result &res, const Result &best)
+{
+	cout << "  " << left << setw(18) << name << right
+		 << setw(10) << fixed << setprecision(1) << res.usec << " usec/frame"
+		 << setw(10) << setprecision(0) << res.matched << " matched"
+		 << setw(12) << setprecision(3) << res.cost << " cost";
+	// Cost is only comparable when the same number of
+	// pairs were matched
+	if (res.matched < best.matched)
+		cout << " (" << setprecision(0) << best.matched - res.matched << " fewer matches)";
+	else if (best.cost > 0)
+		cout << " (" << setprecision(2) << fabs(100.0 * (res.cost - best.cost) / best.cost) << "% over optimal)";
+	cout << endl;
+}
+
+int main(int argc, char **argv)
+{
+	const int frames = (argc > 1) ? atoi(argv[1]) : 200;
+	const int    objectCounts[] = { 4, 16, 64, 256 };
+	const double densities[]    = { 0.05, 1.0 };    // objects per square meter
+	const char  *densityNames[] = { "sparse", "crowded" };
+
+	bool ok = true;
+	mt19937 rng(12345);
+	for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++)
+	{
+		for (size_t o = 0; o < sizeof(objectCounts) / sizeof(objectCounts[0]); o++)
+		{
+			vector<Scene> scenes;
+			size_t edgeCount = 0;
+			for (int f = 0; f < frames; f++)
+			{
+				scenes.push_back(makeScene(rng, objectCounts[o], densities[d]));
+				edgeCount += scenes.back().edges.size();
+			}
+			cout << objectCounts[o] << " objects, " << densityNames[d] << ", "
+				 << fixed << setprecision(1) << (double)edgeCount / frames << " gated pairs/frame" << endl;
+
+			const Result dense   = runDense(scenes);
+			const Result munkres = runSparse(scenes, SparseAssignmentSolver::munkres);
+			const Result jv      = runSparse(scenes, SparseAssignmentSolver::jonker_volgenant);
+			const Result greedy  = runSparse(scenes, SparseAssignmentSolver::greedy);
+
+			printResult("dense munkres", dense, jv);
+			printResult("munkres", munkres, jv);
+			printResult("jonker_volgenant", jv, jv);
+			printResult("greedy", greedy, jv);
+
+			// Both optimal methods should match the same number
+			// of pairs for the same total cost. Individual pairs
+			// can differ when there are ties
+			if ((munkres.matched != jv.matched) || (fabs(munkres.cost - jv.cost) > 1e-6 * frames))
+			{
+				cerr << "munkres and jonker_volgenant results differ" << endl;
+				ok = false;
+			}
+		}
+	}
+	return ok ? 0 : 1;
+}
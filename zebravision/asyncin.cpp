@@ -44,25 +44,20 @@ void AsyncIn::update(void)
 
 		boost::lock_guard<boost::mutex> guard(mtx_);
 
-		// Now have exclusive access to frame_
-		// and depth_.  Update them from the input
-		// source here
-		if (!good || !postLockUpdate(frame_, depth_))
+		// Now have exclusive access to frame_.
+		// Read the input source into the raw
+		// buffers then move it into a pooled
+		// buffer to hand out
+		if (!good || !postLockUpdate(rawFrame_, rawDepth_))
 		{
 			good = false;
-			frame_ = Mat();
-			depth_ = Mat();
+			frame_.reset();
 		}
 		else
 		{
 			setTimeStamp();
 			incFrameNumber();
-			while (frame_.rows > 700)
-			{
-				pyrDown(frame_, frame_);
-				if (!depth_.empty())
-					pyrDown(depth_, depth_);
-			}
+			frame_ = pool_.publish(rawFrame_, rawDepth_);
 		}
 
 		// Signal that update loop has made it through
@@ -75,7 +70,7 @@ void AsyncIn::update(void)
 }
 
 
-bool AsyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
+bool AsyncIn::getSharedFrame(SharedFrame &frame, bool pause)
 {
 	if (!isOpened())
 		return false;
@@ -83,7 +78,7 @@ bool AsyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
 	if (!pause)
 	{
 		// Make sure only one thread is accessing
-		// shared frame_ and depth_ buffers at once
+		// shared frame_ at once
 		boost::mutex::scoped_lock guard(mtx_);
 
 		// Only needed to make sure the first
@@ -92,27 +87,38 @@ bool AsyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
 		while (!updateStarted_)
 			condVar_.wait(guard);
 
-		// Use an empty mat to signal an error 
+		// Use an empty frame to signal an error 
 		// happened in update
-		if (frame_.empty())
+		if (!frame_ || frame_->frame.empty())
 			return false;
 
 		// Lock in the time and frame number associated
-		// with depth_ and frame_ so they're returned when
+		// with frame_ so they're returned when
 		// queried from the main code
 		lockTimeStamp();
 		lockFrameNumber();
-		frame_.copyTo(pausedFrame_);
-		depth_.copyTo(pausedDepth_);
+		pausedFrame_ = frame_;
 	}
 
-	// Use an empty mat to signal an error 
+	// Use an empty frame to signal an error 
 	// happened in update
-	if (pausedFrame_.empty())
+	if (!pausedFrame_)
 		return false;
 
-	pausedFrame_.copyTo(frame);
-	pausedDepth_.copyTo(depth);
+	frame = pausedFrame_;
 	return true;
 }
 
+
+// Callers of this version are free to draw on the
+// frame returned, so give them their own copy
+bool AsyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
+{
+	SharedFrame sharedFrame;
+	if (!getSharedFrame(sharedFrame, pause))
+		return false;
+
+	sharedFrame->frame.copyTo(frame);
+	sharedFrame->depth.copyTo(depth);
+	return true;
+}
@@ -20,6 +20,7 @@ class AsyncIn: public MediaIn
 		AsyncIn(ZvSettings *settings = NULL);
 
 		bool getFrame(cv::Mat &frame, cv::Mat &depth, bool pause = false);
+		bool getSharedFrame(SharedFrame &frame, bool pause = false);
 
 	protected:
 		// Derived classes need to start and stop
@@ -38,17 +39,21 @@ class AsyncIn: public MediaIn
 		virtual bool postLockUpdate(cv::Mat &frame, cv::Mat &depth) = 0;
 
 	private:
-		// Input is buffered several times
+		// rawFrame_ and rawDepth_ are what postLockUpdate
+		// reads the camera into. They're published into a
+		// buffer from pool_ - downscaled there if needed -
+		// and handed out without copying from then on.
 		// frame_ is the most recent frame grabbed from 
 		// the camera
 		// pausedFrame_ is the most recent frame returned
 		// from a call to getFrame. If video is paused, this
 		// frame is returned multiple times until the
 		// GUI is unpaused
-		cv::Mat           frame_;
-		cv::Mat           depth_;
-		cv::Mat           pausedFrame_;
-		cv::Mat           pausedDepth_;
+		FramePool         pool_;
+		cv::Mat           rawFrame_;
+		cv::Mat           rawDepth_;
+		SharedFrame       frame_;
+		SharedFrame       pausedFrame_;
 
 		// Mutex used to protect frame_
 		// from simultaneous accesses 
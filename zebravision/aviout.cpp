@@ -21,9 +21,10 @@ AVIOut::AVIOut(const char *outFile, const Size &size, int frameSkip):
 }
 
 // Delete the writer_ object to close that
-// output file
+// output file. Finish any queued writes first
 AVIOut::~AVIOut()
 {
+	sync();
 	if (writer_)
 		delete writer_;
 }
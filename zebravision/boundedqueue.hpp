@@ -0,0 +1,91 @@
+// Fixed-capacity FIFO used to pass work between threads.
+// push() blocks while the queue is full and pop() blocks
+// while it is empty. This keeps a fast producer from running
+// arbitrarily far ahead of a slow consumer - memory use is
+// capped at capacity entries no matter how the stages
+// are balanced.
+// close() wakes up everyone waiting. After that push() fails
+// and pop() drains whatever is left before returning false.
+// This is how end-of-input is passed down a chain of stages.
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <boost/thread.hpp>
+
+template <class T>
+class BoundedQueue
+{
+	public:
+		BoundedQueue(size_t capacity) :
+			capacity_(std::max<size_t>(capacity, 1)),
+			closed_(false)
+		{
+		}
+
+		// Add an item to the end of the queue, waiting
+		// for room if needed. Returns false if the queue
+		// was closed before the item could be added
+		bool push(const T &item)
+		{
+			boost::mutex::scoped_lock lock(mtx_);
+			while (!closed_ && (queue_.size() >= capacity_))
+				notFull_.wait(lock);
+			if (closed_)
+				return false;
+			queue_.push_back(item);
+			notEmpty_.notify_one();
+			return true;
+		}
+
+		// Add an item only if there's room for it right now.
+		// Returns false without waiting if the queue is full
+		// or closed
+		bool tryPush(const T &item)
+		{
+			boost::mutex::scoped_lock lock(mtx_);
+			if (closed_ || (queue_.size() >= capacity_))
+				return false;
+			queue_.push_back(item);
+			notEmpty_.notify_one();
+			return true;
+		}
+
+		// Remove the item at the front of the queue, waiting
+		// for one to show up if needed. Returns false once
+		// the queue is both closed and empty
+		bool pop(T &item)
+		{
+			boost::mutex::scoped_lock lock(mtx_);
+			while (!closed_ && queue_.empty())
+				notEmpty_.wait(lock);
+			if (queue_.empty())
+				return false;
+			item = queue_.front();
+			queue_.pop_front();
+			notFull_.notify_one();
+			return true;
+		}
+
+		void close(void)
+		{
+			boost::mutex::scoped_lock lock(mtx_);
+			closed_ = true;
+			notFull_.notify_all();
+			notEmpty_.notify_all();
+		}
+
+		size_t size(void) const
+		{
+			boost::mutex::scoped_lock lock(mtx_);
+			return queue_.size();
+		}
+
+	private:
+		std::deque<T>             queue_;
+		size_t                    capacity_;
+		bool                      closed_;
+		mutable boost::mutex      mtx_;
+		boost::condition_variable notFull_;
+		boost::condition_variable notEmpty_;
+};
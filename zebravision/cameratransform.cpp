@@ -0,0 +1,177 @@
+#include <cmath>
+#include <iostream>
+
+#include "cameratransform.hpp"
+
+using namespace std;
+using namespace cv;
+
+CameraTransform::CameraTransform(const Point2f &fovSize, const Size &frameSize, float cameraElevation) :
+	fovSize_(fovSize),
+	frameSize_(frameSize),
+	cameraElevation_(cameraElevation)
+{
+	// Start off with an identity transform
+	transform_[0] = 1; transform_[1] = 0; transform_[2] = 0;
+	transform_[3] = 0; transform_[4] = 1; transform_[5] = 0;
+}
+
+// Angle from the center of the screen to screen column x
+float CameraTransform::azimuth(float x) const
+{
+	const float distToCenter = x - (frameSize_.width / 2.0);
+	const float percentFov   = distToCenter / frameSize_.width;
+	return percentFov * fovSize_.x;
+}
+
+// Angle above horizontal of screen row y
+float CameraTransform::inclination(float y) const
+{
+	const float distToCenter = -y + (frameSize_.height / 2.0);
+	const float percentFov   = distToCenter / frameSize_.height;
+	return percentFov * fovSize_.y - cameraElevation_;
+}
+
+Point3f CameraTransform::screenToWorld(const Rect &screenPosition, double avgDepth) const
+{
+	/*
+	Method:
+		find the center of the rect
+		compute the distance from the center of the rect to center of image (pixels)
+		convert to degrees based on fov and image size
+		do a polar to cartesian cordinate conversion to find x,y,z of object
+	Equations:
+		x=rsin(inclination) * cos(azimuth)
+		y=rsin(inclination) * sin(azimuth)
+		z=rcos(inclination)
+	Notes:
+		Z is up, X is left-right, and Y is forward
+		(0,0,0) = (r,0,0) = right in front of you
+	*/
+
+	Point2f rect_center(
+			screenPosition.tl().x + (screenPosition.width  / 2.0),
+			screenPosition.tl().y + (screenPosition.height / 2.0));
+
+// TODO : replace with formula from http://www.chiefdelphi.com/forums/showpost.php?p=1571187&postcount=4
+// need focal length from camera information
+	const float az  = azimuth(rect_center.x);
+	const float inc = inclination(rect_center.y);
+
+	return Point3f(
+			avgDepth * cosf(inc) * sinf(az),
+			avgDepth * cosf(inc) * cosf(az),
+			avgDepth * sinf(inc));
+}
+
+Rect CameraTransform::worldToScreen(const Point3f &position, const ObjectType &type) const
+{
+	// TODO : replace magic numbers with an object depth property
+	// This constant is half a ball diameter (9.75-ish inches), converted to meters
+	// For example, goals will have 0 depth since we're just shooting at
+	// a plane. 3d objects will have depth, though, so we track the center of the
+	// rather than the front.
+	float r = sqrtf(position.x * position.x + position.y * position.y + position.z * position.z); // - (4.572 * 25.4)/1000.0;
+	float azimuth = asinf(position.x / sqrt(position.x * position.x + position.y * position.y));
+	float inclination = asinf( position.z / r ) + cameraElevation_;
+
+	Point2f percent_fov(azimuth / fovSize_.x, inclination / fovSize_.y);
+	Point2f dist_to_center(percent_fov.x * frameSize_.width,
+			               percent_fov.y * frameSize_.height);
+
+	Point2f rect_center(
+			dist_to_center.x + (frameSize_.width / 2.0),
+			-dist_to_center.y + (frameSize_.height / 2.0));
+
+	Point2f angular_size( 2.0 * atan2f(type.width(), (2.0*r)), 2.0 * atan2f(type.height(), (2.0*r)));
+	Point2f screen_size(
+			angular_size.x * (frameSize_.width / fovSize_.x),
+			angular_size.y * (frameSize_.height / fovSize_.y));
+
+	Point topLeft(
+			cvRound(rect_center.x - (screen_size.x / 2.0)),
+			cvRound(rect_center.y - (screen_size.y / 2.0)));
+	return Rect(topLeft.x, topLeft.y, cvRound(screen_size.x), cvRound(screen_size.y));
+}
+
+bool CameraTransform::setScreenTransform(const Mat &transformMat)
+{
+	if ((transformMat.type() != CV_64FC1) || (transformMat.rows < 2) || (transformMat.cols != 3))
+	{
+		cerr << "CameraTransform::setScreenTransform : expecting a 2x3 or 3x3 CV_64FC1 matrix" << endl;
+		return false;
+	}
+	for (int r = 0; r < 2; r++)
+		for (int c = 0; c < 3; c++)
+			transform_[r * 3 + c] = transformMat.at<double>(r, c);
+	return true;
+}
+
+void CameraTransform::buildTrigTables(void)
+{
+	colSin_.resize(frameSize_.width);
+	colCos_.resize(frameSize_.width);
+	for (int x = 0; x < frameSize_.width; x++)
+	{
+		const float az = azimuth(x);
+		colSin_[x] = sinf(az);
+		colCos_[x] = cosf(az);
+	}
+	rowSin_.resize(frameSize_.height);
+	rowCos_.resize(frameSize_.height);
+	for (int y = 0; y < frameSize_.height; y++)
+	{
+		const float inc = inclination(y);
+		rowSin_[y] = sinf(inc);
+		rowCos_[y] = cosf(inc);
+	}
+}
+
+void CameraTransform::adjust(Point3f *positions, size_t count, const ObjectType &type, float depth)
+{
+	if (colSin_.empty())
+		buildTrigTables();
+
+	const double *t = transform_;
+	for (size_t i = 0; i < count; i++)
+	{
+		// Center of the object's rect on the screen
+		const Rect screenRect = worldToScreen(positions[i], type);
+		const int  sx = screenRect.x + screenRect.width / 2;
+		const int  sy = screenRect.y + screenRect.height / 2;
+
+		// Move it, truncating back to a pixel location
+		const int x = t[0] * sx + t[1] * sy + t[2];
+		const int y = t[3] * sx + t[4] * sy + t[5];
+
+		// Back to world coords. Most points stay on screen so
+		// the trig comes from the tables, anything which has
+		// moved off the edge is computed directly
+		float sinAz, cosAz, sinInc, cosInc;
+		if ((x >= 0) && (x < frameSize_.width))
+		{
+			sinAz = colSin_[x];
+			cosAz = colCos_[x];
+		}
+		else
+		{
+			const float az = azimuth(x);
+			sinAz = sinf(az);
+			cosAz = cosf(az);
+		}
+		if ((y >= 0) && (y < frameSize_.height))
+		{
+			sinInc = rowSin_[y];
+			cosInc = rowCos_[y];
+		}
+		else
+		{
+			const float inc = inclination(y);
+			sinInc = sinf(inc);
+			cosInc = cosf(inc);
+		}
+
+		const double d = depth;
+		positions[i] = Point3f(d * cosInc * sinAz, d * cosInc * cosAz, d * sinInc);
+	}
+}
@@ -0,0 +1,66 @@
+// Conversions between screen coords + depth and 3d world coords
+// for a given camera field of view, frame size and camera
+// elevation.  Also moves world positions by the 2d screen-space
+// transform from FlowLocalizer, in bulk.
+//
+// adjust() is the per-frame path for tracking - every tracked
+// object and every entry of its position history gets pushed
+// through screen -> transform -> world each frame.  The transform
+// coefficients are copied out of the cv::Mat once per frame
+// with setScreenTransform(), and the sin/cos of the azimuth and
+// inclination for every pixel column and row are cached the
+// first time they're needed, so the per-point cost is a handful
+// of multiplies plus the world -> screen projection, with no
+// memory allocation.
+#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "objtype.hpp"
+
+class CameraTransform
+{
+	public:
+		CameraTransform(const cv::Point2f &fovSize, const cv::Size &frameSize, float cameraElevation = 0.0f);
+
+		// Convert a rect on screen plus depth into a world position
+		cv::Point3f screenToWorld(const cv::Rect &screenPosition, double avgDepth) const;
+
+		// Get position of a rect on the screen corresponding to
+		// the object size and location - inverse of screenToWorld
+		cv::Rect worldToScreen(const cv::Point3f &position, const ObjectType &type) const;
+
+		// Grab the transform used by adjust(). transformMat
+		// is a 3x3 (or 2x3) CV_64F matrix mapping homogeneous
+		// screen coords from the previous frame to this one.
+		// Returns false and leaves the old transform in
+		// place if it isn't
+		bool setScreenTransform(const cv::Mat &transformMat);
+
+		// Move count world positions in place by the current
+		// screen transform : project each to the screen, transform
+		// the center of its screen rect, then convert back to world
+		// coords at depth. type gives the object size used for
+		// the screen rect
+		void adjust(cv::Point3f *positions, size_t count, const ObjectType &type, float depth);
+
+	private:
+		cv::Point2f fovSize_;
+		cv::Size    frameSize_;
+		float       cameraElevation_;
+
+		// Screen transform, row major 2x3
+		double      transform_[6];
+
+		// sin / cos of the azimuth for each pixel column and
+		// of the inclination for each pixel row
+		std::vector<float> colSin_;
+		std::vector<float> colCos_;
+		std::vector<float> rowSin_;
+		std::vector<float> rowCos_;
+
+		void buildTrigTables(void);
+		float azimuth(float x) const;
+		float inclination(float y) const;
+};
@@ -11,9 +11,10 @@ using namespace std;
 
 int main(int argc, char **argv)
 {
-	if (argc < 2)
+	if (argc < 3)
 	{
-		cout << argv[1] << " input output" << endl;
+		cout << argv[0] << " input output [codec]" << endl;
+		cout << "  codec is one of none, zlib, lz4, zstd (default zlib)" << endl;
 		return 0;
 	}
 	string ext = boost::filesystem::extension(argv[1]);
@@ -29,13 +30,22 @@ int main(int argc, char **argv)
 		return -1;
 	}
 
-	ZMSOut out(argv[2]);
+	ZMSCodec codec = ZMS_CODEC_ZLIB;
+	if ((argc > 3) && !zmsCodecFromName(argv[3], codec))
+	{
+		cerr << "Unknown codec " << argv[3] << endl;
+		return -1;
+	}
+	ZMSOut out(argv[2], 0, codec);
+
+	// Converting a file - wait for the writer to
+	// catch up rather than dropping frames
+	out.setDropPolicy(MediaOut::BLOCK);
 
 	Mat image;
 	Mat depth;
 	while (in->getFrame(image, depth) )
 	{
-		out.sync();
 		out.saveFrame(image, depth);
 		cout << in->FPS() << " FPS" << endl;
 	}
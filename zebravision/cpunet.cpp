@@ -0,0 +1,797 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdint.h>
+
+#include <Eigen/Core>
+
+#include "cpunet.hpp"
+
+using namespace std;
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMatrixXf;
+typedef Eigen::Map<RowMatrixXf>       MatrixMap;
+typedef Eigen::Map<const RowMatrixXf> ConstMatrixMap;
+
+// Minimal parser for the protobuf text format used by
+// deploy.prototxt.  Each message is a list of
+// name : value pairs plus named sub-messages.  Field
+// types aren't checked - values are kept as strings and
+// converted when they're looked up.
+class ProtoText
+{
+	public:
+		bool parse(const string &text)
+		{
+			tokenize(text);
+			size_t pos = 0;
+			return parseMessage(pos, false);
+		}
+
+		string get(const string &name, const string &def = string()) const
+		{
+			for (auto it = values_.cbegin(); it != values_.cend(); ++it)
+				if (it->first == name)
+					return it->second;
+			return def;
+		}
+
+		int getInt(const string &name, int def) const
+		{
+			const string val = get(name);
+			return val.empty() ? def : atoi(val.c_str());
+		}
+
+		double getDouble(const string &name, double def) const
+		{
+			const string val = get(name);
+			return val.empty() ? def : atof(val.c_str());
+		}
+
+		vector<string> getAll(const string &name) const
+		{
+			vector<string> ret;
+			for (auto it = values_.cbegin(); it != values_.cend(); ++it)
+				if (it->first == name)
+					ret.push_back(it->second);
+			return ret;
+		}
+
+		vector<const ProtoText *> messages(const string &name) const
+		{
+			vector<const ProtoText *> ret;
+			for (auto it = messages_.cbegin(); it != messages_.cend(); ++it)
+				if (it->first == name)
+					ret.push_back(&it->second);
+			return ret;
+		}
+
+		const ProtoText *message(const string &name) const
+		{
+			for (auto it = messages_.cbegin(); it != messages_.cend(); ++it)
+				if (it->first == name)
+					return &it->second;
+			return NULL;
+		}
+
+	private:
+		void tokenize(const string &text)
+		{
+			tokens_.clear();
+			size_t i = 0;
+			while (i < text.size())
+			{
+				const char c = text[i];
+				if (isspace(c))
+					i += 1;
+				else if (c == '#')
+				{
+					while ((i < text.size()) && (text[i] != '\n'))
+						i += 1;
+				}
+				else if ((c == '{') || (c == '}') || (c == ':'))
+				{
+					tokens_.push_back(string(1, c));
+					i += 1;
+				}
+				else if ((c == '"') || (c == '\''))
+				{
+					// Keep the opening quote so string values can
+					// be told apart from identifiers, then strip it
+					// when the value is stored
+					string tok(1, '"');
+					for (i += 1; (i < text.size()) && (text[i] != c); i++)
+					{
+						if ((text[i] == '\\') && (i + 1 < text.size()))
+							i += 1;
+						tok += text[i];
+					}
+					tokens_.push_back(tok);
+					i += 1;
+				}
+				else
+				{
+					const size_t start = i;
+					while ((i < text.size()) && !isspace(text[i]) &&
+						   !strchr("{}:#\"'", text[i]))
+						i += 1;
+					tokens_.push_back(text.substr(start, i - start));
+				}
+			}
+		}
+
+		// Reads name : value and name { ... } entries until
+		// the closing brace (or end of input for the top level)
+		bool parseMessage(size_t &pos, bool nested)
+		{
+			while (pos < tokens_.size())
+			{
+				const string &name = tokens_[pos++];
+				if (name == "}")
+					return nested;
+				if (pos >= tokens_.size())
+					return false;
+				if (tokens_[pos] == ":")
+					pos += 1;
+				if (pos >= tokens_.size())
+					return false;
+				if (tokens_[pos] == "{")
+				{
+					pos += 1;
+					messages_.push_back(make_pair(name, ProtoText()));
+					messages_.back().second.tokens_.swap(tokens_);
+					const bool ok = messages_.back().second.parseMessage(pos, true);
+					messages_.back().second.tokens_.swap(tokens_);
+					if (!ok)
+						return false;
+				}
+				else
+				{
+					string value = tokens_[pos++];
+					if (!value.empty() && (value[0] == '"'))
+						value.erase(0, 1);
+					values_.push_back(make_pair(name, value));
+				}
+			}
+			return !nested;
+		}
+
+		vector<string> tokens_;
+		vector<pair<string, string> >    values_;
+		vector<pair<string, ProtoText> > messages_;
+};
+
+// Just enough of a protobuf binary decoder to pull the weights
+// out of a .caffemodel.  NetParameter has a list of layers
+// (field 100, or field 2 for files written by older versions
+// of Caffe) each of which has a name and a list of blobs
+class WireReader
+{
+	public:
+		WireReader(const uint8_t *data, size_t len) :
+			p_(data),
+			end_(data + len)
+		{
+		}
+
+		bool done(void) const { return p_ >= end_; }
+
+		bool readVarint(uint64_t &val)
+		{
+			val = 0;
+			for (int shift = 0; (shift < 64) && (p_ < end_); shift += 7)
+			{
+				const uint8_t b = *p_++;
+				val |= (uint64_t)(b & 0x7f) << shift;
+				if (!(b & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		bool readTag(int &field, int &wireType)
+		{
+			uint64_t tag;
+			if (!readVarint(tag))
+				return false;
+			field    = (int)(tag >> 3);
+			wireType = (int)(tag & 7);
+			return true;
+		}
+
+		bool readBytes(const uint8_t *&data, size_t &len)
+		{
+			uint64_t l;
+			if (!readVarint(l) || (l > (uint64_t)(end_ - p_)))
+				return false;
+			data = p_;
+			len  = l;
+			p_  += l;
+			return true;
+		}
+
+		bool readFloat(float &val)
+		{
+			if ((end_ - p_) < 4)
+				return false;
+			uint32_t bits = p_[0] | (p_[1] << 8) | (p_[2] << 16) | ((uint32_t)p_[3] << 24);
+			memcpy(&val, &bits, sizeof(val));
+			p_ += 4;
+			return true;
+		}
+
+		bool skip(int wireType)
+		{
+			uint64_t val;
+			const uint8_t *data;
+			size_t len;
+			switch (wireType)
+			{
+				case 0: return readVarint(val);
+				case 1: if ((end_ - p_) < 8) return false; p_ += 8; return true;
+				case 2: return readBytes(data, len);
+				case 5: if ((end_ - p_) < 4) return false; p_ += 4; return true;
+			}
+			return false;
+		}
+
+	private:
+		const uint8_t *p_;
+		const uint8_t *end_;
+};
+
+// BlobProto.data is field 5, either packed or
+// one float per entry
+static bool readBlob(const uint8_t *data, size_t len, vector<float> &blob)
+{
+	WireReader r(data, len);
+	blob.clear();
+	while (!r.done())
+	{
+		int field, wireType;
+		if (!r.readTag(field, wireType))
+			return false;
+		if ((field == 5) && (wireType == 2))
+		{
+			const uint8_t *packed;
+			size_t packedLen;
+			if (!r.readBytes(packed, packedLen) || (packedLen % 4))
+				return false;
+			WireReader pr(packed, packedLen);
+			float val;
+			while (pr.readFloat(val))
+				blob.push_back(val);
+		}
+		else if ((field == 5) && (wireType == 5))
+		{
+			float val;
+			if (!r.readFloat(val))
+				return false;
+			blob.push_back(val);
+		}
+		else if (!r.skip(wireType))
+			return false;
+	}
+	return true;
+}
+
+// Layer name and blob field numbers differ between
+// the current LayerParameter and the old V1LayerParameter
+static bool readLayer(const uint8_t *data, size_t len, bool v1,
+					  map<string, vector<vector<float> > > &weights)
+{
+	const int nameField = v1 ? 4 : 1;
+	const int blobField = v1 ? 6 : 7;
+	WireReader r(data, len);
+	string name;
+	vector<vector<float> > blobs;
+	while (!r.done())
+	{
+		int field, wireType;
+		if (!r.readTag(field, wireType))
+			return false;
+		const uint8_t *fieldData;
+		size_t fieldLen;
+		if ((field == nameField) && (wireType == 2))
+		{
+			if (!r.readBytes(fieldData, fieldLen))
+				return false;
+			name.assign((const char *)fieldData, fieldLen);
+		}
+		else if ((field == blobField) && (wireType == 2))
+		{
+			if (!r.readBytes(fieldData, fieldLen))
+				return false;
+			blobs.push_back(vector<float>());
+			if (!readBlob(fieldData, fieldLen, blobs.back()))
+				return false;
+		}
+		else if (!r.skip(wireType))
+			return false;
+	}
+	if (!blobs.empty())
+		weights[name].swap(blobs);
+	return true;
+}
+
+static bool readCaffeModel(const string &fileName, map<string, vector<vector<float> > > &weights)
+{
+	ifstream in(fileName.c_str(), ios::binary);
+	if (!in)
+		return false;
+	vector<uint8_t> buf((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+	if (buf.empty())
+		return false;
+
+	WireReader r(&buf[0], buf.size());
+	while (!r.done())
+	{
+		int field, wireType;
+		if (!r.readTag(field, wireType))
+			return false;
+		if (((field == 100) || (field == 2)) && (wireType == 2))
+		{
+			const uint8_t *data;
+			size_t len;
+			if (!r.readBytes(data, len) || !readLayer(data, len, field == 2, weights))
+				return false;
+		}
+		else if (!r.skip(wireType))
+			return false;
+	}
+	return true;
+}
+
+CPUNet::CPUNet(void) :
+	inputC_(0),
+	inputH_(0),
+	inputW_(0)
+{
+}
+
+int CPUNet::inputChannels(void) const
+{
+	return inputC_;
+}
+
+int CPUNet::inputHeight(void) const
+{
+	return inputH_;
+}
+
+int CPUNet::inputWidth(void) const
+{
+	return inputW_;
+}
+
+int CPUNet::outputSize(void) const
+{
+	if (layers_.empty())
+		return inputC_ * inputH_ * inputW_;
+	const Layer &last = layers_.back();
+	return last.outC * last.outH * last.outW;
+}
+
+bool CPUNet::load(const string &modelFile, const string &trainedFile)
+{
+	layers_.clear();
+
+	ifstream modelStream(modelFile.c_str());
+	if (!modelStream)
+	{
+		cerr << "CPUNet : could not open " << modelFile << endl;
+		return false;
+	}
+	stringstream modelText;
+	modelText << modelStream.rdbuf();
+	ProtoText model;
+	if (!model.parse(modelText.str()))
+	{
+		cerr << "CPUNet : could not parse " << modelFile << endl;
+		return false;
+	}
+
+	map<string, vector<vector<float> > > weights;
+	if (!readCaffeModel(trainedFile, weights))
+	{
+		cerr << "CPUNet : could not read weights from " << trainedFile << endl;
+		return false;
+	}
+
+	// Input shape comes from either input_shape { dim : },
+	// old-style input_dim : or an Input layer.  Dim 0 is the
+	// batch size, which is ignored since it's set per call
+	vector<string> dims;
+	if (const ProtoText *shape = model.message("input_shape"))
+		dims = shape->getAll("dim");
+	else
+		dims = model.getAll("input_dim");
+	string top = model.get("input");
+
+	const vector<const ProtoText *> layerText = model.messages("layer");
+	for (auto it = layerText.cbegin(); it != layerText.cend(); ++it)
+	{
+		const ProtoText &lt = **it;
+		const string type = lt.get("type");
+		if (type != "Input")
+			continue;
+		const ProtoText *param = lt.message("input_param");
+		const ProtoText *shape = param ? param->message("shape") : NULL;
+		if (shape)
+			dims = shape->getAll("dim");
+		top = lt.get("top");
+	}
+	if (dims.size() != 4)
+	{
+		cerr << "CPUNet : " << modelFile << " needs a 4-d input shape" << endl;
+		return false;
+	}
+	inputC_ = atoi(dims[1].c_str());
+	inputH_ = atoi(dims[2].c_str());
+	inputW_ = atoi(dims[3].c_str());
+
+	int c = inputC_;
+	int h = inputH_;
+	int w = inputW_;
+	for (auto it = layerText.cbegin(); it != layerText.cend(); ++it)
+	{
+		const ProtoText &lt = **it;
+		const string type = lt.get("type");
+		const string name = lt.get("name");
+		if (type == "Input")
+			continue;
+
+		// Only straight-line nets are supported - each layer
+		// has to take the output of the one before it
+		if (lt.get("bottom") != top)
+		{
+			cerr << "CPUNet : layer " << name << " doesn't follow " << top << endl;
+			return false;
+		}
+		top = lt.get("top");
+
+		// Dropout only matters for training
+		if (type == "Dropout")
+			continue;
+
+		Layer layer;
+		layer.name          = name;
+		layer.numOutput     = 0;
+		layer.kernelSize    = 1;
+		layer.stride        = 1;
+		layer.pad           = 0;
+		layer.negativeSlope = 0;
+		layer.inC = c;
+		layer.inH = h;
+		layer.inW = w;
+
+		size_t weightCount = 0;
+		bool   biasTerm    = false;
+
+		if (type == "Convolution")
+		{
+			const ProtoText *param = lt.message("convolution_param");
+			if (!param || (param->getInt("group", 1) != 1) || (param->getInt("dilation", 1) != 1))
+			{
+				cerr << "CPUNet : unsupported convolution " << name << endl;
+				return false;
+			}
+			layer.type       = LAYER_CONVOLUTION;
+			layer.numOutput  = param->getInt("num_output", 0);
+			layer.kernelSize = param->getInt("kernel_size", 1);
+			layer.stride     = param->getInt("stride", 1);
+			layer.pad        = param->getInt("pad", 0);
+			biasTerm         = param->get("bias_term", "true") == "true";
+			weightCount      = (size_t)layer.numOutput * c * layer.kernelSize * layer.kernelSize;
+
+			c = layer.numOutput;
+			h = (h + 2 * layer.pad - layer.kernelSize) / layer.stride + 1;
+			w = (w + 2 * layer.pad - layer.kernelSize) / layer.stride + 1;
+		}
+		else if (type == "Pooling")
+		{
+			const ProtoText *param = lt.message("pooling_param");
+			if (!param || (param->get("global_pooling", "false") != "false"))
+			{
+				cerr << "CPUNet : unsupported pooling " << name << endl;
+				return false;
+			}
+			const string pool = param->get("pool", "MAX");
+			if (pool == "MAX")
+				layer.type = LAYER_POOL_MAX;
+			else if (pool == "AVE")
+				layer.type = LAYER_POOL_AVE;
+			else
+			{
+				cerr << "CPUNet : unsupported pooling type " << pool << " in " << name << endl;
+				return false;
+			}
+			layer.kernelSize = param->getInt("kernel_size", 1);
+			layer.stride     = param->getInt("stride", 1);
+			layer.pad        = param->getInt("pad", 0);
+
+			// Caffe rounds pooling output sizes up rather than
+			// down, then makes sure the last window starts
+			// inside the image
+			int ph = (int)ceil((float)(h + 2 * layer.pad - layer.kernelSize) / layer.stride) + 1;
+			int pw = (int)ceil((float)(w + 2 * layer.pad - layer.kernelSize) / layer.stride) + 1;
+			if (layer.pad)
+			{
+				if ((ph - 1) * layer.stride >= h + layer.pad)
+					ph -= 1;
+				if ((pw - 1) * layer.stride >= w + layer.pad)
+					pw -= 1;
+			}
+			h = ph;
+			w = pw;
+		}
+		else if (type == "InnerProduct")
+		{
+			const ProtoText *param = lt.message("inner_product_param");
+			if (!param || (param->get("transpose", "false") != "false"))
+			{
+				cerr << "CPUNet : unsupported inner product " << name << endl;
+				return false;
+			}
+			layer.type      = LAYER_INNER_PRODUCT;
+			layer.numOutput = param->getInt("num_output", 0);
+			biasTerm        = param->get("bias_term", "true") == "true";
+			weightCount     = (size_t)layer.numOutput * c * h * w;
+
+			c = layer.numOutput;
+			h = 1;
+			w = 1;
+		}
+		else if (type == "ReLU")
+		{
+			layer.type = LAYER_RELU;
+			if (const ProtoText *param = lt.message("relu_param"))
+				layer.negativeSlope = param->getDouble("negative_slope", 0);
+		}
+		else if (type == "Softmax")
+		{
+			layer.type = LAYER_SOFTMAX;
+		}
+		else
+		{
+			cerr << "CPUNet : unsupported layer type " << type << " in " << name << endl;
+			return false;
+		}
+
+		if (weightCount)
+		{
+			auto blobs = weights.find(name);
+			if ((blobs == weights.end()) ||
+				(blobs->second.size() != (biasTerm ? 2U : 1U)) ||
+				(blobs->second[0].size() != weightCount) ||
+				(biasTerm && (blobs->second[1].size() != (size_t)layer.numOutput)))
+			{
+				cerr << "CPUNet : missing or wrong sized weights for " << name << endl;
+				return false;
+			}
+			layer.weights.swap(blobs->second[0]);
+			if (biasTerm)
+				layer.bias.swap(blobs->second[1]);
+			else
+				layer.bias.assign(layer.numOutput, 0.f);
+		}
+
+		if ((c <= 0) || (h <= 0) || (w <= 0))
+		{
+			cerr << "CPUNet : layer " << name << " has an empty output" << endl;
+			return false;
+		}
+		layer.outC = c;
+		layer.outH = h;
+		layer.outW = w;
+		layers_.push_back(layer);
+	}
+	return true;
+}
+
+void CPUNet::forward(const float *input, size_t batchSize, vector<float> &output)
+{
+	// Reorder input from image-major to channel-major
+	const size_t inPlane = inputH_ * inputW_;
+	in_.resize(inputC_ * batchSize * inPlane);
+	for (size_t b = 0; b < batchSize; b++)
+		for (int c = 0; c < inputC_; c++)
+			memcpy(&in_[(c * batchSize + b) * inPlane],
+				   input + (b * inputC_ + c) * inPlane,
+				   inPlane * sizeof(float));
+
+	for (auto it = layers_.cbegin(); it != layers_.cend(); ++it)
+	{
+		switch (it->type)
+		{
+			case LAYER_CONVOLUTION:
+				convolution(*it, batchSize);
+				in_.swap(out_);
+				break;
+			case LAYER_POOL_MAX:
+			case LAYER_POOL_AVE:
+				pool(*it, batchSize);
+				in_.swap(out_);
+				break;
+			case LAYER_INNER_PRODUCT:
+				innerProduct(*it, batchSize);
+				in_.swap(out_);
+				break;
+			case LAYER_RELU:
+				relu(*it, batchSize);
+				break;
+			case LAYER_SOFTMAX:
+				softmax(*it, batchSize);
+				break;
+		}
+	}
+
+	// And back to image-major for the caller
+	const int outC = layers_.empty() ? inputC_ : layers_.back().outC;
+	const size_t outPlane = outputSize() / outC;
+	output.resize(batchSize * outputSize());
+	for (size_t b = 0; b < batchSize; b++)
+		for (int c = 0; c < outC; c++)
+			memcpy(&output[(b * outC + c) * outPlane],
+				   &in_[(c * batchSize + b) * outPlane],
+				   outPlane * sizeof(float));
+}
+
+// im2col : unroll every kernel-sized window of the input into a column
+// of scratch_, one column per output pixel for every image in the batch.
+// The convolution is then weights (outC x inC*k*k) times that matrix
+void CPUNet::convolution(const Layer &layer, size_t batchSize)
+{
+	const int k = layer.kernelSize;
+	const size_t rows = (size_t)layer.inC * k * k;
+	const size_t outPlane = layer.outH * layer.outW;
+	const size_t cols = batchSize * outPlane;
+	scratch_.resize(rows * cols);
+
+	for (int c = 0; c < layer.inC; c++)
+	{
+		for (int ky = 0; ky < k; ky++)
+		{
+			for (int kx = 0; kx < k; kx++)
+			{
+				float *col = &scratch_[((c * k + ky) * k + kx) * cols];
+				for (size_t b = 0; b < batchSize; b++)
+				{
+					const float *in = &in_[(c * batchSize + b) * layer.inH * layer.inW];
+					for (int oy = 0; oy < layer.outH; oy++)
+					{
+						const int iy = oy * layer.stride - layer.pad + ky;
+						if ((iy < 0) || (iy >= layer.inH))
+						{
+							fill(col, col + layer.outW, 0.f);
+							col += layer.outW;
+							continue;
+						}
+						const float *inRow = in + iy * layer.inW;
+						for (int ox = 0; ox < layer.outW; ox++)
+						{
+							const int ix = ox * layer.stride - layer.pad + kx;
+							*col++ = ((ix >= 0) && (ix < layer.inW)) ? inRow[ix] : 0.f;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	out_.resize(layer.outC * cols);
+	ConstMatrixMap weights(&layer.weights[0], layer.outC, rows);
+	ConstMatrixMap col(&scratch_[0], rows, cols);
+	MatrixMap out(&out_[0], layer.outC, cols);
+	out.noalias() = weights * col;
+	out.colwise() += Eigen::Map<const Eigen::VectorXf>(&layer.bias[0], layer.outC);
+}
+
+// Pooling works on each channel of each image separately, so
+// the channel-major layout doesn't matter here
+void CPUNet::pool(const Layer &layer, size_t batchSize)
+{
+	const size_t planes = layer.inC * batchSize;
+	const int k = layer.kernelSize;
+	out_.resize(planes * layer.outH * layer.outW);
+	for (size_t p = 0; p < planes; p++)
+	{
+		const float *in = &in_[p * layer.inH * layer.inW];
+		float *out = &out_[p * layer.outH * layer.outW];
+		for (int ph = 0; ph < layer.outH; ph++)
+		{
+			for (int pw = 0; pw < layer.outW; pw++)
+			{
+				int hstart = ph * layer.stride - layer.pad;
+				int wstart = pw * layer.stride - layer.pad;
+				if (layer.type == LAYER_POOL_MAX)
+				{
+					const int hend = min(hstart + k, layer.inH);
+					const int wend = min(wstart + k, layer.inW);
+					hstart = max(hstart, 0);
+					wstart = max(wstart, 0);
+					float val = -FLT_MAX;
+					for (int y = hstart; y < hend; y++)
+						for (int x = wstart; x < wend; x++)
+							val = max(val, in[y * layer.inW + x]);
+					*out++ = val;
+				}
+				else
+				{
+					// Average includes padding in the divisor
+					// to match Caffe
+					int hend = min(hstart + k, layer.inH + layer.pad);
+					int wend = min(wstart + k, layer.inW + layer.pad);
+					const int poolSize = (hend - hstart) * (wend - wstart);
+					hstart = max(hstart, 0);
+					wstart = max(wstart, 0);
+					hend = min(hend, layer.inH);
+					wend = min(wend, layer.inW);
+					float val = 0;
+					for (int y = hstart; y < hend; y++)
+						for (int x = wstart; x < wend; x++)
+							val += in[y * layer.inW + x];
+					*out++ = val / poolSize;
+				}
+			}
+		}
+	}
+}
+
+// Gather each image's inputs into a column, then do
+// weights (numOutput x inputs) times inputs (inputs x batch)
+void CPUNet::innerProduct(const Layer &layer, size_t batchSize)
+{
+	const size_t inPlane = layer.inH * layer.inW;
+	const size_t rows = layer.inC * inPlane;
+	scratch_.resize(rows * batchSize);
+	for (int c = 0; c < layer.inC; c++)
+		for (size_t i = 0; i < inPlane; i++)
+			for (size_t b = 0; b < batchSize; b++)
+				scratch_[(c * inPlane + i) * batchSize + b] = in_[(c * batchSize + b) * inPlane + i];
+
+	out_.resize(layer.numOutput * batchSize);
+	ConstMatrixMap weights(&layer.weights[0], layer.numOutput, rows);
+	ConstMatrixMap inputs(&scratch_[0], rows, batchSize);
+	MatrixMap out(&out_[0], layer.numOutput, batchSize);
+	out.noalias() = weights * inputs;
+	out.colwise() += Eigen::Map<const Eigen::VectorXf>(&layer.bias[0], layer.numOutput);
+}
+
+void CPUNet::relu(const Layer &layer, size_t batchSize)
+{
+	const size_t count = (size_t)layer.inC * batchSize * layer.inH * layer.inW;
+	const float slope = layer.negativeSlope;
+	float *data = &in_[0];
+	for (size_t i = 0; i < count; i++)
+		data[i] = max(data[i], 0.f) + slope * min(data[i], 0.f);
+}
+
+// Softmax across channels, separately for each
+// pixel of each image
+void CPUNet::softmax(const Layer &layer, size_t batchSize)
+{
+	const size_t plane = layer.inH * layer.inW;
+	const size_t channelStride = batchSize * plane;
+	float *data = &in_[0];
+	for (size_t i = 0; i < channelStride; i++)
+	{
+		float maxVal = -FLT_MAX;
+		for (int c = 0; c < layer.inC; c++)
+			maxVal = max(maxVal, data[c * channelStride + i]);
+		float sum = 0;
+		for (int c = 0; c < layer.inC; c++)
+		{
+			float &val = data[c * channelStride + i];
+			val = exp(val - maxVal);
+			sum += val;
+		}
+		for (int c = 0; c < layer.inC; c++)
+			data[c * channelStride + i] /= sum;
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Small, self-contained CPU inference engine for the nets used
+// by the detector.  Reads the same deploy.prototxt and .caffemodel
+// files Caffe does but doesn't need Caffe (or protobuf, or glog,
+// or CUDA) to run them.  It only knows the handful of layer types
+// our d12/d24/c12/c24 nets use :
+//
+//   Convolution, Pooling (MAX / AVE), InnerProduct,
+//   ReLU, Dropout (a no-op at test time), Softmax
+//
+// Loading a net with anything else fails with an error.
+//
+// Convolutions are done im2col style, turning each one into a single
+// matrix multiply for the whole batch.  Those and the fully
+// connected layers go through Eigen's SIMD matrix multiply.
+//
+// Internally blobs are stored channel-major across the batch -
+// channel, image, row, col - rather than Caffe's image-major order.
+// That way a convolution of an entire batch is one multiply whose
+// output is already in the right layout for the next layer.
+class CPUNet
+{
+	public:
+		CPUNet(void);
+
+		// Load net structure from a deploy.prototxt and the matching
+		// trained weights.  Returns false and prints an error if
+		// anything goes wrong.
+		bool load(const std::string &modelFile, const std::string &trainedFile);
+
+		// Input image size and channel count
+		int inputChannels(void) const;
+		int inputHeight(void) const;
+		int inputWidth(void) const;
+
+		// Number of values output per image
+		int outputSize(void) const;
+
+		// Run a batch of images through the net.  input holds batchSize
+		// images, each stored Caffe-style as channel planes of
+		// inputHeight x inputWidth floats.  output gets outputSize()
+		// values per image, one image after another.
+		void forward(const float *input, size_t batchSize, std::vector<float> &output);
+
+	private:
+		enum LayerType
+		{
+			LAYER_CONVOLUTION,
+			LAYER_POOL_MAX,
+			LAYER_POOL_AVE,
+			LAYER_INNER_PRODUCT,
+			LAYER_RELU,
+			LAYER_SOFTMAX
+		};
+
+		struct Layer
+		{
+			LayerType          type;
+			std::string        name;
+			int                numOutput;
+			int                kernelSize;
+			int                stride;
+			int                pad;
+			float              negativeSlope; // for ReLU
+			std::vector<float> weights;
+			std::vector<float> bias;
+			// Shape of the input and output blobs for one image
+			int inC, inH, inW;
+			int outC, outH, outW;
+		};
+
+		void convolution(const Layer &layer, size_t batchSize);
+		void pool(const Layer &layer, size_t batchSize);
+		void innerProduct(const Layer &layer, size_t batchSize);
+		void relu(const Layer &layer, size_t batchSize);
+		void softmax(const Layer &layer, size_t batchSize);
+
+		std::vector<Layer> layers_;
+		int inputC_;
+		int inputH_;
+		int inputW_;
+
+		// Ping-pong buffers for layer inputs and outputs plus
+		// scratch space for im2col. Kept around between calls
+		// so they're only allocated once
+		std::vector<float> in_;
+		std::vector<float> out_;
+		std::vector<float> scratch_;
+};
@@ -0,0 +1,102 @@
+// Check that the CPUNet engine gives the same answers as
+// Caffe.  Runs a batch of random images through both a
+// CaffeClassifier and a CPUClassifier for each net and
+// compares the outputs for every label.
+// Usage : cpunet_check [net base dir ...]
+// defaults to checking d12 d24 c12 c24 in the current dir
+#include <cmath>
+#include <iostream>
+#include <map>
+
+#include "CaffeClassifier.hpp"
+#include "CPUClassifier.hpp"
+#include "classifierio.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Max allowed difference between Caffe and CPUNet outputs
+const float tolerance = 1e-4;
+const size_t batchSize = 64;
+
+static float checkNet(const string &baseDir)
+{
+	ClassifierIO clio(baseDir, -1, -1);
+	vector<string> files = clio.getClassifierFiles();
+	if (files.size() != 4)
+	{
+		cerr << "Could not find net files in " << baseDir << endl;
+		return -1;
+	}
+
+	CaffeClassifier<Mat> caffe(files[0], files[1], files[2], files[3], batchSize);
+	CPUClassifier<Mat>   cpu(files[0], files[1], files[2], files[3], batchSize);
+	if (!caffe.initialized() || !cpu.initialized())
+	{
+		cerr << "Could not load " << baseDir << endl;
+		return -1;
+	}
+
+	// Random color images of the right size
+	RNG rng(12345);
+	vector<Mat> imgs;
+	for (size_t i = 0; i < batchSize; i++)
+	{
+		Mat img(caffe.getInputGeometry(), CV_32FC3);
+		rng.fill(img, RNG::UNIFORM, 0, 255);
+		imgs.push_back(img);
+	}
+
+	// Ask for every label so all of the outputs
+	// get compared, not just the top few
+	const size_t numClasses = 1000;
+	vector<vector<Prediction>> caffeP = caffe.ClassifyBatch(imgs, numClasses);
+	vector<vector<Prediction>> cpuP   = cpu.ClassifyBatch(imgs, numClasses);
+	if (caffeP.size() != cpuP.size())
+	{
+		cerr << baseDir << " : result count mismatch" << endl;
+		return -1;
+	}
+
+	// Results are sorted by confidence so tiny differences
+	// can reorder them. Compare by label instead
+	float maxDiff = 0;
+	for (size_t i = 0; i < caffeP.size(); i++)
+	{
+		map<string, float> cpuValues;
+		for (auto it = cpuP[i].cbegin(); it != cpuP[i].cend(); ++it)
+			cpuValues[it->first] = it->second;
+		if (cpuValues.size() != caffeP[i].size())
+		{
+			cerr << baseDir << " : label count mismatch" << endl;
+			return -1;
+		}
+		for (auto it = caffeP[i].cbegin(); it != caffeP[i].cend(); ++it)
+			maxDiff = max(maxDiff, fabs(it->second - cpuValues[it->first]));
+	}
+	return maxDiff;
+}
+
+int main(int argc, char **argv)
+{
+	vector<string> dirs;
+	for (int i = 1; i < argc; i++)
+		dirs.push_back(argv[i]);
+	if (dirs.empty())
+	{
+		dirs.push_back("d12");
+		dirs.push_back("d24");
+		dirs.push_back("c12");
+		dirs.push_back("c24");
+	}
+
+	bool passed = true;
+	for (auto it = dirs.cbegin(); it != dirs.cend(); ++it)
+	{
+		const float maxDiff = checkNet(*it);
+		const bool ok = (maxDiff >= 0) && (maxDiff <= tolerance);
+		cout << *it << " : max difference " << maxDiff << (ok ? " OK" : " FAILED") << endl;
+		passed &= ok;
+	}
+	return passed ? 0 : 1;
+}
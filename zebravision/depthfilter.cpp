@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <cmath>
+#include "depthfilter.hpp"
+
+using namespace std;
+using namespace cv;
+
+DepthRangeFilter::DepthRangeFilter(void) :
+	stride_(0)
+{
+}
+
+void DepthRangeFilter::build(const Mat &depth, const float depthMin, const float depthMax)
+{
+	stride_ = depth.cols + 1;
+	sum_.resize((depth.rows + 1) * stride_);
+
+	// Top row is all zeros - nothing above it
+	fill(sum_.begin(), sum_.begin() + stride_, 0);
+	for (int r = 0; r < depth.rows; r++)
+	{
+		const float *p    = depth.ptr<float>(r);
+		const int   *prev = &sum_[r * stride_];
+		int         *curr = &sum_[(r + 1) * stride_];
+
+		// Running count of passing pixels in this
+		// row plus the count from the row above
+		int rowSum = 0;
+		curr[0] = 0;
+		for (int c = 0; c < depth.cols; c++)
+		{
+			// Be conservative here - count pixels with
+			// no depth info as in range
+			const float d = p[c];
+			rowSum += std::isnan(d) || (d <= 0.0) || ((d < depthMax) && (d > depthMin));
+			curr[c + 1] = prev[c + 1] + rowSum;
+		}
+	}
+}
+
+bool DepthRangeFilter::anyInRange(const Rect &rect) const
+{
+	const int *top    = &sum_[rect.y * stride_];
+	const int *bottom = &sum_[(rect.y + rect.height) * stride_];
+	const int  x2     = rect.x + rect.width;
+	return (bottom[x2] - bottom[rect.x] - top[x2] + top[rect.x]) > 0;
+}
@@ -0,0 +1,39 @@
+// Quick test of whether any pixel in a window of a depth
+// map is at a plausible depth.
+//
+// build() marks each pixel as passing if its depth is
+// unknown (NaN or <= 0) or strictly between depthMin and
+// depthMax, then builds an integral image (summed area
+// table) of those marks. After that, checking any rect
+// is 4 lookups no matter how big the rect is, rather
+// than a scan of every pixel in it.
+//
+// Note that a min/max of each window isn't enough here -
+// a window with depths both below and above the range
+// would pass a min/max test without any pixel actually
+// being in range. Counting passing pixels gives exactly
+// the same answer as checking each pixel.
+#pragma once
+
+#include <vector>
+#include "opencv2_3_shim.hpp"
+
+class DepthRangeFilter
+{
+	public:
+		DepthRangeFilter(void);
+
+		// depth is a CV_32FC1 depth map
+		void build(const cv::Mat &depth, const float depthMin, const float depthMax);
+
+		// True if any pixel in rect passed the test in build().
+		// rect must be inside the depth map
+		bool anyInRange(const cv::Rect &rect) const;
+
+	private:
+		// (rows + 1) x (cols + 1) counts, stored row-major.
+		// sum_[r * stride_ + c] is the number of passing
+		// pixels above and to the left of (r, c)
+		std::vector<int> sum_;
+		int              stride_;
+};
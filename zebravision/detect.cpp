@@ -1,12 +1,15 @@
+#include <cstdlib>
 #include <iostream>
 #include <sys/time.h>
 #include "opencv2_3_shim.hpp"
 
 #include "scalefactor.hpp"
 #include "fast_nms.hpp"
+#include "depthfilter.hpp"
 #include "detect.hpp"
 #ifndef USE_GIE
 #include "CaffeClassifier.hpp"
+#include "CPUClassifier.hpp"
 #endif
 #include "GIEClassifier.hpp"
 #include "Utilities.hpp"
@@ -49,6 +52,10 @@ void NNDetect<MatT, ClassifierT>::detectMultiscale(const Mat&            inputIm
 												   vector<Rect>&         rectsOut,
 												   vector<Rect>&         uncalibRectsOut)
 {
+    // Everything allocated from the arena during the previous
+    // frame is gone by now.  Start this frame with a clean slate
+    arena_.reset();
+
     // Size of the first level classifier. Others are an integer multiple
     // of this initial size (2x and maybe 4x if we need it)
     int wsize = d12_.getInputGeometry().width;
@@ -57,9 +64,10 @@ void NNDetect<MatT, ClassifierT>::detectMultiscale(const Mat&            inputIm
 	// different object sizes, pass in several different resizings
 	// of the input image.  These vectors hold those resized images
 	// plus the scale factor to return objects detected in them
-	// to the correct size on the original input image
-    vector<pair<MatT, double> > scaledImages12;
-    vector<pair<MatT, double> > scaledImages24;
+	// to the correct size on the original input image. They're
+	// members so the image buffers are reused from frame to frame
+    vector<pair<MatT, double> > &scaledImages12 = scaledImages12_;
+    vector<pair<MatT, double> > &scaledImages24 = scaledImages24_;
     // Maybe later ? vector<pair<MatT, double> > scaledImages48;
 
     // list of windows to work with.
@@ -67,24 +75,24 @@ void NNDetect<MatT, ClassifierT>::detectMultiscale(const Mat&            inputIm
     // with the index of the scaled image it corresponds with.
 	// Keeping both allows the code to resize the window to 
 	// the correct size and location on the original input image
-    vector<Window> windowsIn;
-    vector<Window> windowsMid;
-    vector<Window> windowsOut;
-    vector<Window> uncalibWindowsOut;
+    // These all live in the per-frame arena
+    WindowList windowsIn(arena_);
+    WindowList windowsMid(arena_);
+    WindowList windowsOut(arena_);
+    WindowList uncalibWindowsOut(arena_);
 
     // Confidence scores (0.0 - 1.0) for each detected rectangle
 	// Higher confidence means more likely to be what the net is 
 	// looking for
-    vector<float> scores;
+    ArenaVector<float> scores(arena_);
 
     // Generate a list of initial windows to search. Each window will be a 12x12 image from 
 	// a scaled copy of the full input image. These scaled images let us search for 
 	// variable sized objects using a fixed-width detector
-    MatT f32Img;
-
 	// classifier runs on float pixel data. Convert it once here
 	// rather than every time we pass a sub-window into the detection
 	// code to save some time
+    MatT &f32Img = f32Img_;
     MatT(inputImg).convertTo(f32Img, CV_32FC3);
 
 	// For GPU Mat, upload input CPU depth mat to GPU mat
@@ -108,7 +116,7 @@ void NNDetect<MatT, ClassifierT>::detectMultiscale(const Mat&            inputIm
 	{
 		runLocalNMS(windowsMid, scores, nmsThreshold[0], uncalibWindowsOut);
 	}
-    runCalibration(windowsMid, scaledImages12, c12_, calibrationThreshold[0], windowsOut);
+    runCalibration(windowsMid, scaledImages12, c12_, c12Shifts_, calibrationThreshold[0], windowsOut);
 	// If not running d24/c24, use the d12 output as the
 	// uncalibrated results
     runLocalNMS(windowsOut, scores, nmsThreshold[0], windowsIn);
@@ -132,7 +140,7 @@ void NNDetect<MatT, ClassifierT>::detectMultiscale(const Mat&            inputIm
 		runGlobalNMS(windowsMid, scores, scaledImages24, nmsThreshold[1], uncalibWindowsOut);
 		// Use calibration nets to try and better align the 
 		// detection rectangle
-        runCalibration(windowsMid, scaledImages24, c24_, calibrationThreshold[1], windowsOut);
+        runCalibration(windowsMid, scaledImages24, c24_, c24Shifts_, calibrationThreshold[1], windowsOut);
         runGlobalNMS(windowsOut, scores, scaledImages24, nmsThreshold[1], windowsIn);
         cout << "d24 nms windows out = " << windowsIn.size() << endl;
     }
@@ -161,6 +169,11 @@ void NNDetect<MatT, ClassifierT>::detectMultiscale(const Mat&            inputIm
         const Rect scaledRect(Rect(rect.x / scale, rect.y / scale, rect.width / scale, rect.height / scale));
         uncalibRectsOut.push_back(scaledRect);
     }
+#ifdef VERBOSE
+    cout << "detect arena " << arena_.bytesUsed() << " bytes in " << arena_.allocations()
+         << " allocations, peak " << arena_.peakBytes() << " bytes, "
+         << arena_.heapAllocations() << " heap allocations total" << endl;
+#endif
 }
 
 
@@ -174,34 +187,33 @@ void NNDetect<MatT, ClassifierT>::detectMultiscale(const Mat&            inputIm
 // a window at a different scale. Use this for the last
 // level of detection only
 template<class MatT, class ClassifierT>
-void NNDetect<MatT, ClassifierT>::runGlobalNMS(const vector<Window>& windows,
-                                  const vector<float>& scores,
+void NNDetect<MatT, ClassifierT>::runGlobalNMS(const WindowList& windows,
+                                  const ArenaVector<float>& scores,
                                   const vector<pair<MatT, double> >& scaledImages,
                                   const double nmsThreshold,
-                                  vector<Window>& windowsOut)
+                                  WindowList& windowsOut)
 {
     if ((nmsThreshold > 0.0) && (nmsThreshold <= 1.0))
     {
-        // Detected is a rect, score pair.
-        vector<Detected> detected;
-
         // Need to scale each rect to the correct mapping to the
         // original image, since rectangles from multiple different
         // scales might overlap
+        nms_.clear();
+        nms_.reserve(windows.size());
         for (size_t i = 0; i < windows.size(); i++)
         {
             const double scale = scaledImages[windows[i].second].second;
             const Rect   rect(windows[i].first);
             const Rect   scaledRect(rect.x / scale, rect.y / scale, rect.width / scale, rect.height / scale);
-            detected.push_back(Detected(scaledRect, scores[i]));
+            nms_.push_back(scaledRect, scores[i]);
         }
 
-        vector<size_t> nmsOut;
-        fastNMS(detected, nmsThreshold, nmsOut);
-        // Each entry of nmsOut is the index of a saved rect/scales
+        nms_.run(nmsThreshold, nmsOut_);
+        // Each entry of nmsOut_ is the index of a saved rect/scales
         // pair.  Save the entries from those indexes as the output
         windowsOut.clear();
-        for (auto it = nmsOut.cbegin(); it != nmsOut.cend(); ++it)
+        windowsOut.reserve(nmsOut_.size());
+        for (auto it = nmsOut_.cbegin(); it != nmsOut_.cend(); ++it)
         {
             windowsOut.push_back(windows[*it]);
         }
@@ -217,10 +229,10 @@ void NNDetect<MatT, ClassifierT>::runGlobalNMS(const vector<Window>& windows,
 // windows of the same scale. Leave potential overlaps
 // from different scales alone
 template<class MatT, class ClassifierT>
-void NNDetect<MatT, ClassifierT>::runLocalNMS(const vector<Window>& windows,
-                                 const vector<float>& scores,
+void NNDetect<MatT, ClassifierT>::runLocalNMS(const WindowList& windows,
+                                 const ArenaVector<float>& scores,
                                  const double nmsThreshold,
-                                 vector<Window>& windowsOut)
+                                 WindowList& windowsOut)
 {
     if ((nmsThreshold > 0.0) && (nmsThreshold <= 1.0))
     {
@@ -229,39 +241,50 @@ void NNDetect<MatT, ClassifierT>::runLocalNMS(const vector<Window>& windows,
         for (size_t i = 0; i < windows.size(); i++)
 			maxScale = max(maxScale, windows[i].second);
 
-        // Detected is a rect, score pair.
-		// Create a separate array for each scale 
-		// so they can be processed individually.
-		// detected[x] is the list of detections
-		// for scale x
-        vector<vector<Detected> > detected(maxScale + 1);
-		
+		// Group window indexes by scale so each scale
+		// can be processed individually. This is a counting
+		// sort - scaleStart[x] .. scaleStart[x+1] is the range
+		// of byScale holding indexes of windows for scale x,
+		// in the same order they appear in windows
+		ArenaVector<size_t> scaleStart(maxScale + 2, 0, arena_);
+		for (size_t i = 0; i < windows.size(); i++)
+			scaleStart[windows[i].second + 1] += 1;
+		for (size_t i = 1; i < scaleStart.size(); i++)
+			scaleStart[i] += scaleStart[i - 1];
+
+		ArenaVector<size_t> byScale(windows.size(), 0, arena_);
+		ArenaVector<size_t> fill(scaleStart.begin(), scaleStart.end() - 1, arena_);
+		for (size_t i = 0; i < windows.size(); i++)
+			byScale[fill[windows[i].second]++] = i;
+
+		// Run NMS separately for each scale. Accumulate
+		// results from all of the passing windows into 
+		// windowsOut.
 		// Don't rescale windows since we're only comparing
 		// against other windows from the same scale
 		// Scaling them each by the same amount won't make
 		// any difference and just wastes time
-        for (size_t i = 0; i < windows.size(); i++)
-		{
-			size_t scaleIdx = windows[i].second;
-            detected[scaleIdx].push_back(Detected(windows[i].first, scores[i]));
-        }
-
-		// Run NMS separately for each scale. Accumulate
-		// results from all of the passing windows into 
-		// windowsOut
         windowsOut.clear();
-		for (size_t i = 0; i < detected.size(); i++)
+		for (size_t i = 0; i <= maxScale; i++)
 		{
-			vector<size_t> nmsOut;
-			fastNMS(detected[i], nmsThreshold, nmsOut);
-			// Each entry of nmsOut is the index of a saved rect/scales
-			// pair.  Save the entries from those indexes as the output
-			for (auto it = nmsOut.cbegin(); it != nmsOut.cend(); ++it)
+			const size_t start = scaleStart[i];
+			const size_t end   = scaleStart[i + 1];
+			if (start == end)
+				continue;
+
+			nms_.clear();
+			for (size_t j = start; j < end; j++)
+				nms_.push_back(windows[byScale[j]].first, scores[byScale[j]]);
+
+			nms_.run(nmsThreshold, nmsOut_);
+			// Each entry of nmsOut_ is the index of a saved rect
+			// within this scale's list.  Save the entries from
+			// those indexes as the output
+			for (auto it = nmsOut_.cbegin(); it != nmsOut_.cend(); ++it)
 			{
-				// Window is a <rect, scale index> pair. The rect
-				// is the first entry in the detected list, the
-				// scale index is i.
-				windowsOut.push_back(make_pair(detected[i][*it].first, i));
+				// Window is a <rect, scale index> pair. The scale
+				// index is i.
+				windowsOut.push_back(make_pair(windows[byScale[start + *it]].first, i));
 			}
 		}
     }
@@ -301,10 +324,74 @@ void NNDetect<MatT, ClassifierT>::generateInitialWindows(
     const int wsize,
     const double scaleFactor,
     vector<pair<MatT, double> >& scaledImages,
+    WindowList& windows)
+{
+    windows.clear();
+
+    // Figure out the list of scales up front. After that
+    // each scaled image and its list of windows only depends
+    // on the input image so every level can be built at the
+    // same time.
+    vector<double> &scales = scales_;
+    scaleList(Size(wsize, wsize), minSize, maxSize, scaleFactor, scales);
+    scaledImages.resize(scales.size());
+    scaledDepths_.resize(scales.size());
+    unfilteredWindows_.resize(scales.size());
+    depthFilters_.resize(scales.size());
+
+    // Per-level lists of windows, merged once all the
+    // levels are done. Merging in level order gives the same
+    // window order as handling one level at a time
+    vector<vector<Window> > &levelWindows = levelWindows_;
+    levelWindows.resize(scales.size());
+    auto generateLevel = [&](size_t scale)
+    {
+        generateLevelWindows(input, depthIn, wsize, scale, scales[scale],
+                             scaledImages[scale], scaledDepths_[scale],
+                             unfilteredWindows_[scale], depthFilters_[scale],
+                             levelWindows[scale]);
+    };
+
+    // Only spread the work out for CPU Mats. GPU
+    // resizes are already fast and sharing the device
+    // between threads doesn't buy anything
+    if (std::is_same<MatT, Mat>::value)
+        threadPool_.parallelFor(scales.size(), generateLevel);
+    else
+        for (size_t scale = 0; scale < scales.size(); ++scale)
+            generateLevel(scale);
+
+    size_t windowCount = 0;
+    for (auto it = levelWindows.cbegin(); it != levelWindows.cend(); ++it)
+        windowCount += it->size();
+    windows.reserve(windowCount);
+    for (auto it = levelWindows.cbegin(); it != levelWindows.cend(); ++it)
+        windows.insert(windows.end(), it->begin(), it->end());
+    //cout << "generateInitialWindows passed " << windows.size() << " windows" << endl;
+}
+
+// Build a single level of the image pyramid for
+// generateInitialWindows and fill in windows with
+// every position in that level which passes the
+// depth check. scaledDepth, unfilteredWindows and
+// depthFilter are scratch space for this level.
+// Touches nothing shared with other levels so it is
+// safe to run in parallel with calls for the other
+// levels
+template<class MatT, class ClassifierT>
+void NNDetect<MatT, ClassifierT>::generateLevelWindows(
+    const MatT& input,
+    const MatT& depthIn,
+    const int wsize,
+    const size_t scale,
+    const double scaleValue,
+    pair<MatT, double>& scaledImage,
+    pair<MatT, double>& scaledDepth,
+    vector<Window>& unfilteredWindows,
+    DepthRangeFilter& depthFilter,
     vector<Window>& windows)
 {
     windows.clear();
-    size_t windowsChecked = 0;
 
     // How many pixels to move the window for each step
     // We use 4 - the calibration step can adjust +/- 2 pixels
@@ -313,80 +400,55 @@ void NNDetect<MatT, ClassifierT>::generateInitialWindows(
     // pixels we step over.
     const int step = 4;
 
-    // Create array of scaled images for RGB 
+    // Create scaled images for RGB 
 	// and depth data
-    scalefactor(input, Size(wsize, wsize), minSize, maxSize, scaleFactor, scaledImages);
-    vector<pair<MatT, double> > scaledDepth;
+    scaleImage(input, scaleValue, scaledImage);
     if (!depthIn.empty())
-    {
-        scalefactor(depthIn, Size(wsize, wsize), minSize, maxSize, scaleFactor, scaledDepth);
-    }
+        scaleImage(depthIn, scaleValue, scaledDepth);
 
-    // Main loop.  Look at each scaled image in turn
-    for (size_t scale = 0; scale < scaledImages.size(); ++scale)
-    {
-        float depth_multiplier = 0.2;
-        float ball_real_size   = 247.6;                 // ball is 9.75in diameter = 247.6 mm
-        float percent_image    = (float)wsize / scaledImages[scale].first.cols;
-        float size_fov         = percent_image * hfov_; //TODO fov size
-        float depth_avg        = (ball_real_size / (2.0 * tanf(size_fov / 2.0))) - (4.572 * 25.4);
-
-        float depth_min = depth_avg - depth_avg * depth_multiplier;
-        float depth_max = depth_avg + depth_avg * depth_multiplier;
+    float depth_multiplier = 0.2;
+    float ball_real_size   = 247.6;                 // ball is 9.75in diameter = 247.6 mm
+    float percent_image    = (float)wsize / scaledImage.first.cols;
+    float size_fov         = percent_image * hfov_; //TODO fov size
+    float depth_avg        = (ball_real_size / (2.0 * tanf(size_fov / 2.0))) - (4.572 * 25.4);
+
+    float depth_min = depth_avg - depth_avg * depth_multiplier;
+    float depth_max = depth_avg + depth_avg * depth_multiplier;
 #if 0
-        cout << fixed << "Target size:" << wsize / scaledImages[scale].second << " Mat Size :" << scaledImages[scale].first.size() << " Dist:" << depth_avg << " Min/max:" << depth_min << "/" << depth_max;
+    cout << fixed << "Target size:" << wsize / scaledImage.second << " Mat Size :" << scaledImage.first.size() << " Dist:" << depth_avg << " Min/max:" << depth_min << "/" << depth_max;
 #endif
-        size_t thisWindowsChecked = 0;
-        size_t thisWindowsPassed  = 0;
-
-		vector<Window> unfilteredWindows;
-        // Start at the upper left corner.  Loop through the rows and cols adding
-		// each position to the list to check until the detection window falls off 
-		// the edges of the scaled image
-        for (int r = 0; (r + wsize) <= scaledImages[scale].first.rows; r += step)
+
+    unfilteredWindows.clear();
+    if ((scaledImage.first.rows >= wsize) && (scaledImage.first.cols >= wsize))
+        unfilteredWindows.reserve(((scaledImage.first.rows - wsize) / step + 1) *
+                                  ((scaledImage.first.cols - wsize) / step + 1));
+    // Start at the upper left corner.  Loop through the rows and cols adding
+    // each position to the list to check until the detection window falls off 
+    // the edges of the scaled image
+    for (int r = 0; (r + wsize) <= scaledImage.first.rows; r += step)
+    {
+        for (int c = 0; (c + wsize) <= scaledImage.first.cols; c += step)
         {
-            for (int c = 0; (c + wsize) <= scaledImages[scale].first.cols; c += step)
-            {
-                thisWindowsChecked += 1;
-				const Rect rect(c, r, wsize, wsize);
-				unfilteredWindows.push_back(Window(rect, scale));
-            }
+            const Rect rect(c, r, wsize, wsize);
+            unfilteredWindows.push_back(Window(rect, scale));
         }
-        windowsChecked += thisWindowsChecked;
-		vector<bool> validList;
+    }
 
-		// If there is depth data, filter using it :
-		// Throw out rects which would indicate an object that is at the
-		// wrong depth given the size of the window being searched
-		if (!depthIn.empty())
-		{
-			vector<MatT> depthList;
+    // If there is depth data, filter using it :
+    // Throw out rects which would indicate an object that is at the
+    // wrong depth given the size of the window being searched
+    // Both lists are kept from frame to frame, so swapping
+    // just trades buffers between them
+    if (depthIn.empty())
+    {
+        windows.swap(unfilteredWindows);
+        return;
+    }
 
-			for (size_t i = 0; i < unfilteredWindows.size(); i++)
-			{
-				const Rect r(unfilteredWindows[i].first);
-				size_t scale = unfilteredWindows[i].second;
-				depthList.push_back(scaledDepth[scale].first(r));
-			}
-			checkDepthList(depth_min, depth_max, depthList, validList);
-		}
-		else
-		{
-			validList = vector<bool>(unfilteredWindows.size(), true);
-		}
-		for (size_t i = 0; i < unfilteredWindows.size(); i++)
-		{
-			if (validList[i])
-			{
-				windows.push_back(unfilteredWindows[i]);
-				thisWindowsPassed += 1;
-			}
-		}
+    filterDepthWindows(depth_min, depth_max, scaledDepth.first, depthFilter, unfilteredWindows, windows);
 #if 0
-        cout << " Windows Passed:" << thisWindowsPassed << "/" << thisWindowsChecked << endl;
+    cout << " Windows Passed:" << windows.size() << "/" << unfilteredWindows.size() << endl;
 #endif
-    }
-    //cout << "generateInitialWindows checked " << windowsChecked << " windows and passed " << windows.size() << endl;
 }
 
 
@@ -400,23 +462,40 @@ void NNDetect<MatT, ClassifierT>::generateInitialWindows(
 template<class MatT, class ClassifierT>
 void NNDetect<MatT, ClassifierT>::runDetection(ClassifierT &classifier,
                                   const vector<pair<MatT, double> >& scaledImages,
-                                  const vector<Window>& windows,
+                                  const WindowList& windows,
                                   const float threshold,
                                   const string &label,
-                                  vector<Window>& windowsOut,
-                                  vector<float>& scores)
+                                  WindowList& windowsOut,
+                                  ArenaVector<float>& scores)
 {
+    size_t batchSize = classifier.batchSize(); // defined when classifer is constructed
+
+    // Worst case every window is detected. Reserving
+    // that up front means the outputs never have to grow
     windowsOut.clear();
     scores.clear();
+
+    // Look up the net output index for label once
+    // rather than comparing strings for every window
+    const int labelIndex = classifier.labelIndex(label);
+    if (labelIndex < 0)
+    {
+        cerr << "runDetection() : label " << label << " not found in net labels" << endl;
+        return;
+    }
+    windowsOut.reserve(windows.size());
+    scores.reserve(windows.size());
+
     // Accumulate a number of images to test and pass them in to
     // the NN prediction as a batch
-    vector<MatT> images;
+    vector<MatT> &images = batch_;
+    images.clear();
+    images.reserve(batchSize);
 
     // Return value from detection. This is a list of indexes from
     // the input array above which have a high enough confidence score
-    vector<size_t> detected;
-
-    size_t batchSize = classifier.batchSize(); // defined when classifer is constructed
+    ArenaVector<size_t> detected(arena_);
+    detected.reserve(batchSize);
     int    counter   = 0;
     //double start     = gtod_wrapper(); // grab start time
 
@@ -436,7 +515,7 @@ void NNDetect<MatT, ClassifierT>::runDetection(ClassifierT &classifier,
         images.push_back(scaledImages[it->second].first(it->first));
         if ((images.size() == batchSize) || ((it + 1) == windows.cend()))
         {
-            doBatchPrediction(classifier, images, threshold, label, detected, scores);
+            doBatchPrediction(classifier, images, threshold, labelIndex, detected, scores);
 
             // Clear out images array to start the next batch
             // of processing fresh
@@ -462,60 +541,42 @@ void NNDetect<MatT, ClassifierT>::runDetection(ClassifierT &classifier,
 
 
 // do 1 run of the classifier. This takes up batch_size predictions
-// and adds the index of anything found to the detected list
+// and adds the index of anything found to the detected list.
+// labelIndex is the net output for the object we're looking for
 template<class MatT, class ClassifierT>
 void NNDetect<MatT, ClassifierT>::doBatchPrediction(ClassifierT &classifier,
 												    const vector<MatT> &imgs,
 												    const float         threshold,
-												    const string&       label,
-												    vector<size_t>&     detected,
-												    vector<float>&      scores)
+												    const int           labelIndex,
+												    ArenaVector<size_t>& detected,
+												    ArenaVector<float>&  scores)
 {
     detected.clear();
-    // Grab the top 2 detected classes.  Since we're doing an object /
-    // not object split, that will get the scores for both categories
-    vector<vector<Prediction> > predictions = classifier.ClassifyBatch(imgs, 2);
+    // Grab the score for the label we're looking for from
+    // each image in the batch.  Higher confidences from the
+    // prediction mean that the net thinks it is more likely
+    // that the label correctly identifies the image passed in
+    classifier.ClassifyBatchScore(imgs, labelIndex, batchScores_);
 
-    // Each outer loop is the predictions for one input image
+    // Look for object with label <labelIndex>, >= <threshold> confidence
     for (size_t i = 0; i < imgs.size(); ++i)
     {
-        // Each inner loop is the prediction for a particular label
-        // for the given image, sorted by score.
-        //
-        // Look for object with label <label>, >= <threshold> confidence
-		// Higher confidences from the prediction mean that the net
-		// thinks it is more likely that the label correctly
-		// identifies the image passed in
-        for (auto it = predictions[i].cbegin(); it != predictions[i].cend(); ++it)
-        {
-
-#if 0
-			if (imgs[i].rows > 12)
-			{
-				cout << it->first << " " << it->second << " ";
-				Mat img = imgs[i].clone();
-				Mat wr;
-				img.convertTo(wr, CV_8UC3, 255);
-				stringstream s;
-				s << "debug_" << i << ".png";
-				imwrite(s.str(), wr);
-			}
-#endif
-
-
-            if (it->first == label)
-            {
-                if (it->second >= threshold)
-                {
-                    detected.push_back(i);
-                    scores.push_back(it->second);
-                }
 #if 0
-				if (imgs[0].rows > 12)
-					cout << endl;
+		if (imgs[i].rows > 12)
+		{
+			cout << classifier.labelName(labelIndex) << " " << batchScores_[i] << endl;
+			Mat img = imgs[i].clone();
+			Mat wr;
+			img.convertTo(wr, CV_8UC3, 255);
+			stringstream s;
+			s << "debug_" << i << ".png";
+			imwrite(s.str(), wr);
+		}
 #endif
-                break;
-            }
+        if (batchScores_[i] >= threshold)
+        {
+            detected.push_back(i);
+            scores.push_back(batchScores_[i]);
         }
     }
 }
@@ -531,16 +592,20 @@ void NNDetect<MatT, ClassifierT>::doBatchPrediction(ClassifierT &classifier,
 // The actual shift/resize to apply is the average of all of them
 // with a high enough confidence
 template<class MatT, class ClassifierT>
-void NNDetect<MatT, ClassifierT>::runCalibration(const vector<Window>& windowsIn,
+void NNDetect<MatT, ClassifierT>::runCalibration(const WindowList& windowsIn,
                                     const vector<pair<MatT, double> >& scaledImages,
                                     ClassifierT &classifier,
+                                    const vector<CalibrationShift> &shiftTable,
                                     const float threshold,
-                                    vector<Window>& windowsOut)
+                                    WindowList& windowsOut)
 {
 	windowsOut.clear();
-	vector<MatT>           images; // input images
-	vector<vector<float> > shift;  // shift list for this batch
-	vector<vector<float> > shifts; // complete list of all shifts
+	windowsOut.reserve(windowsIn.size());
+	vector<MatT> &images = batch_;          // input images
+	images.clear();
+	images.reserve(classifier.batchSize());
+	ArenaVector<Vec3f> shifts(arena_);      // ds, dx, dy for each window
+	shifts.reserve(windowsIn.size());
 	for (auto it = windowsIn.cbegin(); it != windowsIn.cend(); ++it)
 	{
 		// Grab the rect from the scaled image represented
@@ -548,8 +613,7 @@ void NNDetect<MatT, ClassifierT>::runCalibration(const vector<Window>& windowsIn
 		images.push_back(scaledImages[it->second].first(it->first));
 		if ((images.size() == classifier.batchSize()) || ((it + 1) == windowsIn.cend()))
 		{
-			doBatchCalibration(classifier, images, threshold, shift);
-			shifts.insert(shifts.end(), shift.begin(), shift.end());
+			doBatchCalibration(classifier, shiftTable, images, threshold, shifts);
 			images.clear();
 		}
 	}
@@ -635,48 +699,82 @@ void NNDetect<MatT, ClassifierT>::runCalibration(const vector<Window>& windowsIn
 }
 
 
+// The calibration nets are trained with 45 shifted and resized
+// versions of each image.  Label N corresponds to scale index
+// N / 9, x shift index (N % 9) / 3 and y shift index N % 3.
+// The net outputs are ordered by label string, not label value,
+// so map each output index back to its shift here once
+// rather than parsing label strings for every window
 template<class MatT, class ClassifierT>
-void NNDetect<MatT, ClassifierT>::doBatchCalibration(ClassifierT            &classifier,
-													 const vector<MatT>     &imgs,
-													 const float             threshold,
-													 vector<vector<float> > &shift)
+void NNDetect<MatT, ClassifierT>::buildShiftTable(const ClassifierT &classifier,
+												  vector<CalibrationShift> &shiftTable)
 {
-	shift.clear();
-	vector<vector<Prediction> > predictions = classifier.ClassifyBatch(imgs, 45);
-	float ds[] = { .81, .93, 1, 1.10, 1.21 };
-	float dx   = .17;
-	float dy   = .17;
-	// Each outer loop is the predictions for one input image
+	const float ds[] = { .81, .93, 1, 1.10, 1.21 };
+	const float dx   = .17;
+	const float dy   = .17;
+	const int   maxIndex = sizeof(ds) / sizeof(ds[0]) * 9;
+
+	shiftTable.clear();
+	for (size_t i = 0; i < classifier.labelCount(); i++)
+	{
+		const string &label = classifier.labelName(i);
+		char *end;
+		const long index = strtol(label.c_str(), &end, 10);
+		CalibrationShift shift;
+		shift.valid = (end != label.c_str()) && (*end == '\0') &&
+			          (index >= 0) && (index < maxIndex);
+		if (shift.valid)
+		{
+			shift.ds = ds[index / 9];
+			shift.dx = dx * (((index % 9) / 3) - 1);
+			shift.dy = dy * (index % 3 - 1);
+		}
+		else
+		{
+			cerr << "Calibration label \"" << label << "\" is not a value from 0 to " << maxIndex - 1 << endl;
+			shift.ds = 1;
+			shift.dx = 0;
+			shift.dy = 0;
+		}
+		shiftTable.push_back(shift);
+	}
+}
+
+template<class MatT, class ClassifierT>
+void NNDetect<MatT, ClassifierT>::doBatchCalibration(ClassifierT                    &classifier,
+													 const vector<CalibrationShift> &shiftTable,
+													 const vector<MatT>             &imgs,
+													 const float                     threshold,
+													 ArenaVector<Vec3f>             &shifts)
+{
+	classifier.ClassifyBatchScores(imgs, batchScores_);
+	const size_t labelCount = shiftTable.size();
+	// Each outer loop is the scores for one input image
 	for (size_t i = 0; i < imgs.size(); ++i)
 	{
-		// Each inner loop is the prediction for a particular label
-		// for the given image, sorted by score.
-		//
-		// Look for object with label <label>, >= threshold confidence
+		// Average the shift for every label with
+		// a score >= threshold
+		const float *score = &batchScores_[i * labelCount];
 		float dsc     = 0;
 		float dxc     = 0;
 		float dyc     = 0;
 		int   counter = 0;
-		for (auto it = predictions[i].cbegin(); it != predictions[i].cend(); ++it)
+		for (size_t j = 0; j < labelCount; j++)
 		{
-			if (it->second >= threshold)
+			if ((score[j] >= threshold) && shiftTable[j].valid)
 			{
-				int index = stoi(it->first);
-				dsc += ds[(index - index % 9) / 9]; //probably should just be index/9
-				dxc += dx * (((index % 9) / 3) - 1);
-				dyc += dy * (index % 3 - 1);
+				dsc += shiftTable[j].ds;
+				dxc += shiftTable[j].dx;
+				dyc += shiftTable[j].dy;
 				counter++;
 #ifdef VERBOSE
-				cout << "i=" << i << " Label=" << it->first << " thresh=" << it->second ;
-				cout << " ds idx=" << (index - index % 9) / 9;
-				cout << " dx idx=" << (((index % 9) / 3) - 1);
-				cout << " dy idx=" << (index % 3 - 1);
-				cout << " ds=" << ds[(index-index%9)/9];
-				cout << " dx=" << dx * (((index % 9) / 3) - 1);
-				cout << " dy=" << dy * (index % 3 - 1);
+				cout << "i=" << i << " Label=" << classifier.labelName(j) << " thresh=" << score[j];
+				cout << " ds=" << shiftTable[j].ds;
+				cout << " dx=" << shiftTable[j].dx;
+				cout << " dy=" << shiftTable[j].dy;
 				cout << " dsc=" << dsc;
-				cout << " dx=" << dx;
-				cout << " dy=" << dy;
+				cout << " dxc=" << dxc;
+				cout << " dyc=" << dyc;
 				cout << endl;
 #endif
 			}
@@ -693,47 +791,49 @@ void NNDetect<MatT, ClassifierT>::doBatchCalibration(ClassifierT            &cla
 			dxc /= counter;
 			dyc /= counter;
 		}
-		vector<float> shifts;
-		shifts.push_back(dsc);
-		shifts.push_back(dxc);
-		shifts.push_back(dyc);
-		shift.push_back(shifts);
+		shifts.push_back(Vec3f(dsc, dxc, dyc));
 	}
 }
 
 
-// Check each image in the list to see if any pixels
-// in the window are at the correct depth for the size/scale
-// of that window.  
+// Keep windows where any of the depth values in the window are
+// at the correct depth for the size/scale of that window.
+// Be conservative here - also say that it is in range if any of
+// the depth values are negative or NaN (i.e. no depth info for
+// those pixels).
+// The CPU version builds a summed area table of passing pixels
+// for the whole scaled depth map once, making the check for
+// each window a constant-time lookup
 template<class MatT, class ClassifierT>
-void NNDetect<MatT, ClassifierT>::checkDepthList(const float depth_min, const float depth_max,
-		const vector<Mat> &depthList, vector<bool> &validList)
+void NNDetect<MatT, ClassifierT>::filterDepthWindows(const float depth_min, const float depth_max,
+		const Mat &scaledDepth, DepthRangeFilter &depthFilter,
+		const vector<Window> &windowsIn, vector<Window> &windowsOut)
 {
-	validList.clear();
-	for (auto it = depthList.cbegin(); it != depthList.cend(); ++it)
-		validList.push_back(depthInRange(depth_min, depth_max, *it));
+	depthFilter.build(scaledDepth, depth_min, depth_max);
+	windowsOut.reserve(windowsIn.size());
+	for (auto it = windowsIn.cbegin(); it != windowsIn.cend(); ++it)
+		if (depthFilter.anyInRange(it->first))
+			windowsOut.push_back(*it);
 }
 
-
-// Be conservative here - if any of the depth values in the target rect
-// are in the expected range, consider the rect in range.  Also
-// say that it is in range if any of the depth values are negative (i.e. no
-// depth info for those pixels)
+// GPU version checks windows a batch at a time
+// using a CUDA kernel
 template<class MatT, class ClassifierT>
-bool NNDetect<MatT, ClassifierT>::depthInRange(const float depth_min, const float depth_max, const Mat& detectCheck)
+void NNDetect<MatT, ClassifierT>::filterDepthWindows(const float depth_min, const float depth_max,
+		const GpuMat &scaledDepth, DepthRangeFilter &depthFilter,
+		const vector<Window> &windowsIn, vector<Window> &windowsOut)
 {
-    for (int py = 0; py < detectCheck.rows; py++)
-    {
-        const float *p = detectCheck.ptr<float>(py);
-        for (int px = 0; px < detectCheck.cols; px++)
-        {
-            if (std::isnan(p[px]) || (p[px] <= 0.0) || ((p[px] < depth_max) && (p[px] > depth_min)))
-            {
-                return true;
-            }
-        }
-    }
-    return false;
+	(void)depthFilter;
+	vector<GpuMat> depthList;
+	depthList.reserve(windowsIn.size());
+	for (size_t i = 0; i < windowsIn.size(); i++)
+		depthList.push_back(scaledDepth(windowsIn[i].first));
+
+	vector<bool> validList;
+	checkDepthList(depth_min, depth_max, depthList, validList);
+	for (size_t i = 0; i < windowsIn.size(); i++)
+		if (validList[i])
+			windowsOut.push_back(windowsIn[i]);
 }
 
 // GPU specialization
@@ -775,6 +875,7 @@ bool NNDetect<MatT, ClassifierT>::initialized(void) const
 // Explicitly instatiate classes used elsewhere
 #ifndef USE_GIE
 template class NNDetect<Mat, CaffeClassifier<Mat>>;
+template class NNDetect<Mat, CPUClassifier<Mat>>;
 template class NNDetect<GpuMat, CaffeClassifier<GpuMat>>;
 #else
 template class NNDetect<Mat, GIEClassifier<Mat>>;
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <type_traits>
 #include "opencv2_3_shim.hpp"
+#include "depthfilter.hpp"
+#include "fast_nms.hpp"
+#include "framearena.hpp"
+#include "threadpool.hpp"
 
 // Turn Window from a typedef into a class :
 //   Private members are the rect, index from Window plus maybe a score?
@@ -35,8 +40,13 @@ class NNDetect
 			d24_(d24Files[0], d24Files[1], d24Files[2], d24Files[3], 64),
 			c12_(c12Files[0], c12Files[1], c12Files[2], c12Files[3], 64),
 			c24_(c24Files[0], c24Files[1], c24Files[2], c24Files[3], 64),
-			hfov_(hfov)
+			hfov_(hfov),
+			// GPU version builds levels serially, don't
+			// bother starting up threads for it
+			threadPool_(std::is_same<MatT, cv::Mat>::value ? 0 : 1)
 		{
+			buildShiftTable(c12_, c12Shifts_);
+			buildShiftTable(c24_, c24Shifts_);
 		}
 
 		void detectMultiscale(const cv::Mat &inputImg,
@@ -54,17 +64,69 @@ class NNDetect
 
 	private:
 		typedef std::pair<cv::Rect, size_t> Window;
+		typedef ArenaVector<Window> WindowList;
 		ClassifierT d12_;
 		ClassifierT d24_;
 		ClassifierT c12_;
 		ClassifierT c24_;
 		float hfov_;
+
+		// Used to build pyramid levels in parallel
+		ThreadPool threadPool_;
+
+		// Per-frame storage for window lists, scores and
+		// so on.  Reset at the start of each detectMultiscale
+		// call. batch_ holds the views into the scaled images
+		// for each classifier batch - it's a plain vector
+		// since that's what the Classifier calls take, but is
+		// kept around so it doesn't get reallocated every batch
+		FrameArena        arena_;
+		std::vector<MatT> batch_;
+
+		// Image pyramids and per-level window lists. Levels
+		// are built in parallel so these can't come from
+		// arena_, which is single threaded. Instead they're
+		// members cleared and refilled each frame, so once
+		// the detector has seen a frame size they keep their
+		// buffers. Indexed by scale
+		MatT                                  f32Img_;
+		std::vector<double>                   scales_;
+		std::vector<std::pair<MatT, double> > scaledImages12_;
+		std::vector<std::pair<MatT, double> > scaledImages24_;
+		std::vector<std::pair<MatT, double> > scaledDepths_;
+		std::vector<std::vector<Window> >     levelWindows_;
+		std::vector<std::vector<Window> >     unfilteredWindows_;
+		std::vector<DepthRangeFilter>         depthFilters_;
+
+		// Reused for each NMS pass so its buffers
+		// only get allocated once
+		NMSBoxes            nms_;
+		std::vector<size_t> nmsOut_;
+
+		// Per-image classifier scores for the current batch
+		std::vector<float>  batchScores_;
+
+		// Scale and x/y shift for each output of the
+		// calibration nets.  Worked out once from the labels
+		// so calibration is just table lookups
+		struct CalibrationShift
+		{
+			float ds;
+			float dx;
+			float dy;
+			bool  valid;
+		};
+		std::vector<CalibrationShift> c12Shifts_;
+		std::vector<CalibrationShift> c24Shifts_;
+		void buildShiftTable(const ClassifierT &classifier,
+				std::vector<CalibrationShift> &shiftTable);
+
 		void doBatchPrediction(ClassifierT &classifier,
 				const std::vector<MatT> &imgs,
 				const float threshold,
-				const std::string &label,
-				std::vector<size_t> &detected,
-				std::vector<float>  &scores);
+				const int labelIndex,
+				ArenaVector<size_t> &detected,
+				ArenaVector<float>  &scores);
 
 		void generateInitialWindows(
 				const MatT &input,
@@ -74,42 +136,60 @@ class NNDetect
 				const int wsize,
 				double scaleFactor,
 				std::vector<std::pair<MatT, double> > &scaledimages,
+				WindowList &windows);
+
+		void generateLevelWindows(
+				const MatT &input,
+				const MatT &depthIn,
+				const int wsize,
+				const size_t scale,
+				const double scaleValue,
+				std::pair<MatT, double> &scaledImage,
+				std::pair<MatT, double> &scaledDepth,
+				std::vector<Window> &unfilteredWindows,
+				DepthRangeFilter &depthFilter,
 				std::vector<Window> &windows);
 
 		void runDetection(ClassifierT &classifier,
 				const std::vector<std::pair<MatT, double> > &scaledimages,
-				const std::vector<Window> &windows,
+				const WindowList &windows,
 				const float threshold,
 				const std::string &label,
-				std::vector<Window> &windowsOut,
-				std::vector<float> &scores);
+				WindowList &windowsOut,
+				ArenaVector<float> &scores);
 
-		void runGlobalNMS(const std::vector<Window> &windows, 
-				const std::vector<float> &scores,  
+		void runGlobalNMS(const WindowList &windows, 
+				const ArenaVector<float> &scores,  
 				const std::vector<std::pair<MatT, double> > &scaledImages,
 				const double nmsThreshold,
-				std::vector<Window> &windowsOut);
-		void runLocalNMS(const std::vector<Window> &windows, 
-				const std::vector<float> &scores,  
+				WindowList &windowsOut);
+		void runLocalNMS(const WindowList &windows, 
+				const ArenaVector<float> &scores,  
 				const double nmsThreshold,
-				std::vector<Window> &windowsOut);
+				WindowList &windowsOut);
 
-		void runCalibration(const std::vector<Window>& windowsIn,
+		void runCalibration(const WindowList& windowsIn,
 				    const std::vector<std::pair<MatT, double> > &scaledImages,
 				    ClassifierT &classifier,
+				    const std::vector<CalibrationShift> &shiftTable,
 				    float threshold,
-				    std::vector<Window>& windowsOut);
+				    WindowList& windowsOut);
 
+		// Appends a ds, dx, dy shift for each image to shifts
 		void doBatchCalibration(ClassifierT &classifier,
+					const std::vector<CalibrationShift> &shiftTable,
 					const std::vector<MatT>& imags,
 					const float threshold,
-					std::vector<std::vector<float> >& shift);
+					ArenaVector<cv::Vec3f>& shifts);
 
-		void checkDepthList(const float depth_min, const float depth_max,
-				const std::vector<cv::Mat> &depthList, std::vector<bool> &validList);
+		// The GPU version ignores depthFilter and builds
+		// its batches of depth ROIs from scratch each call
+		void filterDepthWindows(const float depth_min, const float depth_max,
+				const cv::Mat &scaledDepth, DepthRangeFilter &depthFilter,
+				const std::vector<Window> &windowsIn, std::vector<Window> &windowsOut);
+		void filterDepthWindows(const float depth_min, const float depth_max,
+				const GpuMat &scaledDepth, DepthRangeFilter &depthFilter,
+				const std::vector<Window> &windowsIn, std::vector<Window> &windowsOut);
 		void checkDepthList(const float depth_min, const float depth_max,
 				const std::vector<GpuMat> &depthList, std::vector<bool> &validList);
-
-		bool depthInRange(const float depth_min, const float depth_max, 
-				const cv::Mat &detectCheck);
 };
@@ -35,14 +35,16 @@ using namespace cv::cuda;
 // hfov should be removed once the detect call takes
 // a tracked object as input
 // the flags control which parts of the detector
-// use GPU vs CPU code
+// use GPU vs CPU code.  cpuNet picks the built-in
+// CPU engine rather than Caffe when running on the CPU
 DetectState::DetectState(const ClassifierIO &d12IO, 
 		const ClassifierIO &d24IO,
 	   	const ClassifierIO &c12IO, 
 		const ClassifierIO &c24IO, 
 		float hfov, 
 		bool gpu,
-	   	bool tensorRT) :
+	   	bool tensorRT,
+		bool cpuNet) :
     detector_(NULL),
 	d12IO_(d12IO),
 	d24IO_(d24IO),
@@ -51,6 +53,7 @@ DetectState::DetectState(const ClassifierIO &d12IO,
 	hfov_(hfov),
 	gpu_(gpu),
 	tensorRT_(tensorRT),
+	cpuNet_(cpuNet),
 	oldGpu_(gpu),
 	oldTensorRT_(tensorRT),
 	reload_(true)
@@ -112,7 +115,9 @@ bool DetectState::update(void)
 #ifndef USE_TensorRT
 	//if (!tensorRT_)
 	{
-		if (!gpu_)
+		if (!gpu_ && cpuNet_)
+			detector_ = new ObjDetectCPUNet(d12Files, d24Files, c12Files, c24Files, hfov_);
+		else if (!gpu_)
 			detector_ = new ObjDetectCaffeCPU(d12Files, d24Files, c12Files, c24Files, hfov_);
 		else
 			detector_ = new ObjDetectCaffeGPU(d12Files, d24Files, c12Files, c24Files, hfov_);
@@ -223,6 +228,8 @@ std::string DetectState::print(void) const
 		ret += "CPU_";
 	if (tensorRT_)
 		ret += "TensorRT";
+	else if (!gpu_ && cpuNet_)
+		ret += "CPUNet";
 	else
 		ret += "Caffe";
 	ret += " " + d12IO_.print() + "," + d24IO_.print() + "," + c12IO_.print() + "," + c24IO_.print();
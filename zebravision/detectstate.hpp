@@ -9,7 +9,7 @@
 class DetectState
 {
 	public:
-		DetectState(const ClassifierIO &d12IO, const ClassifierIO &d24IO, const ClassifierIO &c12IO, const ClassifierIO &c24IO, float hfov, bool gpu = false, bool tensorRT = false);
+		DetectState(const ClassifierIO &d12IO, const ClassifierIO &d24IO, const ClassifierIO &c12IO, const ClassifierIO &c24IO, float hfov, bool gpu = false, bool tensorRT = false, bool cpuNet = false);
 		~DetectState();
 		bool update(void);
 		void toggleGPU(void);
@@ -39,6 +39,7 @@ class DetectState
 		float         hfov_;
 		bool          gpu_;
 		bool          tensorRT_;
+		bool          cpuNet_;   // use CPUNet rather than Caffe for CPU code
 		// Settings from previous frame - used
 		// to undo changes if the selected state
 		// doesn't work
@@ -14,97 +14,154 @@
 using namespace std;
 using namespace cv;
 
-class DetectedPlusIndex
+// Sort by decreasing score.  Only the score is compared, same
+// as the original version of this code.  std::sort given the
+// same comparisons in the same order produces the same
+// ordering, so ties come out the same way too
+static bool scoreGreater(const pair<float, uint32_t> &a, const pair<float, uint32_t> &b)
 {
-	public :
-		DetectedPlusIndex(const Rect &rect, double score, size_t index) :
-			rect_(rect),
-			score_(score),
-			index_(index),
-			valid_(true)
-	{}
-
-		Rect   rect_;
-		float  score_;
-		size_t index_;
-		bool   valid_;
-
-		bool operator> (const DetectedPlusIndex &other) const
-		{
-			return score_ > other.score_;
-		}
-};
+	return a.first > b.first;
+}
 
-void fastNMS(const vector<Detected> &detected, double overlap_th, vector<size_t> &filteredList) 
+void NMSBoxes::clear(void)
+{
+	x1_.clear();
+	y1_.clear();
+	x2_.clear();
+	y2_.clear();
+	score_.clear();
+}
+
+void NMSBoxes::reserve(size_t count)
+{
+	x1_.reserve(count);
+	y1_.reserve(count);
+	x2_.reserve(count);
+	y2_.reserve(count);
+	score_.reserve(count);
+}
+
+void NMSBoxes::push_back(const Rect &rect, float score)
+{
+	x1_.push_back(rect.x);
+	y1_.push_back(rect.y);
+	x2_.push_back(rect.x + rect.width);
+	y2_.push_back(rect.y + rect.height);
+	score_.push_back(score);
+}
+
+size_t NMSBoxes::size(void) const
 {
-	filteredList.clear(); // Clear out return array
-	vector <DetectedPlusIndex> dpi;
+	return score_.size();
+}
 
-	// Create a list that includes the detected input plus the
-	// index into the list as it was passed in.  Keep the index
-	// so we can pass the original unsorted index back to the caller.
-	size_t idx = 0;
-	for (auto it = detected.cbegin(); it != detected.end(); ++it)
-		dpi.push_back(DetectedPlusIndex(it->first, it->second, idx++));
+void NMSBoxes::run(double overlap_th, vector<size_t> &filteredList)
+{
+	filteredList.clear();
+	const size_t n = size();
+	if (n == 0)
+		return;
 
-	// Sort input rects by decreasing score - i.e. look at best
+	// Rank boxes by decreasing score - i.e. look at best
 	// values first
-	sort(dpi.begin(), dpi.end(), greater<DetectedPlusIndex>());
+	byScore_.resize(n);
+	for (size_t i = 0; i < n; i++)
+		byScore_[i] = make_pair(score_[i], (uint32_t)i);
+	sort(byScore_.begin(), byScore_.end(), scoreGreater);
+
+	// Build copies of the boxes sorted by left edge.  A box
+	// can only overlap a kept one if its left edge is left of
+	// the kept box's right edge and no more than the widest
+	// box's width to the left of the kept box's left edge.
+	// That's a contiguous range in this order, found with
+	// a pair of binary searches
+	order_.resize(n);
+	for (size_t i = 0; i < n; i++)
+		order_[i] = i;
+	sort(order_.begin(), order_.end(),
+		 [this](uint32_t a, uint32_t b) { return x1_[a] < x1_[b]; });
+
+	sx1_.resize(n);
+	sy1_.resize(n);
+	sx2_.resize(n);
+	sy2_.resize(n);
+	sArea_.resize(n);
+	sRank_.resize(n);
+	sValid_.assign(n, 1);
+	posOf_.resize(n);
+	int maxWidth = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		const uint32_t idx = order_[i];
+		sx1_[i]   = x1_[idx];
+		sy1_[i]   = y1_[idx];
+		sx2_[i]   = x2_[idx];
+		sy2_[i]   = y2_[idx];
+		sArea_[i] = (x2_[idx] - x1_[idx]) * (y2_[idx] - y1_[idx]);
+		maxWidth  = max(maxWidth, x2_[idx] - x1_[idx]);
+		posOf_[idx] = i;
+	}
+	for (size_t r = 0; r < n; r++)
+		sRank_[posOf_[byScore_[r].second]] = r;
 
-	// Loop through the dpi array. Each time through, grab
-	// the highest scoring remaining rect. Invalidate rects
+	// Walk through boxes in score order. Each time through, grab
+	// the highest scoring remaining box. Invalidate boxes
 	// which overlap and have lower scores. Repeat until
-	// every rect has been the "best" or has been invalidated
-	auto it = dpi.begin();
-	auto dpi_end = dpi.end();
-	do
+	// every box has been the "best" or has been invalidated
+	const int32_t *sx1   = &sx1_[0];
+	const int32_t *sy1   = &sy1_[0];
+	const int32_t *sx2   = &sx2_[0];
+	const int32_t *sy2   = &sy2_[0];
+	const int32_t *sArea = &sArea_[0];
+	const int32_t *sRank = &sRank_[0];
+	int32_t       *sValid = &sValid_[0];
+	for (size_t r = 0; r < n; r++)
 	{
-		// Look for the highest scoring unprocessed 
-		// rectangle left in the list
-		while ((it != dpi_end) && !it->valid_)
-			++it;
-
-		// Exit if everything has been processed
-		if (it != dpi_end)
+		const uint32_t pos = posOf_[byScore_[r].second];
+		if (!sValid[pos])
+			continue;
+
+		// Save the index of the highest ranked remaining box
+		// and invalidate it - this means we've already
+		// processed it
+		filteredList.push_back(byScore_[r].second);
+		sValid[pos] = 0;
+
+		const int32_t tx1   = sx1[pos];
+		const int32_t ty1   = sy1[pos];
+		const int32_t tx2   = sx2[pos];
+		const int32_t ty2   = sy2[pos];
+		const int32_t tArea = sArea[pos];
+		const int32_t tRank = r;
+
+		const size_t lo = upper_bound(sx1_.begin(), sx1_.end(), tx1 - maxWidth) - sx1_.begin();
+		const size_t hi = lower_bound(sx1_.begin() + lo, sx1_.end(), tx2) - sx1_.begin();
+
+		// Look at the Intersection over Union ratio for
+		// each lower-scoring box in range.  The higher this is,
+		// the closer the two rects are to overlapping.  Same
+		// math as the Rect-based code, just without branches
+		for (size_t j = lo; j < hi; j++)
 		{
-			// Save the index of the highest ranked remaining Rect
-			// and invalidate it - this means we've already
-			// processed it
-			filteredList.push_back(it->index_);
-			it->valid_ = false;
-
-			// Save this rect to compare against the
-			// remaining lower-scoring ones
-			Rect topRect = it->rect_;
-
-			// Set up to continue processing next
-			// rectangle next time through
-			++it;
-
-			// Loop through the rest of the array, looking
-			// for entries which overlap with the current "good"
-			// one being processed
-			for (auto jt = it; jt != dpi_end; ++jt) 
-			{
-				// Only check entries which haven't 
-				// been removed already
-				if (jt->valid_)
-				{
-					Rect thisRect = jt->rect_;
-
-					// Look at the Intersection over Union ratio.
-					// The higher this is, the closer the two rects are
-					// to overlapping
-					double intersectArea = (topRect & thisRect).area();
-					double unionArea     = topRect.area() + thisRect.area() - intersectArea;
-
-					if ((intersectArea > 0.0) && ((1-(intersectArea / unionArea)) <= overlap_th))
-						jt->valid_ = false; // invalidate Rects which overlap
-				}
-			}
+			const int32_t iw = min(sx2[j], tx2) - max(sx1[j], tx1);
+			const int32_t ih = min(sy2[j], ty2) - max(sy1[j], ty1);
+			const double intersectArea = ((iw > 0) & (ih > 0)) ? (double)(iw * ih) : 0.0;
+			const double unionArea     = (tArea + sArea[j]) - intersectArea;
+			const bool   suppress      = (sRank[j] > tRank) &
+										 (intersectArea > 0.0) &
+										 ((1 - (intersectArea / unionArea)) <= overlap_th);
+			sValid[j] &= !suppress;
 		}
 	}
-	while (it != dpi_end);
+}
+
+void fastNMS(const vector<Detected> &detected, double overlap_th, vector<size_t> &filteredList) 
+{
+	NMSBoxes boxes;
+	boxes.reserve(detected.size());
+	for (auto it = detected.cbegin(); it != detected.cend(); ++it)
+		boxes.push_back(it->first, it->second);
+	boxes.run(overlap_th, filteredList);
 }
 
 #if 0
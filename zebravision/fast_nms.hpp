@@ -2,9 +2,59 @@
 #define INC_FAST_NMS_H__
 
 #include <opencv2/core/core.hpp>
+#include <stdint.h>
 #include <utility>
 #include <vector>
 
 typedef std::pair<cv::Rect, float> Detected;
 void fastNMS(const std::vector<Detected> &detected, double overlap_th, std::vector<size_t> &filteredList);
+
+// Non-maximum suppression over a set of boxes stored as
+// separate arrays of coordinates rather than a list of Rects.
+// Boxes are also kept sorted by left edge, so each kept box
+// only has to be checked against the narrow range of boxes
+// which could possibly overlap it.  The overlap test for
+// that range is written to be easily vectorized.
+// Results are exactly the same as fastNMS() - that just
+// wraps this.
+// Reuse an NMSBoxes object from call to call to avoid
+// reallocating its internal buffers.
+class NMSBoxes
+{
+	public:
+		void clear(void);
+		void reserve(size_t count);
+		void push_back(const cv::Rect &rect, float score);
+		size_t size(void) const;
+
+		// Fill filteredList with the indexes (in the order
+		// boxes were added) of boxes which survive, best
+		// score first
+		void run(double overlap_th, std::vector<size_t> &filteredList);
+
+	private:
+		// Boxes in the order they were added
+		std::vector<int>     x1_;
+		std::vector<int>     y1_;
+		std::vector<int>     x2_;
+		std::vector<int>     y2_;
+		std::vector<float>   score_;
+
+		// Working copies sorted by x1. rank is the position
+		// of each box in score order, valid is cleared once
+		// a box is kept or suppressed
+		std::vector<uint32_t> order_;
+		std::vector<int>      sx1_;
+		std::vector<int>      sy1_;
+		std::vector<int>      sx2_;
+		std::vector<int>      sy2_;
+		std::vector<int>      sArea_;
+		std::vector<int32_t>  sRank_;
+		std::vector<int32_t>  sValid_;
+
+		// Score and original index, sorted best score first
+		std::vector<std::pair<float, uint32_t> > byScore_;
+		// Maps original index to position in the x-sorted arrays
+		std::vector<uint32_t> posOf_;
+};
 #endif
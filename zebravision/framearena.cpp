@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <stdint.h>
+
+#include "framearena.hpp"
+
+using namespace std;
+
+FrameArena::FrameArena(size_t initialSize) :
+	currentBlock_(0),
+	offset_(0),
+	bytesUsed_(0),
+	allocations_(0),
+	peakBytes_(0),
+	heapAllocations_(0)
+{
+	addBlock(initialSize);
+}
+
+FrameArena::~FrameArena()
+{
+	for (auto it = blocks_.begin(); it != blocks_.end(); ++it)
+		free(it->data);
+}
+
+void FrameArena::addBlock(size_t minSize)
+{
+	// Grow geometrically so a frame which outgrows
+	// the arena only needs a few extra blocks
+	size_t size = minSize;
+	if (!blocks_.empty())
+		size = max(size, 2 * blocks_.back().size);
+
+	Block block;
+	block.data = static_cast<char *>(malloc(size));
+	if (!block.data)
+		throw bad_alloc();
+	block.size = size;
+	blocks_.push_back(block);
+	heapAllocations_ += 1;
+}
+
+void *FrameArena::allocate(size_t bytes, size_t alignment)
+{
+	// Try the current block, then any later ones left
+	// over from before, then go to the heap for more
+	while (true)
+	{
+		const Block &block = blocks_[currentBlock_];
+		const uintptr_t base    = reinterpret_cast<uintptr_t>(block.data);
+		const uintptr_t aligned = (base + offset_ + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		const size_t    start   = aligned - base;
+		if ((start + bytes) <= block.size)
+		{
+			offset_      = start + bytes;
+			bytesUsed_  += bytes;
+			allocations_ += 1;
+			peakBytes_   = max(peakBytes_, bytesUsed_);
+			return block.data + start;
+		}
+		if ((currentBlock_ + 1) == blocks_.size())
+			addBlock(bytes + alignment);
+		currentBlock_ += 1;
+		offset_        = 0;
+	}
+}
+
+void FrameArena::reset(void)
+{
+	// If the last frame spilled into more than one block,
+	// swap them all for a single block big enough
+	// to hold everything next time
+	if (blocks_.size() > 1)
+	{
+		size_t total = 0;
+		for (auto it = blocks_.begin(); it != blocks_.end(); ++it)
+		{
+			total += it->size;
+			free(it->data);
+		}
+		blocks_.clear();
+		addBlock(total);
+	}
+	currentBlock_ = 0;
+	offset_       = 0;
+	bytesUsed_    = 0;
+	allocations_  = 0;
+}
+
+size_t FrameArena::bytesUsed(void) const
+{
+	return bytesUsed_;
+}
+
+size_t FrameArena::allocations(void) const
+{
+	return allocations_;
+}
+
+size_t FrameArena::peakBytes(void) const
+{
+	return peakBytes_;
+}
+
+size_t FrameArena::heapAllocations(void) const
+{
+	return heapAllocations_;
+}
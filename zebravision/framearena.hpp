@@ -0,0 +1,115 @@
+// Bump allocator for short-lived per-frame data.
+// Allocations just advance a pointer through a big
+// block of memory.  Nothing is freed individually -
+// reset() throws away everything at once, typically
+// at the start of the next frame.
+//
+// If a frame needs more than the current block, extra
+// blocks are allocated.  reset() then merges them into
+// one block large enough for the whole frame, so once
+// the arena has seen its biggest frame there are no
+// more heap allocations at all.
+//
+// ArenaAllocator lets std::vector and friends use the
+// arena.  Freed memory isn't reused until reset(), so
+// reserve() up front where the final size is known
+// rather than letting the vector grow.
+//
+// Not thread safe - use one arena per thread.
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class FrameArena
+{
+	public:
+		FrameArena(size_t initialSize = 64 * 1024);
+		~FrameArena();
+
+		void *allocate(size_t bytes, size_t alignment);
+
+		// Release everything allocated since the last
+		// reset.  Anything using arena memory must be
+		// gone before this is called
+		void reset(void);
+
+		// Stats for the current frame
+		size_t bytesUsed(void) const;
+		size_t allocations(void) const;
+
+		// Largest bytesUsed() over all frames and the number
+		// of times the arena itself had to go to the heap
+		size_t peakBytes(void) const;
+		size_t heapAllocations(void) const;
+
+	private:
+		FrameArena(const FrameArena &);
+		FrameArena &operator=(const FrameArena &);
+
+		struct Block
+		{
+			char   *data;
+			size_t  size;
+		};
+		void addBlock(size_t minSize);
+
+		std::vector<Block> blocks_;
+		size_t currentBlock_;   // block being allocated from
+		size_t offset_;         // next free byte in that block
+		size_t bytesUsed_;
+		size_t allocations_;
+		size_t peakBytes_;
+		size_t heapAllocations_;
+};
+
+template <class T>
+class ArenaAllocator
+{
+	public:
+		typedef T value_type;
+
+		ArenaAllocator(FrameArena &arena) :
+			arena_(&arena)
+		{
+		}
+
+		template <class U>
+		ArenaAllocator(const ArenaAllocator<U> &other) :
+			arena_(other.arena_)
+		{
+		}
+
+		T *allocate(size_t n)
+		{
+			return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		// Memory comes back all at once in reset()
+		void deallocate(T *, size_t)
+		{
+		}
+
+		template <class U>
+		struct rebind
+		{
+			typedef ArenaAllocator<U> other;
+		};
+
+		FrameArena *arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+	return a.arena_ == b.arena_;
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+	return a.arena_ != b.arena_;
+}
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
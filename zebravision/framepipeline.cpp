@@ -0,0 +1,178 @@
+#include <iostream>
+
+#include "framepipeline.hpp"
+#include "mediain.hpp"
+#include "GoalDetector.hpp"
+#include "FlowLocalizer.hpp"
+#include "detectstate.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Start up one thread per stage. The capture thread
+// starts with the frame the caller has already read
+// and then keeps pulling new ones from cap until
+// it runs out of input
+FramePipeline::FramePipeline(MediaIn *cap,
+							 const Mat &frame,
+							 const Mat &depth,
+							 GoalDetector &gd,
+							 FlowLocalizer &fllc,
+							 DetectState *detectState,
+							 bool filterUsingDepth,
+							 size_t queueDepth) :
+	cap_(cap),
+	gd_(gd),
+	fllc_(fllc),
+	detectState_(detectState),
+	filterUsingDepth_(filterUsingDepth),
+	goalIn_(queueDepth),
+	detectIn_(queueDepth),
+	goalOut_(queueDepth),
+	detectOut_(queueDepth),
+	nextSequence_(0)
+{
+	shared_ptr<PooledFrame> input = make_shared<PooledFrame>();
+	input->frame = frame;
+	input->depth = depth;
+	threads_.create_thread(boost::bind(&FramePipeline::captureThread, this, SharedFrame(input)));
+	threads_.create_thread(boost::bind(&FramePipeline::goalThread, this));
+	threads_.create_thread(boost::bind(&FramePipeline::detectThread, this));
+}
+
+FramePipeline::~FramePipeline()
+{
+	stop();
+}
+
+// Closing every queue unblocks any stage waiting
+// to push or pop, and each stage exits once it sees
+// its queue has been closed. Interrupt handles
+// the capture thread being stuck waiting on
+// the input source
+void FramePipeline::stop(void)
+{
+	goalIn_.close();
+	detectIn_.close();
+	goalOut_.close();
+	detectOut_.close();
+	threads_.interrupt_all();
+	threads_.join_all();
+}
+
+// Read frames and hand the same frame to both
+// branches. Each stage only reads from the frame
+// so they can safely share the underlying buffers.
+// The input won't reuse a buffer until every
+// stage has dropped its handle to it
+void FramePipeline::captureThread(SharedFrame input)
+{
+	size_t sequence = 0;
+	do
+	{
+		FrameResult result;
+		result.sequence    = sequence++;
+		result.frameNumber = cap_->frameNumber();
+		result.timeStamp   = cap_->timeStamp();
+		result.input       = input;
+		if (!goalIn_.push(result) || !detectIn_.push(result))
+			break;
+	}
+	while (cap_->getSharedFrame(input));
+
+	goalIn_.close();
+	detectIn_.close();
+}
+
+// Goal detection plus optical flow. Both keep
+// state from the previous frame so they need to
+// see frames one at a time in order
+void FramePipeline::goalThread(void)
+{
+	FrameResult result;
+	while (goalIn_.pop(result))
+	{
+		gd_.processFrame(result.input->frame, result.input->depth);
+		result.goalDist  = gd_.dist_to_goal();
+		result.goalAngle = gd_.angle_to_goal();
+		result.goalRect  = gd_.goal_rect();
+		result.goalPos   = gd_.goal_pos();
+
+		if (detectState_)
+		{
+			fllc_.processFrame(result.input->frame);
+			result.flowTransform = fllc_.transform_mat();
+		}
+		if (!goalOut_.push(result))
+			break;
+	}
+	goalOut_.close();
+}
+
+// Neural net cascade. Reloading the detector
+// also happens here so it can't change out
+// from under a Detect() call in progress
+void FramePipeline::detectThread(void)
+{
+	FrameResult result;
+	while (detectIn_.pop(result))
+	{
+		if (detectState_)
+		{
+			if (!detectState_->update())
+			{
+				cerr << "FramePipeline : detector update failed" << endl;
+				break;
+			}
+			detectState_->detector()->Detect(result.input->frame,
+					filterUsingDepth_ ? result.input->depth : Mat(),
+					result.detectRects, result.uncalibDetectRects);
+		}
+		if (!detectOut_.push(result))
+			break;
+	}
+	detectOut_.close();
+}
+
+// Join the outputs of the two branches. Results are
+// buffered by sequence number until both halves of the
+// next frame in capture order have shown up, then
+// merged into a single result for the caller
+bool FramePipeline::getResult(FrameResult &result)
+{
+	while (true)
+	{
+		auto goalIt   = pendingGoal_.find(nextSequence_);
+		auto detectIt = pendingDetect_.find(nextSequence_);
+		if ((goalIt != pendingGoal_.end()) && (detectIt != pendingDetect_.end()))
+		{
+			result = detectIt->second;
+			result.goalDist      = goalIt->second.goalDist;
+			result.goalAngle     = goalIt->second.goalAngle;
+			result.goalRect      = goalIt->second.goalRect;
+			result.goalPos       = goalIt->second.goalPos;
+			result.flowTransform = goalIt->second.flowTransform;
+			pendingGoal_.erase(goalIt);
+			pendingDetect_.erase(detectIt);
+			nextSequence_ += 1;
+			return true;
+		}
+
+		// Wait for whichever branch is missing the
+		// next frame. A closed queue means that branch
+		// is done - there's nothing more to return
+		FrameResult partial;
+		if (goalIt == pendingGoal_.end())
+		{
+			if (!goalOut_.pop(partial))
+				return false;
+			pendingGoal_[partial.sequence] = partial;
+		}
+		else
+		{
+			if (!detectOut_.pop(partial))
+				return false;
+			pendingDetect_[partial.sequence] = partial;
+		}
+	}
+}
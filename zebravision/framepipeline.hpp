@@ -0,0 +1,113 @@
+// Runs the per-frame processing stages of zv in separate
+// threads connected by bounded queues :
+//
+//   capture --+--> goal detect + optical flow --+--> join --> caller
+//             |                                 |
+//             +--> neural net detection --------+
+//
+// Each stage is a single thread so stateful stages (GoalDetector,
+// FlowLocalizer, the classifier) still see frames in order.  Both
+// branches of the graph work on the same frame buffers - frames
+// are passed around as SharedFrame handles to the input's pooled
+// buffers, so nothing is copied between capture and the stages.  The join step matches the results from the
+// two branches up by frame sequence number so the caller gets them
+// back in capture order, one complete FrameResult per input frame.
+// With this, capture and goal detection of frame N+1 overlap with
+// the neural net cascade of frame N.
+#pragma once
+
+#include <map>
+#include <vector>
+#include <boost/thread.hpp>
+#include <opencv2/core/core.hpp>
+
+#include "boundedqueue.hpp"
+#include "framepool.hpp"
+
+class MediaIn;
+class GoalDetector;
+class FlowLocalizer;
+class DetectState;
+
+// Everything the main loop needs to know about a frame
+// once all of the per-frame stages have run on it
+struct FrameResult
+{
+	FrameResult(void) :
+		sequence(0),
+		frameNumber(0),
+		timeStamp(0),
+		goalDist(-1),
+		goalAngle(-1)
+	{
+	}
+
+	size_t      sequence;    // order frame was captured in
+	int         frameNumber; // cap->frameNumber() for this frame
+	long long   timeStamp;   // cap->timeStamp() for this frame
+	SharedFrame input;       // frame + depth, read only
+
+	// Filled in by goal detection branch
+	float       goalDist;
+	float       goalAngle;
+	cv::Rect    goalRect;
+	cv::Point3f goalPos;
+	cv::Mat     flowTransform; // from FlowLocalizer
+
+	// Filled in by neural net detection branch
+	std::vector<cv::Rect> detectRects;
+	std::vector<cv::Rect> uncalibDetectRects;
+};
+
+class FramePipeline
+{
+	public:
+		// frame and depth are the frame already read from cap
+		// by the caller. This is the first frame sent through
+		// the pipeline, and is shared rather than copied so
+		// the caller shouldn't write to it after this.
+		// detectState can be NULL to skip
+		// neural net detection. queueDepth is the number of
+		// frames allowed to wait between each pair of stages
+		FramePipeline(MediaIn *cap,
+					  const cv::Mat &frame,
+					  const cv::Mat &depth,
+					  GoalDetector &gd,
+					  FlowLocalizer &fllc,
+					  DetectState *detectState,
+					  bool filterUsingDepth,
+					  size_t queueDepth = 2);
+		~FramePipeline();
+
+		// Get the next completed frame in capture order.
+		// Returns false at end of input or if a stage
+		// failed
+		bool getResult(FrameResult &result);
+
+	private:
+		void captureThread(SharedFrame input);
+		void goalThread(void);
+		void detectThread(void);
+		void stop(void);
+
+		MediaIn       *cap_;
+		GoalDetector  &gd_;
+		FlowLocalizer &fllc_;
+		DetectState   *detectState_;
+		bool           filterUsingDepth_;
+
+		// Queues between stages
+		BoundedQueue<FrameResult> goalIn_;
+		BoundedQueue<FrameResult> detectIn_;
+		BoundedQueue<FrameResult> goalOut_;
+		BoundedQueue<FrameResult> detectOut_;
+
+		// Results from one branch waiting for
+		// the other branch to catch up, keyed
+		// by frame sequence number
+		std::map<size_t, FrameResult> pendingGoal_;
+		std::map<size_t, FrameResult> pendingDetect_;
+		size_t         nextSequence_;
+
+		boost::thread_group threads_;
+};
@@ -0,0 +1,130 @@
+#include <atomic>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "framepool.hpp"
+
+using namespace std;
+using namespace cv;
+
+FramePool::FramePool(int maxRows) :
+	maxRows_(maxRows)
+{
+}
+
+// Mats built on top of memory owned by the input
+// source - ZMSIn's decode buffer or file mapping, for
+// example - have no reference count
+static bool ownsData(const Mat &mat)
+{
+#if CV_MAJOR_VERSION == 2
+	return mat.refcount != NULL;
+#else
+	return mat.u != NULL;
+#endif
+}
+
+// Swap src into dst if it has its own buffer. If not, the
+// source is going to overwrite that memory on its next read
+// while consumers may still be using it, so copy instead
+static void moveInto(Mat &src, Mat &dst)
+{
+	if (ownsData(src))
+		cv::swap(src, dst);
+	else
+		src.copyTo(dst);
+}
+
+// Find a buffer only the pool is holding on to, or
+// add a new one if every buffer is still in use
+shared_ptr<PooledFrame> FramePool::acquire(void)
+{
+	for (auto it = slots_.begin(); it != slots_.end(); ++it)
+	{
+		if (it->use_count() == 1)
+		{
+			// use_count() is a relaxed read. Make sure
+			// whichever thread dropped the last handle
+			// is done reading the buffer before it gets
+			// overwritten
+			atomic_thread_fence(memory_order_acquire);
+			return *it;
+		}
+	}
+	slots_.push_back(make_shared<PooledFrame>());
+	return slots_.back();
+}
+
+SharedFrame FramePool::publish(Mat &frame, Mat &depth)
+{
+	Mat noStorage;
+	return publish(frame, depth, noStorage);
+}
+
+SharedFrame FramePool::publish(Mat &frame, Mat &depth, Mat &storage)
+{
+	shared_ptr<PooledFrame> slot = acquire();
+
+	size_t levels = 0;
+	for (int rows = frame.rows; rows > maxRows_; rows = (rows + 1) / 2)
+		levels += 1;
+
+	// A slot last filled along with storage only holds
+	// headers pointing into it. Drop them rather than
+	// handing them to the caller to read into or
+	// downscaling over them
+	const bool tradeStorage = (levels == 0) && !storage.empty();
+	if (!slot->storage.empty() && !tradeStorage)
+	{
+		slot->frame.release();
+		slot->depth.release();
+		slot->storage.release();
+	}
+
+	if (tradeStorage)
+	{
+		// frame and depth point into storage so
+		// all three move together. The caller
+		// unpacks the next frame into whatever
+		// storage this slot held last time
+		cv::swap(frame, slot->frame);
+		cv::swap(depth, slot->depth);
+		cv::swap(storage, slot->storage);
+	}
+	else if (levels == 0)
+	{
+		// Already small enough - swap buffers with the
+		// caller rather than copying. The caller reads
+		// the next frame into the buffer this slot held
+		// last time, which is the same size once things
+		// are warmed up
+		moveInto(frame, slot->frame);
+		moveInto(depth, slot->depth);
+	}
+	else
+	{
+		downscale(frame, slot->frame, levels, frameScratch_);
+		if (depth.empty())
+			slot->depth = Mat();
+		else
+			downscale(depth, slot->depth, levels, depthScratch_);
+	}
+	return slot;
+}
+
+// pyrDown levels times, going straight into dst on the
+// last step rather than downscaling in place, which
+// reallocates at every level
+void FramePool::downscale(const Mat &src, Mat &dst, size_t levels, vector<Mat> &scratch)
+{
+	// Size this before grabbing pointers into it
+	if (scratch.size() < (levels - 1))
+		scratch.resize(levels - 1);
+
+	const Mat *in = &src;
+	for (size_t i = 0; i < levels; i++)
+	{
+		Mat &out = ((i + 1) == levels) ? dst : scratch[i];
+		pyrDown(*in, out);
+		in = &out;
+	}
+}
@@ -0,0 +1,81 @@
+// Pool of reusable frame + depth buffers used to hand captured
+// frames from an input's update thread to the code processing
+// them without copying.
+//
+// The capture side reads each new frame into its own staging
+// Mats and calls publish().  That downscales the frame into a
+// free pooled buffer - or, if it is already small enough, just
+// trades buffers with the staging Mats - and returns it as a
+// SharedFrame, a reference counted pointer to const data which
+// any number of consumers can hold at once.  A buffer goes back
+// into circulation once the last SharedFrame pointing at it is
+// released.  Once there are enough buffers for every frame in
+// flight, publishing a frame allocates nothing and copies nothing
+// beyond the downscale itself.
+//
+// Inputs which unpack frame and depth from one larger buffer -
+// ZMSIn decompressing a chunk, for example - pass that buffer
+// in as storage, and it is traded along with the Mats pointing
+// into it.  Staging Mats pointing at memory the input will
+// overwrite without telling the pool are copied instead of
+// traded, since consumers may still be reading the old data.
+//
+// Consumers must not write into a SharedFrame's Mats, or keep
+// cv::Mat headers pointing at them after dropping the SharedFrame.
+// clone() the frame to get something to draw on.
+//
+// publish() is not thread safe - call it from one capture thread.
+// SharedFrames can be copied and dropped from any thread.
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+// storage is the buffer frame and depth point into when
+// they were published along with one, empty otherwise
+struct PooledFrame
+{
+	cv::Mat frame;
+	cv::Mat depth;
+	cv::Mat storage;
+};
+
+typedef std::shared_ptr<const PooledFrame> SharedFrame;
+
+class FramePool
+{
+	public:
+		// Frames are halved with pyrDown until they
+		// are no more than maxRows tall
+		FramePool(int maxRows = 700);
+
+		// Move the frame and depth just read into a pooled
+		// buffer and return a handle to it. frame and depth
+		// are left holding buffers to read the next frame into
+		SharedFrame publish(cv::Mat &frame, cv::Mat &depth);
+
+		// Same, for frame and depth pointing into storage
+		// rather than owning their data.  storage has to
+		// stay untouched until the caller gets it back from
+		// a later publish() - either a buffer the caller
+		// owns or one which never changes, like a read-only
+		// file mapping.  frame, depth and storage are left
+		// holding an earlier frame's buffers
+		SharedFrame publish(cv::Mat &frame, cv::Mat &depth, cv::Mat &storage);
+
+		// Number of buffers allocated so far
+		size_t size(void) const { return slots_.size(); }
+
+	private:
+		int maxRows_;
+		std::vector<std::shared_ptr<PooledFrame> > slots_;
+
+		// Intermediate pyramid levels when a frame
+		// needs more than one pyrDown
+		std::vector<cv::Mat> frameScratch_;
+		std::vector<cv::Mat> depthScratch_;
+
+		std::shared_ptr<PooledFrame> acquire(void);
+		void downscale(const cv::Mat &src, cv::Mat &dst, size_t levels, std::vector<cv::Mat> &scratch);
+};
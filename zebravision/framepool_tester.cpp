@@ -0,0 +1,184 @@
+// Check that frames handed out by FramePool stay put while
+// they're held. Mimics what ZMSIn does for v2 files - each
+// frame is decoded into a buffer and unpacked as Mats pointing
+// into that buffer - then publishes frames and checks that the
+// first handle still holds the first frame's pixels.  That's
+// done both with one decode buffer reused from frame to frame,
+// which the pool has to copy out of, and with the buffer passed
+// in as storage, which the pool should take without copying.
+// Returns non-zero on failure
+#include <iostream>
+#include <vector>
+
+#include "framepool.hpp"
+#include "zmsformat.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Pack, compress and decompress frame + depth into rawBuffer,
+// then unpack Mats pointing into it, same as readIndexedFrame()
+static bool decodeFrame(ZMSCodec codec, const Mat &frameIn, const Mat &depthIn,
+						vector<char> &rawBuffer, Mat &frame, Mat &depth)
+{
+	vector<char> packed;
+	vector<char> stored;
+	zmsPackMats(frameIn, depthIn, packed);
+	if (!zmsCompress(codec, packed, stored))
+		return false;
+	rawBuffer.resize(packed.size());
+	if (!zmsDecompress(codec, stored.data(), stored.size(), rawBuffer.data(), rawBuffer.size()))
+		return false;
+	return zmsUnpackMats(rawBuffer.data(), rawBuffer.size(), frame, depth, false);
+}
+
+// Same, but decompress straight into storage the way
+// readIndexedFrame() does when SyncIn hands it one
+static bool decodeInto(ZMSCodec codec, const Mat &frameIn, const Mat &depthIn,
+					   Mat &storage, Mat &frame, Mat &depth)
+{
+	vector<char> packed;
+	vector<char> stored;
+	zmsPackMats(frameIn, depthIn, packed);
+	if (!zmsCompress(codec, packed, stored))
+		return false;
+	if (storage.total() < packed.size())
+		storage = Mat(1, (int)packed.size(), CV_8UC1);
+	if (!zmsDecompress(codec, stored.data(), stored.size(), storage.ptr<char>(), packed.size()))
+		return false;
+	return zmsUnpackMats(storage.ptr<char>(), packed.size(), frame, depth, false);
+}
+
+static bool sameAs(const Mat &a, const Mat &b)
+{
+	if ((a.size() != b.size()) || (a.type() != b.type()))
+		return false;
+	Mat diff;
+	absdiff(a, b, diff);
+	return countNonZero(diff.reshape(1)) == 0;
+}
+
+// rows picks whether publish() passes the frame through
+// as-is (<= 700) or downscales it
+static bool testCodec(ZMSCodec codec, int rows)
+{
+	const Mat frame1(rows, rows * 4 / 3, CV_8UC3, Scalar(10, 20, 30));
+	const Mat depth1(rows, rows * 4 / 3, CV_32FC1, Scalar(1.5));
+	const Mat frame2(rows, rows * 4 / 3, CV_8UC3, Scalar(200, 100, 50));
+	const Mat depth2(rows, rows * 4 / 3, CV_32FC1, Scalar(7.25));
+
+	FramePool    pool;
+	vector<char> rawBuffer;
+	Mat          rawFrame;
+	Mat          rawDepth;
+
+	if (!decodeFrame(codec, frame1, depth1, rawBuffer, rawFrame, rawDepth))
+	{
+		cerr << zmsCodecName(codec) << " : could not decode frame 1" << endl;
+		return false;
+	}
+	const SharedFrame first = pool.publish(rawFrame, rawDepth);
+	const Mat firstFrame = first->frame.clone();
+	const Mat firstDepth = first->depth.clone();
+
+	if (!decodeFrame(codec, frame2, depth2, rawBuffer, rawFrame, rawDepth))
+	{
+		cerr << zmsCodecName(codec) << " : could not decode frame 2" << endl;
+		return false;
+	}
+	const SharedFrame second = pool.publish(rawFrame, rawDepth);
+
+	bool ok = true;
+	if (!sameAs(first->frame, firstFrame) || !sameAs(first->depth, firstDepth))
+	{
+		cerr << zmsCodecName(codec) << ", " << rows << " rows : first frame changed after publishing the second" << endl;
+		ok = false;
+	}
+	if ((rows <= 700) && (!sameAs(first->frame, frame1) || !sameAs(second->frame, frame2) ||
+						  !sameAs(first->depth, depth1) || !sameAs(second->depth, depth2)))
+	{
+		cerr << zmsCodecName(codec) << ", " << rows << " rows : published frames don't match input" << endl;
+		ok = false;
+	}
+	return ok;
+}
+
+// Publish the first frame, then keep publishing the second
+// while holding on to the first, all through storage
+static bool testStorage(ZMSCodec codec, int rows)
+{
+	const Mat frame1(rows, rows * 4 / 3, CV_8UC3, Scalar(10, 20, 30));
+	const Mat depth1(rows, rows * 4 / 3, CV_32FC1, Scalar(1.5));
+	const Mat frame2(rows, rows * 4 / 3, CV_8UC3, Scalar(200, 100, 50));
+	const Mat depth2(rows, rows * 4 / 3, CV_32FC1, Scalar(7.25));
+
+	FramePool pool;
+	Mat       rawFrame;
+	Mat       rawDepth;
+	Mat       rawStorage;
+
+	if (!decodeInto(codec, frame1, depth1, rawStorage, rawFrame, rawDepth))
+	{
+		cerr << zmsCodecName(codec) << " : could not decode frame 1 into storage" << endl;
+		return false;
+	}
+	const SharedFrame first = pool.publish(rawFrame, rawDepth, rawStorage);
+	const Mat firstFrame = first->frame.clone();
+	const Mat firstDepth = first->depth.clone();
+
+	bool ok = true;
+	SharedFrame second;
+	for (int i = 0; i < 3; i++)
+	{
+		if (!decodeInto(codec, frame2, depth2, rawStorage, rawFrame, rawDepth))
+		{
+			cerr << zmsCodecName(codec) << " : could not decode frame 2 into storage" << endl;
+			return false;
+		}
+		const uchar *decoded = rawStorage.data;
+		second = pool.publish(rawFrame, rawDepth, rawStorage);
+
+		// Frames which don't need downscaling should be
+		// handed out from the buffer they were decoded into
+		if ((rows <= 700) && (second->frame.data != (decoded + ZMS_MAT_HEADER_SIZE)))
+		{
+			cerr << zmsCodecName(codec) << ", " << rows << " rows : frame was copied out of storage" << endl;
+			ok = false;
+		}
+	}
+
+	if (!sameAs(first->frame, firstFrame) || !sameAs(first->depth, firstDepth))
+	{
+		cerr << zmsCodecName(codec) << ", " << rows << " rows : first frame changed after publishing from storage" << endl;
+		ok = false;
+	}
+	if ((rows <= 700) && (!sameAs(first->frame, frame1) || !sameAs(second->frame, frame2) ||
+						  !sameAs(first->depth, depth1) || !sameAs(second->depth, depth2)))
+	{
+		cerr << zmsCodecName(codec) << ", " << rows << " rows : frames published from storage don't match input" << endl;
+		ok = false;
+	}
+	return ok;
+}
+
+int main(void)
+{
+	const ZMSCodec codecs[] = { ZMS_CODEC_NONE, ZMS_CODEC_ZLIB, ZMS_CODEC_LZ4, ZMS_CODEC_ZSTD };
+	const int      rows[]   = { 480, 1080 };
+
+	bool ok = true;
+	for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++)
+	{
+		if (!zmsCodecAvailable(codecs[c]))
+			continue;
+		for (size_t r = 0; r < sizeof(rows) / sizeof(rows[0]); r++)
+		{
+			if (!testCodec(codecs[c], rows[r]))
+				ok = false;
+			if (!testStorage(codecs[c], rows[r]))
+				ok = false;
+		}
+	}
+	cout << (ok ? "framepool_tester passed" : "framepool_tester FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -134,3 +134,108 @@ void TKalmanFilter::adjustPrediction(const cv::Point3f &delta_pos)
 	kalman.statePre.at<float>(1) = kalman.statePre.at<float>(1) + delta_pos.y;
 	kalman.statePre.at<float>(2) = kalman.statePre.at<float>(2) + delta_pos.z;
 }
+
+//---------------------------------------------------------------------------
+// Transition matrix per axis is
+//   [ 1 dt  ]
+//   [ 0 0.5 ]
+// with process noise Accel_noise_mag * [dt^4/4 dt^3/2; dt^3/2 dt^2]
+// and 0.1 measurement noise / initial covariance - same values
+// TKalmanFilter uses
+TKalmanFilterBank::TKalmanFilterBank(float dt, float Accel_noise_mag) :
+	dt_(dt),
+	velDecay_(0.5),
+	qPP_(pow(dt, 4.0) / 4.0 * Accel_noise_mag),
+	qPV_(pow(dt, 3.0) / 2.0 * Accel_noise_mag),
+	qVV_(pow(dt, 2.0) * Accel_noise_mag),
+	r_(0.1)
+{
+}
+
+void TKalmanFilterBank::push_back(const Point3f &p)
+{
+	position_.push_back(p);
+	velocity_.push_back(Point3f(0, 0, 0));
+	covPP_.push_back(.1);
+	covPV_.push_back(0);
+	covVV_.push_back(.1);
+}
+
+template <class T>
+static void compactVector(vector<T> &v, const vector<unsigned char> &keep)
+{
+	size_t out = 0;
+	for (size_t i = 0; i < v.size(); i++)
+		if (keep[i])
+			v[out++] = v[i];
+	v.resize(out);
+}
+
+void TKalmanFilterBank::compact(const vector<unsigned char> &keep)
+{
+	compactVector(position_, keep);
+	compactVector(velocity_, keep);
+	compactVector(covPP_, keep);
+	compactVector(covPV_, keep);
+	compactVector(covVV_, keep);
+}
+
+//---------------------------------------------------------------------------
+// x' = F x, P' = F P F^T + Q
+void TKalmanFilterBank::predict(size_t count, Point3f *prediction)
+{
+	if (count == 0)
+		return;
+	const float dt  = dt_;
+	const float a   = velDecay_;
+	Point3f *pos = &position_[0];
+	Point3f *vel = &velocity_[0];
+	float   *pp  = &covPP_[0];
+	float   *pv  = &covPV_[0];
+	float   *vv  = &covVV_[0];
+	for (size_t i = 0; i < count; i++)
+	{
+		pos[i] += vel[i] * dt;
+		vel[i] *= a;
+
+		const float p0 = pp[i];
+		const float p1 = pv[i];
+		const float p2 = vv[i];
+		pp[i] = p0 + 2.f * dt * p1 + dt * dt * p2 + qPP_;
+		pv[i] = a * (p1 + dt * p2) + qPV_;
+		vv[i] = a * a * p2 + qVV_;
+
+		prediction[i] = pos[i];
+	}
+}
+
+//---------------------------------------------------------------------------
+// K = P H^T (H P H^T + R)^-1, x' = x + K (z - H x), P' = P - K H P
+// H picks out position so each axis gain is just a pair of
+// divides by the same innovation variance
+void TKalmanFilterBank::update(size_t count, const Point3f *measurement, Point3f *estimated)
+{
+	if (count == 0)
+		return;
+	Point3f *pos = &position_[0];
+	Point3f *vel = &velocity_[0];
+	float   *pp  = &covPP_[0];
+	float   *pv  = &covPV_[0];
+	float   *vv  = &covVV_[0];
+	for (size_t i = 0; i < count; i++)
+	{
+		const float s  = pp[i] + r_;
+		const float kp = pp[i] / s;
+		const float kv = pv[i] / s;
+
+		const Point3f innovation = measurement[i] - pos[i];
+		pos[i] += innovation * kp;
+		vel[i] += innovation * kv;
+
+		vv[i] -= kv * pv[i];
+		pv[i] -= kp * pv[i];
+		pp[i] -= kp * pp[i];
+
+		estimated[i] = pos[i];
+	}
+}
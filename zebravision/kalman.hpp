@@ -1,5 +1,6 @@
 // From : https://raw.githubusercontent.com/Smorodov/Multitarget-tracker/master/KalmanFilter/Kalman.h
 #pragma once
+#include <vector>
 #include <opencv2/opencv.hpp>
 //#include <Eigen/Geometry>
 // http://www.morethantechnical.com/2011/06/17/simple-kalman-filter-for-tracking-using-opencv-2-2-w-code/
@@ -15,3 +16,50 @@ class TKalmanFilter
 		cv::KalmanFilter kalman;
 };
 
+// Same filter as TKalmanFilter, run for many objects at once.
+// State is stored as parallel arrays rather than one
+// cv::KalmanFilter per object.  Since the transition, process
+// noise, measurement and measurement noise matrices are the
+// same for x, y and z and there are no cross-axis terms, the
+// 6x6 covariance splits into three identical 2x2 blocks
+// (position / velocity) - keep just one per filter. The math
+// is otherwise the same as cv::KalmanFilter predict()/correct()
+class TKalmanFilterBank
+{
+	public:
+		TKalmanFilterBank(float dt = 0.05, float Accel_noise_mag = 0.5);
+
+		size_t size(void) const { return position_.size(); }
+
+		// Add a new filter starting at p with zero velocity
+		void push_back(const cv::Point3f &p);
+
+		// Drop filters for which keep[i] is 0, preserving
+		// the order of the rest
+		void compact(const std::vector<unsigned char> &keep);
+
+		// Run predict on the first count filters, filling
+		// prediction[0..count-1]
+		void predict(size_t count, cv::Point3f *prediction);
+
+		// Correct the first count filters using measurement[i],
+		// filling estimated[0..count-1] with the new positions
+		void update(size_t count, const cv::Point3f *measurement, cv::Point3f *estimated);
+
+	private:
+		// Per-axis transition, process noise and measurement noise
+		float dt_;
+		float velDecay_;
+		float qPP_;
+		float qPV_;
+		float qVV_;
+		float r_;
+
+		// Per-filter state and position/velocity covariance
+		std::vector<cv::Point3f> position_;
+		std::vector<cv::Point3f> velocity_;
+		std::vector<float>       covPP_;
+		std::vector<float>       covPV_;
+		std::vector<float>       covVV_;
+};
+
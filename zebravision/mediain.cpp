@@ -50,6 +50,18 @@ bool MediaIn::getFrame(Mat &frame, Mat &depth, bool pause)
 	return false;
 }
 
+bool MediaIn::getSharedFrame(SharedFrame &frame, bool pause)
+{
+	std::shared_ptr<PooledFrame> newFrame = std::make_shared<PooledFrame>();
+	if (!getFrame(newFrame->frame, newFrame->depth, pause))
+	{
+		frame.reset();
+		return false;
+	}
+	frame = newFrame;
+	return true;
+}
+
 bool MediaIn::isOpened(void) const
 {
 	return false;
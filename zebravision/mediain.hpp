@@ -10,6 +10,7 @@
 #include <tinyxml2.h>
 
 #include "cameraparams.hpp"
+#include "framepool.hpp"
 #include "frameticker.hpp"
 #include "ZvSettings.hpp"
 
@@ -25,6 +26,12 @@ class MediaIn
 		virtual bool isOpened(void) const;
 		virtual bool getFrame(cv::Mat &frame, cv::Mat &depth, bool pause = false);
 
+		// Same as getFrame, but returns a read-only handle to
+		// the frame rather than a copy of it.  Inputs which
+		// buffer frames in a FramePool hand out the pooled
+		// buffer directly. The default wraps getFrame()
+		virtual bool getSharedFrame(SharedFrame &frame, bool pause = false);
+
 		// Image size
 		unsigned int width() const;
 		unsigned int height() const;
@@ -2,32 +2,62 @@
 #include "mediaout.hpp"
 #include "frameticker.hpp"
 
+using namespace std;
 using namespace cv;
 
+// Pick a default number of encode threads. Leave
+// half the cores for the rest of the code
+static size_t defaultEncodeThreads(size_t encodeThreads)
+{
+	if (encodeThreads > 0)
+		return encodeThreads;
+	return max<size_t>(boost::thread::hardware_concurrency() / 2, 1);
+}
+
 // Set up variables to skip frames and split
 // between files as set up by the derived class
-// Initialize frameReady shared var to false and 
-// kick off the writer thread
-MediaOut::MediaOut(int frameSkip, int framesPerFile) :
+// Kick off the encoder and writer threads
+MediaOut::MediaOut(int frameSkip, int framesPerFile,
+				   size_t encodeThreads, DropPolicy dropPolicy,
+				   size_t queueDepth) :
 	frameSkip_(max(frameSkip, 1)),
 	frameCounter_(0),
 	fileCounter_(0),
 	framesPerFile_(framesPerFile),
 	framesThisFile_(framesPerFile_),
-	frameReady_(false),
-	writePending_(false),
-	thread_(boost::bind(&MediaOut::writeThread, this))
+	dropPolicy_(dropPolicy),
+	nextSequence_(0),
+	encodeQueue_(queueDepth ? queueDepth : 2 * defaultEncodeThreads(encodeThreads)),
+	nextWrite_(0),
+	framesWritten_(0),
+	framesDropped_(0),
+	framesFailed_(0),
+	shutdown_(false)
 {
+	encodeThreads = defaultEncodeThreads(encodeThreads);
+	for (size_t i = 0; i < encodeThreads; i++)
+		encodeThreads_.create_thread(boost::bind(&MediaOut::encodeThread, this));
+	writeThread_ = boost::thread(boost::bind(&MediaOut::writeThread, this));
 }
 
 MediaOut::~MediaOut(void)
 {
 	// Make sure any pending frames have been
-	// written, then shut down the writer
-	// thread.  Once that's finished, exit
+	// written, then shut down the encode and writer
+	// threads.  Once that's finished, exit
 	sync();
-  	thread_.interrupt();
-  	thread_.join();
+	encodeQueue_.close();
+	encodeThreads_.join_all();
+	{
+		boost::mutex::scoped_lock lock(writeLock_);
+		shutdown_ = true;
+		writeCond_.notify_all();
+	}
+	writeThread_.join();
+
+	if (framesWritten_ || framesDropped_ || framesFailed_)
+		cout << "MediaOut : " << framesWritten_ << " frames written, "
+			 << framesDropped_ << " dropped, " << framesFailed_ << " failed" << endl;
 }
 
 // Save a frame if there have been frameSkip_ frames
@@ -37,60 +67,66 @@ MediaOut::~MediaOut(void)
 // to the current video
 bool MediaOut::saveFrame(const Mat &frame, const Mat &depth)
 {
-	// Every frameSkip_ frames, copy another frame
-	// to the frame_ and depth_ vars. Then set frameReady_
-	// to trigger the writer thread to grab them and
-	// write them to disk
-	if ((frameCounter_++ % frameSkip_) == 0)
+	boost::mutex::scoped_lock lock(saveLock_);
+	if ((frameCounter_++ % frameSkip_) != 0)
+		return true;
+
+	Job job;
+	job.sequence    = nextSequence_;
+	job.fileCounter = -1;
+	job.encoded     = false;
+
+	// Open a new video when we've written framesThisFile
+	// framesThisFile is initialized to framesPerFile so
+	// this also opens the file the first time this
+	// method is called.  The writer thread does the
+	// actual open once all of the frames for the
+	// previous file have been written
+	const bool newFile = framesThisFile_ >= framesPerFile_;
+	if (newFile)
+		job.fileCounter = fileCounter_;
+
+	// Copy the input args since the caller is free
+	// to reuse them once this call returns
+	frame.copyTo(job.frame);
+	depth.copyTo(job.depth);
+
+	if (dropPolicy_ == BLOCK)
 	{
-		boost::mutex::scoped_lock lock(matLock_);
+		if (!encodeQueue_.push(job))
+			return false;
+	}
+	else if (!encodeQueue_.tryPush(job))
+	{
+		// Queue is full - the encoders aren't keeping
+		// up.  Drop this frame rather than slow down
+		// the caller. Programs which need to save
+		// every frame should use the BLOCK policy
+		boost::mutex::scoped_lock writeLock(writeLock_);
+		framesDropped_ += 1;
+		return true;
+	}
 
-		// Open a new video when we've written framesThisFile
-		// framesThisFile is initialized to framesPerFile so
-		// this also opens the file the first time this
-		// method is called
-		if (framesThisFile_ >= framesPerFile_)
-		{
-			// Wait until pending writes are complete
-			// before closing the previous file
-			while (frameReady_ || writePending_)
-				frameCond_.wait(lock);
-
-			if (!openNext(fileCounter_++))
-				return false;
-			framesThisFile_ = 0;
-		}
-		// Copy input args to shared frame_ and depth_
-		// buffers. Do it unconditionally. This means that
-		// it is possible for the update thread to miss
-		// frames if two calls to this function come in back 
-		// to back. That's OK - the goal here is to
-		// write as many frames as possible
-		// without slowing down performance rather
-		// that waiting to be sure that every frame
-		// it captured to disk.  Programs which
-		// need to save every frame can explicitly
-		// call the sync() method below before
-		// each call to this function.
-		frame.copyTo(frame_);
-		depth.copyTo(depth_);
-		frameReady_ = true;
-		// Set a flag to indicate there is a disk write
-		// that needs to complete
-		writePending_ = true;
-
-		// Notifiy other threads waiting
-		// on the mutex that it is now
-		// available - wake them up to do work
-		frameCond_.notify_all();
+	nextSequence_ += 1;
+	if (newFile)
+	{
+		fileCounter_   += 1;
+		framesThisFile_ = 0;
 	}
+	framesThisFile_ += 1;
 
-	// If we made it this far, the write was successful.
-	// Note that it might be that nothing was written if
-	// this frame was skipped, but that's not an error
+	// If we made it this far, the frame was queued
+	// successfully. Note that it might be that nothing was
+	// queued if this frame was skipped, but that's not an error
 	return true;
 }
 
+void MediaOut::setDropPolicy(DropPolicy dropPolicy)
+{
+	boost::mutex::scoped_lock lock(saveLock_);
+	dropPolicy_ = dropPolicy;
+}
+
 // Dummy member functions - base class shouldn't be called
 // directly so these shouldn't be used
 bool MediaOut::openNext(int fileCounter)
@@ -106,76 +142,90 @@ bool MediaOut::write(const Mat &frame, const Mat &depth)
 	return false;
 }
 
+// Default is no separate encode step - all
+// the work is done in write()
+bool MediaOut::encode(const Mat &frame, const Mat &depth, vector<char> &encoded)
+{
+	(void)frame;
+	(void)depth;
+	(void)encoded;
+	return false;
+}
+
+bool MediaOut::writeEncoded(const vector<char> &encoded)
+{
+	(void)encoded;
+	return false;
+}
+
+// Encode threads. Grab frames from the queue, encode
+// them if the derived class supports it, and pass them
+// on to the writer.  Several of these run at once so
+// frames can finish out of order - the writer sorts
+// that out using the sequence number
+void MediaOut::encodeThread(void)
+{
+	Job job;
+	while (encodeQueue_.pop(job))
+	{
+		job.encoded = encode(job.frame, job.depth, job.data);
+		if (job.encoded)
+		{
+			// Don't hold on to the raw image
+			// data any longer than needed
+			job.frame.release();
+			job.depth.release();
+		}
+
+		boost::mutex::scoped_lock lock(writeLock_);
+		std::swap(encoded_[job.sequence], job);
+		writeCond_.notify_all();
+	}
+}
+
 // Separate thread to write video frames to disk
-// This runs as quickly as possible, but is also
-// designed to drop frames if it gets behind the
-// main processing thread.  
+// Frames are written strictly in the order they
+// were passed to saveFrame
 void MediaOut::writeThread(void)
 {
-	Mat frame;
-	Mat depth;
 	while (true)
 	{
-		// Grab the lock mutex
-		// Check that frameReady is set
-		// if it hasn't, that means there's
-		// no new data to write.  In that case,
-		// call wait() to release the mutex and 
-		// loop around to try again. This lets a
-		// call to saveFrame to complete if one
-		// is waiting on the mutex.
-		// Once frameReady_ has been set, copy
-		// the data out of the member variables
-		// into a local var, release the lock, 
-		// and do the write with the copies
-		// of the Mats.  Using the copies will
-		// let saveFrame write new data to the shared vars
-		// while write() works on the old frame.
-		// Note that saveFrame intentionally
-		// doesn't check to see if frame_ and
-		// depth_ have been copied by this thread
-		// before writing to them.
-		// This way if the write() call takes too
-		// long it is possible for saveFrame to
-		// update the frame_ and depth_ vars more 
-		// than once before this thread reads them again.
-		// That will potentially drop frames, but it
-		// also lets the main thread run as quickly
-		// as possible rather than waiting on this thread
+		Job job;
 		{
-			boost::mutex::scoped_lock lock(matLock_);
-			while (!frameReady_)
-				frameCond_.wait(lock);
-
-			frame_.copyTo(frame);
-			depth_.copyTo(depth);
-			frameReady_ = false;
+			boost::mutex::scoped_lock lock(writeLock_);
+			auto it = encoded_.find(nextWrite_);
+			while (!shutdown_ && (it == encoded_.end()))
+			{
+				writeCond_.wait(lock);
+				it = encoded_.find(nextWrite_);
+			}
+			if (it == encoded_.end())
+				return;
+			std::swap(job, it->second);
+			encoded_.erase(it);
 		}
 
-		// Call a derived class' write() method
+		if ((job.fileCounter >= 0) && !openNext(job.fileCounter))
+			cerr << "MediaOut : could not open output file " << job.fileCounter << endl;
+
+		// Call a derived class' write method
 		// to actually format and write the data to disk
-		write(frame, depth);
-		
-		// If there's no frame in the buffer above
-		// clear out writePending_
-		// Can't just unconditionally clear it since
-		// it is likely that saveFrame() added a new
-		// frame to the shared buffer while the 
-		// write() call just above was taking place
+		bool written;
+		if (job.encoded)
+			written = writeEncoded(job.data);
+		else
+			written = write(job.frame, job.depth);
+
 		{
-			boost::mutex::scoped_lock lock(matLock_);
-			// Update count of frames actually
-			// written to the output
-			framesThisFile_ += 1;
-			if (!frameReady_)
-			{
-				writePending_ = false;
-				frameCond_.notify_all();
-			}
+			boost::mutex::scoped_lock lock(writeLock_);
+			if (written)
+				framesWritten_ += 1;
+			else
+				framesFailed_ += 1;
+			nextWrite_ += 1;
+			writeCond_.notify_all();
 		}
 		ft_.mark();
-
-		boost::this_thread::interruption_point();
 	}
 }
 
@@ -184,6 +234,18 @@ float MediaOut::FPS(void) const
 	return ft_.getFPS();
 }
 
+size_t MediaOut::framesWritten(void) const
+{
+	boost::mutex::scoped_lock lock(writeLock_);
+	return framesWritten_;
+}
+
+size_t MediaOut::framesDropped(void) const
+{
+	boost::mutex::scoped_lock lock(writeLock_);
+	return framesDropped_;
+}
+
 // Loop until any pending write has completed
 // Normally we don't care if the writer gets out of sync
 // and drops frames, so long as the main thread isn't
@@ -192,14 +254,12 @@ float MediaOut::FPS(void) const
 // 1 - when converting or marking up a video input, we want
 //     to make sure every input frame is processed into
 //     the output video
-// 2 - when auto-splitting videos every N frames, we need
-//     to make sure the last frame is written before
-//     closing the old file and moving on to the new one
-// 3 - when shutting down, be sure all writes are finished
+// 2 - when shutting down, be sure all writes are finished
 //     before closing the output files
 void MediaOut::sync(void)
 {
-	boost::mutex::scoped_lock lock(matLock_);
-	while (frameReady_ || writePending_)
-		frameCond_.wait(lock);
+	boost::mutex::scoped_lock saveLock(saveLock_);
+	boost::mutex::scoped_lock lock(writeLock_);
+	while (nextWrite_ < nextSequence_)
+		writeCond_.wait(lock);
 }
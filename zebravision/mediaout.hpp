@@ -1,32 +1,96 @@
 #pragma once
 
+#include <map>
+#include <vector>
 #include <boost/thread.hpp>
 #include <opencv2/core/core.hpp>
 
+#include "boundedqueue.hpp"
 #include "frameticker.hpp"
 
-// Base class for output.  Derived classes are for writing 
+// Base class for output.  Derived classes are for writing
 // AVI videos, zms (video + depth), plus whatever else we
 // imagine in the future.
+//
+// Frames passed to saveFrame() go into a bounded queue.
+// A pool of encode threads pulls frames from the queue and
+// calls the derived class' encode() on them in parallel.
+// A single writer thread then takes the encoded results in
+// the order they were saved and writes them to disk:
+//
+//   saveFrame --> queue --> encode x N --> reorder --> writer
+//
+// Derived classes which can't split encoding from writing
+// (e.g. OpenCV's VideoWriter) leave encode() alone and all
+// the work happens in write() on the writer thread.
 class MediaOut
 {
    public:
-		MediaOut(int frameSkip, int framesPerFile);
+		// What saveFrame does when the queue is full :
+		//   DROP  - throw the new frame away and return right away.
+		//           Keeps the main thread running at full speed.
+		//   BLOCK - wait for room in the queue. Never loses
+		//           frames but can slow down the caller.
+		enum DropPolicy { DROP, BLOCK };
+
+		// encodeThreads is the number of threads to run encode() in.
+		// 0 means pick a value based on the number of CPU cores.
+		// queueDepth is how many frames can be waiting to
+		// be encoded before the drop policy kicks in. 0 means
+		// twice the number of encode threads
+		MediaOut(int frameSkip, int framesPerFile,
+				 size_t encodeThreads = 1,
+				 DropPolicy dropPolicy = DROP,
+				 size_t queueDepth = 0);
 		virtual ~MediaOut();
 		bool saveFrame(const cv::Mat &frame, const cv::Mat &depth);
 		void sync(void);
 		float FPS(void) const;
 
+		void setDropPolicy(DropPolicy dropPolicy);
+
+		// Counts of frames which made it to disk and
+		// frames thrown away because the queue was full
+		size_t framesWritten(void) const;
+		size_t framesDropped(void) const;
+
    protected:
-		// The base class calls these dervied classes to do the 
-		// heavy lifting.  They have to be implemented in the 
+		// The base class calls these dervied classes to do the
+		// heavy lifting.  They have to be implemented in the
 		// base class as well, but hopefully those are never
-		// called 
+		// called
 		virtual bool openNext(int fileCounter);
 		virtual bool write(const cv::Mat &frame, const cv::Mat &depth);
 
-   private: 
-		// Skip output frames if requested.  Skip is how many to 
+		// Optional split of write() into two steps.  encode()
+		// runs in parallel on multiple threads and must not touch
+		// any shared state. Return false if the derived class
+		// doesn't support it, in which case write() is called
+		// instead.  writeEncoded() is then called in frame order
+		// on the writer thread with the results of encode()
+		virtual bool encode(const cv::Mat &frame, const cv::Mat &depth, std::vector<char> &encoded);
+		virtual bool writeEncoded(const std::vector<char> &encoded);
+
+   private:
+		// A frame making its way through the encode
+		// and write threads.  sequence is the order it
+		// was saved in. fileCounter is set to the
+		// file number to open before writing this frame
+		// or -1 to keep writing to the current file
+		struct Job
+		{
+			size_t            sequence;
+			int               fileCounter;
+			cv::Mat           frame;
+			cv::Mat           depth;
+			bool              encoded;
+			std::vector<char> data;
+		};
+
+		void encodeThread(void);
+		void writeThread(void);
+
+		// Skip output frames if requested.  Skip is how many to
 		// skip before writing next output frame, FrameCounter is how
 		// many total frames seen.
 		// Counter is used to split the output into multiple shorter
@@ -36,13 +100,28 @@ class MediaOut
 		int fileCounter_;
 		int framesPerFile_;
 		int framesThisFile_;
-		void writeThread(void);
-		cv::Mat frame_;
-		cv::Mat depth_;
-		boost::mutex matLock_;
-		boost::condition_variable frameCond_;
-		bool frameReady_;
-		bool writePending_;
-		boost::thread thread_;
+		DropPolicy dropPolicy_;
+
+		// Serializes saveFrame calls from multiple threads
+		// so sequence numbers match queue order
+		boost::mutex saveLock_;
+		size_t       nextSequence_;
+
+		BoundedQueue<Job> encodeQueue_;
+
+		// Encoded frames waiting for the writer, keyed
+		// by sequence number so they go out in order
+		// even if the encode threads finish out of order
+		mutable boost::mutex writeLock_;
+		boost::condition_variable writeCond_;
+		std::map<size_t, Job> encoded_;
+		size_t nextWrite_;
+		size_t framesWritten_;
+		size_t framesDropped_;
+		size_t framesFailed_;
+		bool   shutdown_;
+
+		boost::thread_group encodeThreads_;
+		boost::thread writeThread_;
 		FrameTicker ft_;
 };
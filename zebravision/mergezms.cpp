@@ -15,6 +15,7 @@ int main(int argc, char **argv)
 		return 0;
 	}
 	ZMSOut out(argv[1]);
+	out.setDropPolicy(MediaOut::BLOCK);
 	Mat image;
 	Mat depth;
 	for (int i = 2; i < argc; i++)
@@ -23,7 +24,6 @@ int main(int argc, char **argv)
 
 		while (in.getFrame(image, depth))
 		{
-			out.sync();
 			out.saveFrame(image, depth);
 			cout << in.FPS() << " FPS" << endl;
 		}
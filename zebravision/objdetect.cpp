@@ -69,6 +69,7 @@ void ObjDetectNNet<MatT, ClassifierT>::Detect(const Mat &frameInput, const Mat &
 
 #ifndef USE_GIE 
 template class ObjDetectNNet<Mat, CaffeClassifier<Mat>>;
+template class ObjDetectNNet<Mat, CPUClassifier<Mat>>;
 template class ObjDetectNNet<GpuMat, CaffeClassifier<GpuMat>>;
 #else
 template class ObjDetectNNet<Mat, GIEClassifier<Mat>>;
@@ -7,6 +7,7 @@
 #include "detect.hpp"
 #ifndef GIE
 #include "CaffeClassifier.hpp"
+#include "CPUClassifier.hpp"
 #else
 #include "GIEClassifier.hpp"
 #endif
@@ -117,6 +118,26 @@ class ObjDetectCaffeCPU : public ObjDetectNNet<cv::Mat, CaffeClassifier<cv::Mat>
 
 };
 
+// All-CPU code using the built-in CPUNet engine
+// rather than Caffe
+class ObjDetectCPUNet : public ObjDetectNNet<cv::Mat, CPUClassifier<cv::Mat>>
+{
+	public :
+		ObjDetectCPUNet(std::vector<std::string> &d12Files,
+						std::vector<std::string> &d24Files,
+						std::vector<std::string> &c12Files,
+						std::vector<std::string> &c24Files,
+						float hfov) :
+						ObjDetectNNet(d12Files, d24Files, c12Files, c24Files, hfov)
+		{
+		}
+
+		~ObjDetectCPUNet(void)
+		{
+		}
+
+};
+
 // Both detector and Caffe run on the GPU
 class ObjDetectCaffeGPU : public ObjDetectNNet<GpuMat, CaffeClassifier<GpuMat>>
 {
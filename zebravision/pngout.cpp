@@ -19,6 +19,7 @@ PNGOut::PNGOut(const char *outFile) :
 // output file
 PNGOut::~PNGOut()
 {
+	sync();
 }
 
 // Write the frame to a file. This might overwrite 
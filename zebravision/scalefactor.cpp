@@ -10,12 +10,11 @@ using namespace cv::gpu;
 using namespace cv::cuda;
 #endif
 
-void scalefactor(const Mat &inputimage, const Size &objectsize, const Size &minsize, const Size &maxsize, double scaleFactor, vector<pair<Mat, double> > &scaleInfo)
+void scaleList(const Size &objectsize, const Size &minsize, const Size &maxsize, double scaleFactor, vector<double> &scales)
 {
-	scaleInfo.clear();
+	scales.clear();
 	/*
 	Loop multiplying the image size by the scalefactor upto the maxsize	
-	Store each image in the images vector
 	Store the scale factor in the scales vector 
 	*/
 
@@ -24,48 +23,49 @@ void scalefactor(const Mat &inputimage, const Size &objectsize, const Size &mins
 
 	while(scale > (double)objectsize.width / maxsize.width)
 	{	
-		//set objectsize.width to scalefactor * objectsize.width
-		//set objectsize.height to scalefactor * objectsize.height
-		Mat outputimage;
-		cv::resize(inputimage, outputimage, Size(), scale, scale);
-
-		// Resize will round / truncate to integer size, recalculate
-		// scale using actual results from the resize
-		double newscale = max((double)outputimage.rows / inputimage.rows, (double)outputimage.cols / inputimage.cols);
-		
-		scaleInfo.push_back(make_pair(outputimage, newscale));
-
+		scales.push_back(scale);
 		scale /= scaleFactor;		
 	}	
 }
 
-void scalefactor(const GpuMat &inputimage, const Size &objectsize, const Size &minsize, const Size &maxsize, double scaleFactor, vector<pair<GpuMat, double> > &scaleInfo)
+void scaleImage(const Mat &inputimage, double scale, pair<Mat, double> &scaleInfo)
 {
-	scaleInfo.clear();
-	/*
-	Loop multiplying the image size by the scalefactor upto the maxsize	
-	Store each image in the images vector
-	Store the scale factor in the scales vector 
-	*/
+	//set objectsize.width to scalefactor * objectsize.width
+	//set objectsize.height to scalefactor * objectsize.height
+	// Resize into the Mat already in scaleInfo - reuses its
+	// buffer when called with the same sizes frame after frame
+	cv::resize(inputimage, scaleInfo.first, Size(), scale, scale);
+
+	// Resize will round / truncate to integer size, recalculate
+	// scale using actual results from the resize
+	scaleInfo.second = max((double)scaleInfo.first.rows / inputimage.rows, (double)scaleInfo.first.cols / inputimage.cols);
+}
 
-	//only works for square image?
-	double scale = (double)objectsize.width / minsize.width;
+void scaleImage(const GpuMat &inputimage, double scale, pair<GpuMat, double> &scaleInfo)
+{
+	cuda::resize(inputimage, scaleInfo.first, Size(), scale, scale);
 
-	while(scale > (double)objectsize.width / maxsize.width)
-	{	
-		//set objectsize.width to scalefactor * objectsize.width
-		//set objectsize.height to scalefactor * objectsize.height
-		GpuMat outputimage;
-		cuda::resize(inputimage, outputimage, Size(), scale, scale);
+	scaleInfo.second = max((double)scaleInfo.first.rows / inputimage.rows, (double)scaleInfo.first.cols / inputimage.cols);
+}
 
-		// Resize will round / truncate to integer size, recalculate
-		// scale using actual results from the resize
-		double newscale = max((double)outputimage.rows / inputimage.rows, (double)outputimage.cols / inputimage.cols);
-		
-		scaleInfo.push_back(make_pair(outputimage, newscale));
+void scalefactor(const Mat &inputimage, const Size &objectsize, const Size &minsize, const Size &maxsize, double scaleFactor, vector<pair<Mat, double> > &scaleInfo)
+{
+	vector<double> scales;
+	scaleList(objectsize, minsize, maxsize, scaleFactor, scales);
 
-		scale /= scaleFactor;		
-	}	
+	scaleInfo.resize(scales.size());
+	for (size_t i = 0; i < scales.size(); i++)
+		scaleImage(inputimage, scales[i], scaleInfo[i]);
+}
+
+void scalefactor(const GpuMat &inputimage, const Size &objectsize, const Size &minsize, const Size &maxsize, double scaleFactor, vector<pair<GpuMat, double> > &scaleInfo)
+{
+	vector<double> scales;
+	scaleList(objectsize, minsize, maxsize, scaleFactor, scales);
+
+	scaleInfo.resize(scales.size());
+	for (size_t i = 0; i < scales.size(); i++)
+		scaleImage(inputimage, scales[i], scaleInfo[i]);
 }
 
 // Create an array of images which are resized from scaleInfoIn by a factor
@@ -74,35 +74,37 @@ void scalefactor(const GpuMat &inputimage, const Size &objectsize, const Size &m
 // the size versus just doing 2x the actual size of the d12 calculations
 void scalefactor(const Mat &inputimage, const vector<pair<Mat, double> > &scaleInfoIn, int rescaleFactor, vector<pair<Mat, double> > &scaleInfoOut)
 {
-	scaleInfoOut.clear();
-	for (auto it = scaleInfoIn.cbegin(); it != scaleInfoIn.cend(); ++it)
+	// Resize into the existing output Mats so their
+	// buffers get reused from call to call
+	scaleInfoOut.resize(scaleInfoIn.size());
+	for (size_t i = 0; i < scaleInfoIn.size(); i++)
 	{
-		Mat outputimage;
+		Mat &outputimage = scaleInfoOut[i].first;
 
-		Size newSize(it->first.cols * rescaleFactor, it->first.rows * rescaleFactor);
+		Size newSize(scaleInfoIn[i].first.cols * rescaleFactor, scaleInfoIn[i].first.rows * rescaleFactor);
 		cv::resize(inputimage, outputimage, newSize);
 		// calculate scale from actual size, which will
 		// include rounding done to get to integral number
 		// of pixels in each dimension
-		double scale = max((double)outputimage.rows / inputimage.rows, (double)outputimage.cols / inputimage.cols);
-		scaleInfoOut.push_back(make_pair(outputimage, scale));
+		scaleInfoOut[i].second = max((double)outputimage.rows / inputimage.rows, (double)outputimage.cols / inputimage.cols);
 	}
 }
 
 void scalefactor(const GpuMat &inputimage, const vector<pair<GpuMat, double> > &scaleInfoIn, int rescaleFactor, vector<pair<GpuMat, double> > &scaleInfoOut)
 {
-	scaleInfoOut.clear();
-	for (auto it = scaleInfoIn.cbegin(); it != scaleInfoIn.cend(); ++it)
+	// Resize into the existing output Mats so their
+	// buffers get reused from call to call
+	scaleInfoOut.resize(scaleInfoIn.size());
+	for (size_t i = 0; i < scaleInfoIn.size(); i++)
 	{
-		GpuMat outputimage;
+		GpuMat &outputimage = scaleInfoOut[i].first;
 
-		Size newSize(it->first.cols * rescaleFactor, it->first.rows * rescaleFactor);
+		Size newSize(scaleInfoIn[i].first.cols * rescaleFactor, scaleInfoIn[i].first.rows * rescaleFactor);
 		cuda::resize(inputimage, outputimage, newSize);
 		// calculate scale from actual size, which will
 		// include rounding done to get to integral number
 		// of pixels in each dimension
-		double scale = max((double)outputimage.rows / inputimage.rows, (double)outputimage.cols / inputimage.cols);
-		scaleInfoOut.push_back(make_pair(outputimage, scale));
+		scaleInfoOut[i].second = max((double)outputimage.rows / inputimage.rows, (double)outputimage.cols / inputimage.cols);
 	}
 }
 
@@ -22,4 +22,19 @@ void scalefactor(const GpuMat &inputimage,
 		int rescaleFactor, 
 		std::vector<std::pair<GpuMat, double> > &scaleInfoOut);
 
+// The first two calls above split into separate steps. scaleList
+// generates the list of scales to resize the input by and
+// scaleImage creates a single resized image from one of those.
+// Each level only depends on the input image, so callers can
+// use these to build the levels in parallel
+void scaleList(const cv::Size &objectsize, const cv::Size &minsize,
+		const cv::Size &maxsize, double scaleFactor,
+		std::vector<double> &scales);
+
+void scaleImage(const cv::Mat &inputimage, double scale,
+		std::pair<cv::Mat, double> &scaleInfo);
+
+void scaleImage(const GpuMat &inputimage, double scale,
+		std::pair<GpuMat, double> &scaleInfo);
+
 #endif
@@ -45,21 +45,18 @@ void SyncIn::update(void)
 		while (frameReady_)
 			condVar_.wait(guard);
 
-		if (postLockUpdate(frame_, depth_))
+		// Read into the raw buffers then move the
+		// frame into a pooled buffer to hand out.
+		// An empty frame means end of input
+		if (postLockUpdateWithStorage(rawFrame_, rawDepth_, rawStorage_) && !rawFrame_.empty())
 		{
 			setTimeStamp();
 			incFrameNumber();
-			while (frame_.rows > 700)
-			{
-				pyrDown(frame_, frame_);
-				if (!depth_.empty())
-					pyrDown(depth_, depth_);
-			}
+			frame_ = pool_.publish(rawFrame_, rawDepth_, rawStorage_);
 		}
 		else
 		{
-			frame_ = Mat();
-			depth_ = Mat();
+			frame_.reset();
 		}
 
 		// Let getFrame know that a frame is ready
@@ -67,17 +64,26 @@ void SyncIn::update(void)
 		frameReady_ = true;
 		condVar_.notify_all();
 	}
-	while (!frame_.empty());
+	while (frame_);
 }
 
 
-bool SyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
+// Most inputs read into Mats with their own
+// data and have no use for storage
+bool SyncIn::postLockUpdateWithStorage(Mat &frame, Mat &depth, Mat &storage)
+{
+	storage.release();
+	return postLockUpdate(frame, depth);
+}
+
+
+bool SyncIn::getSharedFrame(SharedFrame &frame, bool pause)
 {
 	if (!isOpened())
 		return false;
 
-	// If not paused, copy the next frame from
-	// frame_. This is the Mat holding the next
+	// If not paused, grab the next frame from
+	// frame_. This is the handle to the next
 	// frame read from the video that update()
 	// fills in a separate thread
 	if (!pause)
@@ -87,15 +93,14 @@ bool SyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
 		while (!frameReady_)
 			condVar_.wait(guard);
 
-		if (frame_.empty())
+		if (!frame_)
 			return false;
 
-		frame_.copyTo(prevGetFrame_);
-		depth_.copyTo(prevGetDepth_);
+		prevGetFrame_ = frame_;
 		lockTimeStamp();
 		lockFrameNumber();
 
-		// Let update() know that getFrame has copied
+		// Let update() know that getFrame has taken
 		// the current frame out of frame_
 		frameReady_ = false;
 		condVar_.notify_all();
@@ -105,10 +110,23 @@ bool SyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
 		// current one is returned and processed
 		// in the main thread.
 	}
-	if (prevGetFrame_.empty())
+	if (!prevGetFrame_)
 		return false;
-	prevGetFrame_.copyTo(frame);
-	prevGetDepth_.copyTo(depth);
+	frame = prevGetFrame_;
+	return true;
+}
+
+
+// Callers of this version are free to draw on the
+// frame returned, so give them their own copy
+bool SyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
+{
+	SharedFrame sharedFrame;
+	if (!getSharedFrame(sharedFrame, pause))
+		return false;
+
+	sharedFrame->frame.copyTo(frame);
+	sharedFrame->depth.copyTo(depth);
 	return true;
 }
 
@@ -18,6 +18,7 @@ class SyncIn : public MediaIn
 		SyncIn(ZvSettings *settings = NULL);
 
 		bool getFrame(cv::Mat &frame, cv::Mat &depth, bool pause = false);
+		bool getSharedFrame(SharedFrame &frame, bool pause = false);
 		void frameNumber(int framenumber);
 
 	protected:
@@ -34,18 +35,33 @@ class SyncIn : public MediaIn
 		// source.  preLock happens before the mutex
 		// while postLock happens inside it
 		virtual bool postLockUpdate(cv::Mat &frame, cv::Mat &depth) = 0;
+
+		// Version called by update(). Inputs which unpack
+		// frame and depth from a buffer of their own can
+		// override this to read into storage and point
+		// frame and depth at it, see FramePool::publish.
+		// Defaults to the version above
+		virtual bool postLockUpdateWithStorage(cv::Mat &frame, cv::Mat &depth, cv::Mat &storage);
+
 		virtual bool postLockFrameNumber(int framenumber) = 0;
 
 	private:
+		// rawFrame_ and rawDepth_ are what postLockUpdate
+		// reads the video into, possibly pointing into
+		// rawStorage_. They're published into a
+		// buffer from pool_ - downscaled there if needed -
+		// and handed out without copying from then on.
 		// frame_ is the most recent frame grabbed from 
 		// the camera
 		// prevGetFrame_ is the last frame returned from
 		// getFrame().  If paused, code needs to keep returning
 		// this frame rather than getting a new one from frame_
-		cv::Mat           frame_;
-		cv::Mat           depth_;
-		cv::Mat           prevGetFrame_;
-		cv::Mat           prevGetDepth_;
+		FramePool         pool_;
+		cv::Mat           rawFrame_;
+		cv::Mat           rawDepth_;
+		cv::Mat           rawStorage_;
+		SharedFrame       frame_;
+		SharedFrame       prevGetFrame_;
 
 		// Mutex used to protect frame_
 		// from simultaneous accesses 
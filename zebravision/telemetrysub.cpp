@@ -0,0 +1,147 @@
+// Subscribe to zv's telemetry and print what comes in.
+//
+//   telemetrysub [endpoint]    - listen to a running zv, by
+//                                default on tcp://localhost:5800
+//   telemetrysub --selftest    - publish some known frames over
+//                                an in-process socket and check they
+//                                decode back to the same values
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <unistd.h>
+#include <zmq.hpp>
+
+#include "zvtelemetry.hpp"
+
+using namespace std;
+
+static void printFrame(const TelemetryFrame &frame)
+{
+	cout << "Frame " << frame.frameNumber << " : " << frame.timestamp;
+	cout << fixed << setprecision(4) << " G " << frame.goalDist;
+	cout << setprecision(2) << " " << frame.goalAngle;
+	if (frame.objectsValid)
+	{
+		cout << " B";
+		for (size_t i = 0; i < frame.objects.size(); i++)
+			cout << " " << frame.objects[i].ratio
+				 << " " << frame.objects[i].x
+				 << " " << frame.objects[i].y
+				 << " " << frame.objects[i].z;
+	}
+	cout << endl;
+}
+
+static bool sameFrame(const TelemetryFrame &a, const TelemetryFrame &b)
+{
+	if ((a.frameNumber  != b.frameNumber) ||
+		(a.timestamp    != b.timestamp) ||
+		(a.objectsValid != b.objectsValid) ||
+		(a.goalDist     != b.goalDist) ||
+		(a.goalAngle    != b.goalAngle) ||
+		(a.objects.size() != b.objects.size()))
+		return false;
+	for (size_t i = 0; i < a.objects.size(); i++)
+		if (memcmp(&a.objects[i], &b.objects[i], sizeof(TelemetryObject)))
+			return false;
+	return true;
+}
+
+static int selfTest(void)
+{
+	zmq::context_t context(1);
+	zmq::socket_t publisher(context, ZMQ_PUB);
+	publisher.bind("inproc://telemetry");
+	zmq::socket_t subscriber(context, ZMQ_SUB);
+	subscriber.connect("inproc://telemetry");
+	subscriber.setsockopt(ZMQ_SUBSCRIBE, "", 0);
+
+	// PUB drops anything sent before the subscription
+	// makes it across, so give it a moment
+	usleep(100000);
+
+	const int frameCount = 100;
+	vector<TelemetryFrame> sent(frameCount);
+	vector<char> buf;
+	for (int i = 0; i < frameCount; i++)
+	{
+		TelemetryFrame &frame = sent[i];
+		frame.frameNumber  = i;
+		frame.timestamp    = 1234567890123LL + i * 33333;
+		frame.objectsValid = (i % 5) != 0;
+		frame.goalDist     = (i % 3) ? i * 0.25f : -1.0f;
+		frame.goalAngle    = -30.f + i * 0.5f;
+		if (frame.objectsValid)
+		{
+			frame.objects.resize(i % 8);
+			for (size_t j = 0; j < frame.objects.size(); j++)
+			{
+				frame.objects[j].ratio = 1.0f / (j + 1);
+				frame.objects[j].x     = i - 0.5f * j;
+				frame.objects[j].y     = -1.0f * j;
+				frame.objects[j].z     = 0.125f * i;
+			}
+		}
+		telemetryEncode(frame, buf);
+		zmq::message_t message(buf.size());
+		memcpy(message.data(), &buf[0], buf.size());
+		publisher.send(message);
+	}
+
+	int failures = 0;
+	TelemetryFrame received;
+	for (int i = 0; i < frameCount; i++)
+	{
+		zmq::message_t message;
+		subscriber.recv(&message);
+		if (!telemetryDecode(static_cast<const char *>(message.data()), message.size(), received) ||
+			!sameFrame(sent[i], received))
+		{
+			cerr << "Frame " << i << " did not decode correctly" << endl;
+			failures += 1;
+		}
+	}
+
+	// Make sure bad messages are rejected rather
+	// than decoded into garbage
+	telemetryEncode(sent[frameCount - 1], buf);
+	if (telemetryDecode(&buf[0], buf.size() - 1, received))
+	{
+		cerr << "Truncated message decoded" << endl;
+		failures += 1;
+	}
+	buf[2] = ZV_TELEMETRY_VERSION + 1;
+	if (telemetryDecode(&buf[0], buf.size(), received))
+	{
+		cerr << "Unknown version decoded" << endl;
+		failures += 1;
+	}
+
+	cout << (failures ? "FAIL" : "PASS") << endl;
+	return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	if ((argc > 1) && !strcmp(argv[1], "--selftest"))
+		return selfTest();
+
+	const char *endpoint = (argc > 1) ? argv[1] : "tcp://localhost:5800";
+	zmq::context_t context(1);
+	zmq::socket_t subscriber(context, ZMQ_SUB);
+	subscriber.connect(endpoint);
+	subscriber.setsockopt(ZMQ_SUBSCRIBE, "", 0);
+	cout << "Listening on " << endpoint << endl;
+
+	TelemetryFrame frame;
+	while (true)
+	{
+		zmq::message_t message;
+		subscriber.recv(&message);
+		if (telemetryDecode(static_cast<const char *>(message.data()), message.size(), frame))
+			printFrame(frame);
+		else
+			cerr << "Ignoring " << message.size() << " byte message with unknown format" << endl;
+	}
+	return 0;
+}
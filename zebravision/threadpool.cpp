@@ -0,0 +1,93 @@
+#include "threadpool.hpp"
+
+ThreadPool::ThreadPool(size_t threadCount) :
+	func_(NULL),
+	count_(0),
+	next_(0),
+	done_(0),
+	generation_(0),
+	shutdown_(false)
+{
+	if (threadCount == 0)
+		threadCount = boost::thread::hardware_concurrency();
+
+	// The thread calling parallelFor does work
+	// as well, so start one less than requested
+	for (size_t i = 1; i < threadCount; i++)
+		threads_.create_thread(boost::bind(&ThreadPool::workerThread, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		boost::mutex::scoped_lock lock(mtx_);
+		shutdown_ = true;
+		workReady_.notify_all();
+	}
+	threads_.join_all();
+}
+
+size_t ThreadPool::size(void) const
+{
+	return threads_.size() + 1;
+}
+
+// Grab items until there are none left.  Called
+// with the lock held, but the lock is dropped
+// while the item itself is running
+void ThreadPool::runItems(boost::mutex::scoped_lock &lock)
+{
+	while (next_ < count_)
+	{
+		const size_t item = next_++;
+		lock.unlock();
+		(*func_)(item);
+		lock.lock();
+		if (++done_ == count_)
+			workDone_.notify_all();
+	}
+}
+
+void ThreadPool::workerThread(void)
+{
+	size_t seenGeneration = 0;
+	boost::mutex::scoped_lock lock(mtx_);
+	while (true)
+	{
+		while (!shutdown_ && (generation_ == seenGeneration))
+			workReady_.wait(lock);
+		if (shutdown_)
+			return;
+		seenGeneration = generation_;
+		runItems(lock);
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, const boost::function<void(size_t)> &func)
+{
+	if (count == 0)
+		return;
+
+	// Nothing to gain from waking up the pool
+	// for a single item or without any workers
+	if ((count == 1) || threads_.size() == 0)
+	{
+		for (size_t i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+
+	boost::mutex::scoped_lock callLock(callMtx_);
+	boost::mutex::scoped_lock lock(mtx_);
+	func_   = &func;
+	count_  = count;
+	next_   = 0;
+	done_   = 0;
+	generation_ += 1;
+	workReady_.notify_all();
+
+	runItems(lock);
+	while (done_ < count_)
+		workDone_.wait(lock);
+	func_ = NULL;
+}
@@ -0,0 +1,49 @@
+// Small persistent pool of worker threads used to split
+// independent pieces of per-frame work across cores.
+// Threads are started once in the constructor and reused
+// for every call, so there's no thread create/join cost
+// per frame.
+// parallelFor(count, func) calls func(0) ... func(count-1)
+// with the calls spread over the pool threads plus the
+// calling thread. It returns once every call has finished.
+// Items are handed out one at a time so a mix of large
+// and small items still balances across threads.
+#pragma once
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+class ThreadPool
+{
+	public:
+		// threadCount is the total number of threads working
+		// on each parallelFor call, including the caller.
+		// 0 means use one per hardware thread
+		ThreadPool(size_t threadCount = 0);
+		~ThreadPool();
+
+		size_t size(void) const;
+
+		void parallelFor(size_t count, const boost::function<void(size_t)> &func);
+
+	private:
+		void workerThread(void);
+		void runItems(boost::mutex::scoped_lock &lock);
+
+		boost::thread_group threads_;
+
+		// Only one parallelFor call at a time
+		boost::mutex callMtx_;
+
+		// Protects everything below
+		boost::mutex mtx_;
+		boost::condition_variable workReady_;
+		boost::condition_variable workDone_;
+
+		const boost::function<void(size_t)> *func_;
+		size_t count_;      // number of items in this call
+		size_t next_;       // next item to hand out
+		size_t done_;       // number of items finished
+		size_t generation_; // incremented for each call
+		bool   shutdown_;
+};
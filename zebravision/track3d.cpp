@@ -1,8 +1,9 @@
+#include <bitset>
+#include <cmath>
 #include <iostream>
 #include <limits>
 
 #include "track3d.hpp"
-#include "hungarian.hpp"
 
 using namespace std;
 using namespace cv;
@@ -12,81 +13,6 @@ using namespace cv;
 const int missedFrameCountMax = 10;
 
 
-static Point3f screenToWorldCoords(const Rect &screen_position, double avg_depth, const Point2f &fov_size, const Size &frame_size, float cameraElevation)
-{
-	/*
-	Method:
-		find the center of the rect
-		compute the distance from the center of the rect to center of image (pixels)
-		convert to degrees based on fov and image size
-		do a polar to cartesian cordinate conversion to find x,y,z of object
-	Equations:
-		x=rsin(inclination) * cos(azimuth)
-		y=rsin(inclination) * sin(azimuth)
-		z=rcos(inclination)
-	Notes:
-		Z is up, X is left-right, and Y is forward
-		(0,0,0) = (r,0,0) = right in front of you
-	*/
-
-	Point2f rect_center(
-			screen_position.tl().x + (screen_position.width  / 2.0),
-			screen_position.tl().y + (screen_position.height / 2.0));
-	Point2f dist_to_center(
-			rect_center.x - (frame_size.width / 2.0),
-			-rect_center.y + (frame_size.height / 2.0));
-	Point2f percent_fov(
-			dist_to_center.x / frame_size.width,
-			dist_to_center.y / frame_size.height);
-
-// TODO : replace with formula from http://www.chiefdelphi.com/forums/showpost.php?p=1571187&postcount=4
-// need focal length from camera information
-	float azimuth = percent_fov.x * fov_size.x;
-	float inclination = percent_fov.y * fov_size.y - cameraElevation;
-
-	Point3f retPt(
-			avg_depth * cosf(inclination) * sinf(azimuth),
-			avg_depth * cosf(inclination) * cosf(azimuth),
-			avg_depth * sinf(inclination));
-
-	//cout << "Distance to center: " << dist_to_center << endl;
-	//cout << "Actual Inclination: " << inclination << endl;
-	//cout << "Actual Azimuth: " << azimuth << endl;
-	//cout << "Actual location: " << retPt << endl;
-
-	return retPt;
-}
-
-static Rect worldToScreenCoords(const Point3f &_position, const ObjectType &_type, const Point2f &fov_size, const Size &frame_size, float cameraElevation)
-{
-	// TODO : replace magic numbers with an object depth property
-	// This constant is half a ball diameter (9.75-ish inches), converted to meters
-	// For example, goals will have 0 depth since we're just shooting at
-	// a plane. 3d objects will have depth, though, so we track the center of the
-	// rather than the front.
-	float r = sqrtf(_position.x * _position.x + _position.y * _position.y + _position.z * _position.z); // - (4.572 * 25.4)/1000.0;
-	float azimuth = asinf(_position.x / sqrt(_position.x * _position.x + _position.y * _position.y));
-	float inclination = asinf( _position.z / r ) + cameraElevation;
-
-	Point2f percent_fov(azimuth / fov_size.x, inclination / fov_size.y);
-	Point2f dist_to_center(percent_fov.x * frame_size.width,
-			                   percent_fov.y * frame_size.height);
-
-	Point2f rect_center(
-			dist_to_center.x + (frame_size.width / 2.0),
-			-dist_to_center.y + (frame_size.height / 2.0));
-
-	Point2f angular_size( 2.0 * atan2f(_type.width(), (2.0*r)), 2.0 * atan2f(_type.height(), (2.0*r)));
-	Point2f screen_size(
-			angular_size.x * (frame_size.width / fov_size.x),
-			angular_size.y * (frame_size.height / fov_size.y));
-
-	Point topLeft(
-			cvRound(rect_center.x - (screen_size.x / 2.0)),
-			cvRound(rect_center.y - (screen_size.y / 2.0)));
-			return Rect(topLeft.x, topLeft.y, cvRound(screen_size.x), cvRound(screen_size.y));
-}
-
 TrackedObject::TrackedObject(int               id,
 							 const ObjectType &type_in,
 							 const Rect       &screen_position,
@@ -100,7 +26,7 @@ TrackedObject::TrackedObject(int               id,
 		type_(type_in),
 		detectHistory_(historyLength),
 		positionHistory_(historyLength),
-		KF_(screenToWorldCoords(screen_position, avg_depth, fov_size, frame_size, camera_elevation),
+		KF_(CameraTransform(fov_size, frame_size, camera_elevation).screenToWorld(screen_position, avg_depth),
 			dt, accel_noise_mag),
 		missedFrameCount_(0),
 		cameraElevation_(camera_elevation)
@@ -137,7 +63,7 @@ void TrackedObject::setPosition(const Point3f &new_position)
 void TrackedObject::setPosition(const Rect &screen_position, double avg_depth,
 		                        const Point2f &fov_size, const Size &frame_size)
 {
-	setPosition(screenToWorldCoords(screen_position, avg_depth, fov_size, frame_size, cameraElevation_));
+	setPosition(CameraTransform(fov_size, frame_size, cameraElevation_).screenToWorld(screen_position, avg_depth));
 }
 
 #if 0
@@ -158,40 +84,6 @@ void TrackedObject::adjustPosition(const Eigen::Transform<double, 3, Eigen::Isom
 	}
 }
 #endif
-void TrackedObject::adjustPosition(const Mat &transform_mat, float depth, const Point2f &fov_size, const Size &frame_size)
-{
-	//get the position of the object on the screen
-	Rect screen_rect = getScreenPosition(fov_size,frame_size);
-	Point screen_pos(screen_rect.tl().x + screen_rect.width / 2, screen_rect.tl().y + screen_rect.height / 2);
-
-	//create a matrix to hold positon for matrix multiplication
-	Mat pos_mat(3,1,CV_64FC1);
-	pos_mat.at<double>(0,0) = screen_pos.x;
-	pos_mat.at<double>(0,1) = screen_pos.y;
-	pos_mat.at<double>(0,2) = 1.0;
-
-	//correct the position
-	Mat new_screen_pos_mat(3,1,CV_64FC1);
-	new_screen_pos_mat = transform_mat * pos_mat;
-	Point new_screen_pos(new_screen_pos_mat.at<double>(0),new_screen_pos_mat.at<double>(1));
-
-	//create a dummy bounding rect because setPosition requires a bounding rect as an input rather than a point
-	Rect new_screen_rect(new_screen_pos.x,new_screen_pos.y,0,0);
-	setPosition(new_screen_rect,depth,fov_size,frame_size);
-	//update the history
-	for (auto it = positionHistory_.begin(); it != positionHistory_.end(); ++it)
-	{
-		screen_rect = worldToScreenCoords(*it,type_,fov_size,frame_size, cameraElevation_);
-		screen_pos = Point(screen_rect.tl().x + screen_rect.width / 2, screen_rect.tl().y + screen_rect.height / 2);
-		pos_mat.at<double>(0,0) = screen_pos.x;
-		pos_mat.at<double>(0,1) = screen_pos.y;
-		pos_mat.at<double>(0,2) = 1.0;
-		Mat new_screen_pos_mat = transform_mat * pos_mat;
-		Point new_screen_pos(new_screen_pos_mat.at<double>(0),new_screen_pos_mat.at<double>(1));
-		Rect new_screen_rect(new_screen_pos.x,new_screen_pos.y,0,0);
-		*it = screenToWorldCoords(new_screen_rect, depth, fov_size, frame_size, cameraElevation_);
-	}
-}
 
 // Mark the object as detected in this frame
 void TrackedObject::setDetected(void)
@@ -244,9 +136,10 @@ vector <Point> TrackedObject::getScreenPositionHistory(const Point2f &fov_size,
 {
 	vector <Point> ret;
 
+	CameraTransform camera(fov_size, frame_size, cameraElevation_);
 	for (auto it = positionHistory_.begin(); it != positionHistory_.end(); ++it)
 	{
-		Rect screen_rect(worldToScreenCoords(*it,type_,fov_size,frame_size, cameraElevation_));
+		Rect screen_rect(camera.worldToScreen(*it, type_));
 		ret.push_back(Point(cvRound(screen_rect.x + screen_rect.width / 2.),cvRound( screen_rect.y + screen_rect.height / 2.)));
 	}
 	return ret;
@@ -301,7 +194,7 @@ double TrackedObject::getDetectedRatio(void) const
 
 Rect TrackedObject::getScreenPosition(const Point2f &fov_size, const Size &frame_size) const
 {
-	return worldToScreenCoords(position_, type_, fov_size, frame_size, cameraElevation_);
+	return CameraTransform(fov_size, frame_size, cameraElevation_).worldToScreen(position_, type_);
 }
 
 
@@ -346,15 +239,196 @@ void TrackedObject::adjustKF(Point3f delta_pos)
 }
 
 
+const double dist_thresh_ = 1.0; // FIX ME!
+//#define VERBOSE_TRACK
+
+// Gating grid.  Cells are dist_thresh_ on a side so any detection
+// within dist_thresh_ of a track is in the track's cell or one
+// of its 26 neighbors. Keys pack the object type index in with
+// the cell coords so only same-type pairs are ever looked at
+static const int cellCoordMax = 32767;
+
+static int cellCoord(float v)
+{
+	float c = floorf(v / dist_thresh_);
+	c = std::max(std::min(c, (float)(cellCoordMax - 1)), (float)(-cellCoordMax + 1));
+	return (int)c;
+}
+
+static uint64_t cellKey(size_t type, int cx, int cy, int cz)
+{
+	return ((uint64_t)type << 48) |
+		   ((uint64_t)(uint16_t)cx << 32) |
+		   ((uint64_t)(uint16_t)cy << 16) |
+		    (uint64_t)(uint16_t)cz;
+}
+
+static bool isFinite(const Point3f &pt)
+{
+	return std::isfinite(pt.x) && std::isfinite(pt.y) && std::isfinite(pt.z);
+}
+
+// Remove entries for which keep[i] is 0, preserving order.
+// stride is the number of array entries per track
+template <class T>
+static void compactTracks(vector<T> &v, const vector<unsigned char> &keep, size_t stride = 1)
+{
+	size_t out = 0;
+	for (size_t i = 0; i < keep.size(); i++)
+	{
+		if (keep[i])
+		{
+			if (out != i)
+				copy(v.begin() + i * stride, v.begin() + (i + 1) * stride, v.begin() + out * stride);
+			out += 1;
+		}
+	}
+	v.resize(out * stride);
+}
+
 //Create a tracked object list
 // those stay constant for the entire length of the run
 TrackedObjectList::TrackedObjectList(const Size &imageSize, const Point2f &fovSize, float cameraElevation) :
+	KF_(0.5, 0.25),
 	detectCount_(0),
-	imageSize_(imageSize),
-	fovSize_(fovSize),
-	cameraElevation_(cameraElevation)
+	camera_(fovSize, imageSize, cameraElevation)
+{
+}
+
+// Look up the index of type in types_, adding it if it
+// hasn't been seen before
+size_t TrackedObjectList::typeIndex(const ObjectType &type)
 {
+	for (size_t i = 0; i < types_.size(); i++)
+		if (types_[i] == type)
+			return i;
+	types_.push_back(type);
+	return types_.size() - 1;
 }
+
+// Start a new track at position, return its index
+size_t TrackedObjectList::addTrack(size_t typeIdx, const Point3f &position)
+{
+	const size_t t = position_.size();
+	position_.push_back(position);
+	typeIdx_.push_back(typeIdx);
+	missedFrameCount_.push_back(0);
+	detectHistory_.push_back(0);
+	detectHistorySize_.push_back(0);
+	positionHistory_.resize(positionHistory_.size() + TrackedObjectHistoryLength);
+	positionHistoryStart_.push_back(0);
+	positionHistorySize_.push_back(0);
+	KF_.push_back(position);
+
+	// Label with base-26 letter ID (A, B, C .. Z, AA, AB, AC, etc)
+	int id = detectCount_++;
+	string idStr;
+	do
+	{
+		idStr += (char)(id % 26 + 'A');
+		id /= 26;
+	}
+	while (id != 0);
+	reverse(idStr.begin(), idStr.end());
+	id_.push_back(idStr);
+
+	pushPosition(t, position);
+	pushDetected(t, true);
+	return t;
+}
+
+// Add this frame's detected / not detected flag to the
+// history for a track
+void TrackedObjectList::pushDetected(size_t track, bool detected)
+{
+	const uint32_t mask = (1U << TrackedObjectHistoryLength) - 1;
+	detectHistory_[track] = ((detectHistory_[track] << 1) | (detected ? 1 : 0)) & mask;
+	if (detectHistorySize_[track] < TrackedObjectHistoryLength)
+		detectHistorySize_[track] += 1;
+	if (detected)
+		missedFrameCount_[track] = 0;
+	else
+		missedFrameCount_[track] += 1;
+}
+
+// Keep a history of the most recent positions
+// of the object in question
+void TrackedObjectList::pushPosition(size_t track, const Point3f &pt)
+{
+	Point3f *history = &positionHistory_[track * TrackedObjectHistoryLength];
+	if (positionHistorySize_[track] < TrackedObjectHistoryLength)
+	{
+		history[(positionHistoryStart_[track] + positionHistorySize_[track]) % TrackedObjectHistoryLength] = pt;
+		positionHistorySize_[track] += 1;
+	}
+	else
+	{
+		history[positionHistoryStart_[track]] = pt;
+		positionHistoryStart_[track] = (positionHistoryStart_[track] + 1) % TrackedObjectHistoryLength;
+	}
+}
+
+bool TrackedObjectList::tooManyMissedFrames(size_t track) const
+{
+	// Hard limit on the number of consecutive missed
+	// frames before dropping a track
+	if (missedFrameCount_[track] > missedFrameCountMax)
+		return true;
+
+	// Be more aggressive about dropping tracks which
+	// haven't been around long - kill them off if 
+	// they are seen in less than 33% of frames
+	const size_t historySize = detectHistorySize_[track];
+	if (historySize <= 10)
+	{
+		const size_t detectCount = bitset<32>(detectHistory_[track]).count();
+		if (((double)detectCount / historySize) <= 0.34)
+			return true;
+	}
+	return false;
+}
+
+// Return the percent of last TrackedObjectHistoryLength frames
+// the object was seen. See TrackedObject::getDetectedRatio
+double TrackedObjectList::getDetectedRatio(size_t track) const
+{
+	const size_t historySize = detectHistorySize_[track];
+	const size_t capacity    = TrackedObjectHistoryLength;
+
+	// Need at least 2 frames to believe there's something real
+	if (historySize <= 1)
+		return 0.01;
+
+	// Don't display stuff which hasn't been detected recently.
+	if (missedFrameCount_[track] >= 3)
+		return 0.01;
+
+	const size_t detectCount = bitset<32>(detectHistory_[track]).count();
+
+	// For newly added tracks make sure only 1 frame is missed at most
+	// while the first quarter of the buffer is filled and at most
+	// two are missed while filling up to half the size of the buffer
+	if (historySize < (capacity/2))
+	{
+		if (detectCount < (historySize - 2))
+			return 0.01;
+		if ((historySize <= (capacity/4)) && (detectCount < (historySize - 1)))
+			return 0.01;
+
+		// Ramp up from minDisplayRatio so that at 10 hits it will
+		// end up at endRatio = 10/20 = 50% or 9/20 = 45%
+		double endRatio =  (capacity / 2.0 - (historySize - detectCount)) / capacity;
+		return minDisplayRatio + (historySize - 2.0) * (endRatio - minDisplayRatio) / (capacity / 2.0 - 2.0);
+	}
+	double detectRatio = (double)detectCount / capacity;
+	return detectRatio;
+}
+
+Rect TrackedObjectList::getScreenPosition(size_t track) const
+{
+	return camera_.worldToScreen(position_[track], types_[typeIdx_[track]]);
+}
+
 #if 0
 // Adjust position for camera motion between frames using fovis
 void TrackedObjectList::adjustLocation(const Eigen::Transform<double, 3, Eigen::Isometry> &delta_robot)
@@ -367,37 +441,54 @@ void TrackedObjectList::adjustLocation(const Eigen::Transform<double, 3, Eigen::
 }
 #endif
 // Adjust position for camera motion between frames using optical flow
+// The Kalman filter state is left alone - TKalmanFilter::adjustPrediction
+// only ever changed statePre, which the next predict() overwrote from
+// statePost, so it never had any effect
 void TrackedObjectList::adjustLocation(const Mat &transform_mat)
 {
-	for (auto it = list_.begin(); it != list_.end(); ++it)
+	if (!camera_.setScreenTransform(transform_mat))
+		return;
+	for (size_t t = 0; t < position_.size(); t++)
 	{
-		//measure the amount that the position changed and apply the same change to the kalman filter
-		Point3f old_pos = it->getPosition();
+		const ObjectType &type = types_[typeIdx_[t]];
+		const Point3f &pos = position_[t];
 		//compute r and use it for depth (assume depth doesn't change)
-		float r = sqrt(it->getPosition().x * it->getPosition().x + it->getPosition().y * it->getPosition().y + it->getPosition().z * it->getPosition().z);
-		it->adjustPosition(transform_mat, r, fovSize_, imageSize_);
-		Point3f delta_pos = it->getPosition() - old_pos;
+		const float r = sqrt(pos.x * pos.x + pos.y * pos.y + pos.z * pos.z);
+
+		camera_.adjust(&position_[t], 1, type, r);
+		pushPosition(t, position_[t]);
 
-		it->adjustKF(delta_pos);
+		//update the history. The ring buffer only wraps once it
+		//is full, so valid entries are always the first
+		//positionHistorySize_ slots
+		camera_.adjust(&positionHistory_[t * TrackedObjectHistoryLength], positionHistorySize_[t], type, r);
 	}
 }
 
 // Get position history for each tracked object
 vector<vector<Point>> TrackedObjectList::getScreenPositionHistories(void) const
 {
-	vector<vector<Point>> ret;
-	for (auto it = list_.begin(); it != list_.end(); ++it)
-		ret.push_back(it->getScreenPositionHistory(fovSize_, imageSize_));
+	vector<vector<Point>> ret(position_.size());
+	for (size_t t = 0; t < position_.size(); t++)
+	{
+		const ObjectType &type = types_[typeIdx_[t]];
+		const Point3f *history = &positionHistory_[t * TrackedObjectHistoryLength];
+		for (size_t i = 0; i < positionHistorySize_[t]; i++)
+		{
+			Rect screen_rect(camera_.worldToScreen(history[(positionHistoryStart_[t] + i) % TrackedObjectHistoryLength], type));
+			ret[t].push_back(Point(cvRound(screen_rect.x + screen_rect.width / 2.),cvRound( screen_rect.y + screen_rect.height / 2.)));
+		}
+	}
 	return ret;
 }
 
 // Simple printout of list into stdout
 void TrackedObjectList::print(void) const
 {
-	for (auto it = list_.cbegin(); it != list_.cend(); ++it)
+	for (size_t t = 0; t < position_.size(); t++)
 	{
-		cout << it->getId() << " location ";
-		Point3f position = it->getPosition();
+		cout << id_[t] << " location ";
+		const Point3f &position = position_[t];
 		cout << "(" << position.x << "," << position.y << "," << position.z << ")" << endl;
 	}
 }
@@ -407,18 +498,68 @@ void TrackedObjectList::getDisplay(vector<TrackedObjectDisplay> &displayList) co
 {
 	displayList.clear();
 	TrackedObjectDisplay tod;
-	for (auto it = list_.cbegin(); it != list_.cend(); ++it)
+	for (size_t t = 0; t < position_.size(); t++)
 	{
-		tod.position = it->getPosition();
-		tod.rect     = it->getScreenPosition(fovSize_, imageSize_);
-		tod.id       = it->getId();
-		tod.ratio    = it->getDetectedRatio();
+		tod.position = position_[t];
+		tod.rect     = getScreenPosition(t);
+		tod.id       = id_[t];
+		tod.ratio    = getDetectedRatio(t);
 		displayList.push_back(tod);
 	}
 }
 
-const double dist_thresh_ = 1.0; // FIX ME!
-//#define VERBOSE_TRACK
+// Find the track / detection pairs close enough to possibly
+// match. Detections are bucketed into grid cells, then each
+// track only looks at detections in neighboring cells.  Fills
+// edges_ with the cost (distance) of each such pair
+void TrackedObjectList::gate(void)
+{
+	detectedCells_.clear();
+	for (size_t d = 0; d < detectedPositions_.size(); d++)
+	{
+		const Point3f &pt = detectedPositions_[d];
+		if (!isFinite(pt))
+			continue;
+		detectedCells_.push_back(make_pair(
+					cellKey(detectedTypes_[d], cellCoord(pt.x), cellCoord(pt.y), cellCoord(pt.z)), (int)d));
+	}
+	sort(detectedCells_.begin(), detectedCells_.end());
+
+	edges_.clear();
+	for (size_t t = 0; t < position_.size(); t++)
+	{
+		const Point3f &pos = position_[t];
+		if (!isFinite(pos))
+			continue;
+		const int cx = cellCoord(pos.x);
+		const int cy = cellCoord(pos.y);
+		const int cz = cellCoord(pos.z);
+		for (int dx = -1; dx <= 1; dx++)
+		{
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dz = -1; dz <= 1; dz++)
+				{
+					const uint64_t key = cellKey(typeIdx_[t], cx + dx, cy + dy, cz + dz);
+					for (auto it = lower_bound(detectedCells_.cbegin(), detectedCells_.cend(), make_pair(key, -1));
+						 (it != detectedCells_.cend()) && (it->first == key); ++it)
+					{
+						const Point3f diff = pos - detectedPositions_[it->second];
+						const double cost = sqrtf(diff.x * diff.x + diff.y * diff.y + diff.z * diff.z);
+						if (cost <= dist_thresh_)
+						{
+							AssignmentEdge edge;
+							edge.row  = t;
+							edge.col  = it->second;
+							edge.cost = cost;
+							edges_.push_back(edge);
+						}
+					}
+				}
+			}
+		}
+	}
+}
 
 // Process a set of detected rectangles
 // Each will either match a previously detected object or
@@ -427,151 +568,110 @@ void TrackedObjectList::processDetect(const vector<Rect> &detectedRects,
 									  const vector<float> &depths,
 									  const vector<ObjectType> &types)
 {
-	vector<Point3f> detectedPositions;
 #ifdef VERBOSE_TRACK
-	if (detectedRects.size() || list_.size())
+	if (detectedRects.size() || position_.size())
 		cout << "---------- Start of process detect --------------" << endl;
 	print();
 	if (detectedRects.size() > 0)
 		cout << detectedRects.size() << " detected objects" << endl;
 #endif
+	detectedPositions_.clear();
+	detectedTypes_.clear();
 	for (size_t i = 0; i < detectedRects.size(); i++)
 	{
-		detectedPositions.push_back(
-				screenToWorldCoords(detectedRects[i], depths[i], fovSize_, imageSize_, cameraElevation_));
+		detectedPositions_.push_back(
+				camera_.screenToWorld(detectedRects[i], depths[i]));
+		detectedTypes_.push_back(typeIndex(types[i]));
 #ifdef VERBOSE_TRACK
-		cout << "Detected rect [" << i << "] = " << detectedRects[i] << " positions[" << detectedPositions.size() - 1 << "]:" << detectedPositions[detectedPositions.size()-1] << endl;
+		cout << "Detected rect [" << i << "] = " << detectedRects[i] << " positions[" << detectedPositions_.size() - 1 << "]:" << detectedPositions_[detectedPositions_.size()-1] << endl;
 #endif
 	}
 	// TODO :: Combine overlapping detections into one?
 
 	// Maps tracks to the closest new detected object.
-	// assignment[track] = index of closest detection
-	vector<int> assignment;
-	if (list_.size())
+	// assignment_[track] = index of closest detection
+	// Only pairs within dist_thresh_ of each other and with
+	// matching types are considered
+	const size_t tracks = position_.size(); // number of tracked objects from prev frames
+	assignment_.assign(tracks, -1);
+	if (tracks)
 	{
-		size_t tracks = list_.size();		          // number of tracked objects from prev frames
-		size_t detections = detectedPositions.size(); // number of detections this frame
-
-		//Cost[t][d] is the distance between old tracked location t
-		//and newly detected object d's position 
-		vector< vector<double> > Cost(tracks,vector<double>(detections));
-
-		// Calculate cost for each track->pair combo
-		// The cost here is just the distance between them
-		// Also check to see if the types are the same, if they are not then set the cost extremely high so that it's never matched
-		auto it = list_.cbegin();
-		for(size_t t = 0; t < tracks;  ++t, ++it)
-		{
-			// Point3f prediction=tracks[t]->prediction;
-			// cout << prediction << endl;
-			for(size_t d = 0; d < detections; d++)
-			{
-				const ObjectType it_type = it->getType();
-				if(types[d] == it_type) {
-					Point3f diff = it->getPosition() - detectedPositions[d];
-					Cost[t][d] = sqrtf(diff.x * diff.x + diff.y * diff.y + diff.z * diff.z);
-				} else {
-					Cost[t][d] = numeric_limits<double>::max();
-				}
-			}
-		}
-
-		// Solving assignment problem (find minimum-cost assignment
-		// between tracks and previously-predicted positions)
-		AssignmentProblemSolver APS;
-		APS.Solve(Cost, assignment, AssignmentProblemSolver::optimal);
+		gate();
+		assigner_.Solve(tracks, detectedPositions_.size(), edges_, assignment_);
 
 #ifdef VERBOSE_TRACK
-		// assignment[i] holds the index of the detection assigned
-		// to track i.  assignment[i] is -1 if no detection was
+		// assignment_[i] holds the index of the detection assigned
+		// to track i.  assignment_[i] is -1 if no detection was
 		// matchedto that particular track
-		cout << "After APS : "<<endl;
-		for(size_t i = 0; i < assignment.size(); i++)
-			cout << i << ":" << assignment[i] << endl;
+		cout << "After assignment : "<<endl;
+		for(size_t i = 0; i < assignment_.size(); i++)
+			cout << i << ":" << assignment_[i] << endl;
 #endif
-		// clear assignment from pairs with large distance
-		for(size_t i = 0; i < assignment.size(); i++)
-			if ((assignment[i] != -1) && (Cost[i][assignment[i]] > dist_thresh_))
-				assignment[i] = -1;
 	}
 
 	// Search for unassigned detects and start new tracks for them.
 	// This will also handle the case where no tracks are present,
-	// since assignment will be empty in that case - everything gets added
-	for(size_t i = 0; i < detectedPositions.size(); i++)
+	// since assignment_ will be empty in that case - everything gets added
+	detectionAssigned_.assign(detectedPositions_.size(), 0);
+	for (size_t t = 0; t < tracks; t++)
+		if (assignment_[t] != -1)
+			detectionAssigned_[assignment_[t]] = 1;
+	for(size_t i = 0; i < detectedPositions_.size(); i++)
 	{
-		if (find(assignment.begin(), assignment.end(), i) == assignment.end())
+		if (!detectionAssigned_[i])
 		{
 #ifdef VERBOSE_TRACK
 			cout << "New assignment created " << i << endl;
 #endif
-			list_.push_back(TrackedObject(detectCount_++, types[i], detectedRects[i], depths[i], fovSize_, imageSize_, cameraElevation_));
-
-#ifdef VERBOSE_TRACK
-			cout << "New assignment finished" << endl;
-#endif
+			addTrack(detectedTypes_[i], detectedPositions_[i]);
 		}
 	}
 
-	auto tr = list_.begin();
-	auto as = assignment.begin();
-	while ((tr != list_.end()) && (as != assignment.end()))
+	// Predict and update the filters for all of the tracks from
+	// previous frames at once. Tracks with an assigned detect are
+	// updated using its coordinates, otherwise continue using
+	// predictions. Tracks just added above are left alone
+	predictions_.resize(tracks);
+	measurements_.resize(tracks);
+	KF_.predict(tracks, predictions_.data());
+	for (size_t t = 0; t < tracks; t++)
+		measurements_[t] = (assignment_[t] != -1) ? detectedPositions_[assignment_[t]] : predictions_[t];
+	KF_.update(tracks, measurements_.data(), predictions_.data());
+	for (size_t t = 0; t < tracks; t++)
 	{
-		// If track updated less than one time, than filter state is not correct.
-#ifdef VERBOSE_TRACK
-		cout << "Predict: " << endl;
-#endif
-		Point3f prediction = tr->predictKF();
-#ifdef VERBOSE_TRACK
-		cout << "prediction:" << prediction << endl;
-#endif
-
-		if(*as != -1) // If we have assigned detect, then update using its coordinates
-		{
-#ifdef VERBOSE_TRACK
-			cout << "Update match: " << endl;
-#endif
-			tr->setPosition(tr->updateKF(detectedPositions[*as]));
-#ifdef VERBOSE_TRACK
-			cout << tr->getScreenPosition(fovSize_, imageSize_) << endl;
-#endif
-			tr->setDetected();
-		}
-		else          // if not continue using predictions
-		{
-#ifdef VERBOSE_TRACK
-			cout << "Update no match: " << endl;
-#endif
-			tr->setPosition(tr->updateKF(prediction));
-#ifdef VERBOSE_TRACK
-			cout << tr->getScreenPosition(fovSize_, imageSize_) << endl;
-#endif
-			tr->clearDetected();
-		}
-
-		++tr;
-		++as;
+		position_[t] = predictions_[t];
+		pushPosition(t, position_[t]);
+		pushDetected(t, assignment_[t] != -1);
 	}
 
 	// Remove tracks which haven't been seen in a while
-	for (auto it = list_.begin(); it != list_.end(); )
+	keep_.resize(position_.size());
+	bool dropping = false;
+	for (size_t t = 0; t < position_.size(); t++)
 	{
-		if (it->tooManyMissedFrames()) // For now just remove ones for
-		{                              // which detectList is empty
+		keep_[t] = !tooManyMissedFrames(t);
+		dropping |= !keep_[t];
 #ifdef VERBOSE_TRACK
-			cout << "Dropping " << it->getId() << endl;
+		if (!keep_[t])
+			cout << "Dropping " << id_[t] << endl;
 #endif
-			it = list_.erase(it);
-		}
-		else
-		{
-			++it;
-		}
+	}
+	if (dropping)
+	{
+		compactTracks(position_, keep_);
+		compactTracks(typeIdx_, keep_);
+		compactTracks(id_, keep_);
+		compactTracks(missedFrameCount_, keep_);
+		compactTracks(detectHistory_, keep_);
+		compactTracks(detectHistorySize_, keep_);
+		compactTracks(positionHistory_, keep_, TrackedObjectHistoryLength);
+		compactTracks(positionHistoryStart_, keep_);
+		compactTracks(positionHistorySize_, keep_);
+		KF_.compact(keep_);
 	}
 #ifdef VERBOSE_TRACK
 	print();
-	if (detectedRects.size() || list_.size())
+	if (detectedRects.size() || position_.size())
 		cout << "---------- End of process detect --------------" << endl;
 #endif
 }
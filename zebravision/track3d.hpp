@@ -2,9 +2,11 @@
 #include <algorithm>
 #include <string>
 #include <vector>
-#include <list>
+#include <cstdint>
 //#include <Eigen/Geometry>
 #include <boost/circular_buffer.hpp>
+#include "assignment.hpp"
+#include "cameratransform.hpp"
 #include "kalman.hpp"
 #include "objtype.hpp"
 
@@ -61,9 +63,9 @@ class TrackedObject
 		void setPosition(const cv::Rect &screen_position, double avg_depth, const cv::Point2f &fov_size, const cv::Size &frame_size);
 
 		// Adjust tracked object position based on motion
-		// of the camera
+		// of the camera. Tracks are adjusted in bulk by
+		// TrackedObjectList::adjustLocation instead
 		//void adjustPosition(const Eigen::Transform<double, 3, Eigen::Isometry> &delta_robot);
-		void adjustPosition(const cv::Mat &transform_mat, float depth, const cv::Point2f &fov_size, const cv::Size &frame_size);
 
 		//get position of a rect on the screen corresponding to the object size and location
 		//inverse of setPosition(Rect,depth)
@@ -159,13 +161,55 @@ class TrackedObjectList
 						   const std::vector<float> &depths,
 						   const std::vector<ObjectType> &types);
 
+		// Pick the algorithm used to match detections to tracks
+		void setAssignmentMethod(SparseAssignmentSolver::TMethod method) { assigner_.setMethod(method); }
+
 	private :
-		std::list<TrackedObject> list_; // list of currently valid detected objects
+		// Track store.  Each array has one entry per track (or
+		// TrackedObjectHistoryLength entries per track for the
+		// position history), all in track creation order. Dropping
+		// tracks compacts every array with the same keep mask
+		std::vector<cv::Point3f> position_;         // last position of each track
+		std::vector<size_t>      typeIdx_;          // index into types_
+		std::vector<std::string> id_;
+		std::vector<int>         missedFrameCount_;
+		std::vector<uint32_t>    detectHistory_;    // bit 0 = most recent frame
+		std::vector<uint8_t>     detectHistorySize_;
+		std::vector<cv::Point3f> positionHistory_;  // ring buffer per track
+		std::vector<uint8_t>     positionHistoryStart_;
+		std::vector<uint8_t>     positionHistorySize_;
+		TKalmanFilterBank        KF_;
+
+		// Distinct object types seen so far. Tracks and detections
+		// refer to these by index so type checks are int compares
+		std::vector<ObjectType>  types_;
+
 		int detectCount_;               // ID of next object to be created
 
-		//values stay constant throughout the run but are needed for computing stuff
-		cv::Size    imageSize_;
-		cv::Point2f fovSize_;
-		float       cameraElevation_;
+		// Screen <-> world conversions for this camera
+		CameraTransform camera_;
+
+		// Matches tracks (rows) to detections (columns)
+		SparseAssignmentSolver assigner_;
+
+		// Per-frame scratch space, kept around so processDetect
+		// doesn't reallocate every frame
+		std::vector<cv::Point3f>                  detectedPositions_;
+		std::vector<size_t>                       detectedTypes_;
+		std::vector<std::pair<uint64_t, int> >    detectedCells_;
+		std::vector<AssignmentEdge>               edges_;
+		std::vector<int>                          assignment_;
+		std::vector<unsigned char>                detectionAssigned_;
+		std::vector<cv::Point3f>                  predictions_;
+		std::vector<cv::Point3f>                  measurements_;
+		std::vector<unsigned char>                keep_;
+
+		size_t addTrack(size_t typeIdx, const cv::Point3f &position);
+		size_t typeIndex(const ObjectType &type);
+		void   pushDetected(size_t track, bool detected);
+		void   pushPosition(size_t track, const cv::Point3f &pt);
+		double getDetectedRatio(size_t track) const;
+		bool   tooManyMissedFrames(size_t track) const;
+		cv::Rect getScreenPosition(size_t track) const;
+		void   gate(void);
 };
-
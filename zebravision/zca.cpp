@@ -52,6 +52,8 @@
 #include <string>
 #ifdef USE_MKL
 #include <mkl.h>
+#else
+#include <Eigen/Core>
 #endif
 #include "cuda_utils.hpp"
 #include "zca.hpp"
@@ -255,60 +257,103 @@ Mat ZCA::Transform32FC3(const Mat &input)
 	return outputs[0].clone();
 }
 
+// Resize the input if needed, then apply global contrast
+// normalization - subtract the mean and divide by the standard
+// deviation separately for each channel. That way each image is
+// normalized to 0-mean and a standard deviation of 1 before
+// running it through ZCA weights.
+// Results are written straight into dest as one row of
+// interleaved B,G,R values, ready for the gemm
+void ZCA::NormalizeInto(const Mat &input, float *dest)
+{
+	const Mat *img = &input;
+	if (input.size() != size_)
+	{
+		resize(input, resizeBuf_, size_);
+		img = &resizeBuf_;
+	}
+
+	const int rows = img->rows;
+	const int cols = img->cols;
+
+	// First pass - per-channel sums to get mean and stddev.
+	// Same math as meanStdDev, just without the overhead
+	double sum[3]   = {0., 0., 0.};
+	double sumSq[3] = {0., 0., 0.};
+	for (int r = 0; r < rows; r++)
+	{
+		const float *p = img->ptr<float>(r);
+		for (int c = 0; c < cols * 3; c += 3)
+		{
+			for (int ch = 0; ch < 3; ch++)
+			{
+				const double v = p[c + ch];
+				sum[ch]   += v;
+				sumSq[ch] += v * v;
+			}
+		}
+	}
+
+	// If GCN is disabled, just scale the values into
+	// a range from 0-1.  
+	const double count = rows * cols;
+	float mean[3];
+	float scale[3];
+	for (int ch = 0; ch < 3; ch++)
+	{
+		const double m = sum[ch] / count;
+		mean[ch] = m;
+		if (globalContrastNorm_)
+			scale[ch] = 1.0 / sqrt(max(sumSq[ch] / count - m * m, 0.));
+		else
+			scale[ch] = 1.0 / 255.;
+	}
+
+	// Second pass - write normalized values
+	for (int r = 0; r < rows; r++)
+	{
+		const float *p = img->ptr<float>(r);
+		float *d = dest + r * cols * 3;
+		for (int c = 0; c < cols * 3; c += 3)
+		{
+			d[c + 0] = (p[c + 0] - mean[0]) * scale[0];
+			d[c + 1] = (p[c + 1] - mean[1]) * scale[1];
+			d[c + 2] = (p[c + 2] - mean[2]) * scale[2];
+		}
+	}
+}
+
 // Transform a vector of input images in floating
 // point format using the weights loaded
 // when this object was initialized
 vector<Mat> ZCA::Transform32FC3(const vector<Mat> &input)
 {
+	if (input.empty())
+		return vector<Mat>();
 #ifdef DEBUG_TIME
 	double start = gtod_wrapper();
 #endif
-	Mat output;
-	Mat work;
-	// Create a large mat holding all of the pixels
-	// from all of the input images.
+	// Fill batch_ with all of the pixels from all
+	// of the input images.
 	// Each row is data from one image. Each image
 	// is flattened to 1 channel of interlaved B,G,R
-	// values.  
-	// Global contrast normalization is applied to
-	// each image - subtract the mean and divide
-	// by the standard deviation separately for each
-	// channel. That way each image is normalized to 0-mean 
-	// and a standard deviation of 1 before running it
-	// through ZCA weights.
-	for (auto it = input.cbegin(); it != input.cend(); ++it)
+	// values.  Normalization is done on the fly
+	// as each image is copied in so there are no
+	// intermediate Mats
+	const int rowSize = size_.area() * 3;
+	const int stride  = (rowSize + 15) & ~15;
+	if ((batch_.rows < (int)input.size()) || (batch_.cols != stride))
 	{
-		if (it->size() != size_)
-			resize(*it, output, size_);
-		else 
-			// need clone so mat is contiguous - 
-			// reshape won't work otherwise
-			output = it->clone();
-
-		Scalar mean;
-		Scalar stddev;
-		meanStdDev(output, mean, stddev);
-
-		// If GCN is disabled, just scale the values into
-		// a range from 0-1.  
-		if (!globalContrastNorm_)
-			stddev = Scalar(255., 255., 255., 255.);
-
-		for (int r = 0; r < output.rows; r++)
-		{
-			Vec3f *p = output.ptr<Vec3f>(r);
-			for (int c = 0; c < output.cols; c++)
-			{
-				p[c][0] = (p[c][0] - mean[0]) / stddev[0];
-				p[c][1] = (p[c][1] - mean[1]) / stddev[1];
-				p[c][2] = (p[c][2] - mean[2]) / stddev[2];
-			}
-		}
-
-		// Reshape flattens the image to 1 channel, 1 row.
-		// Push that row into the bottom of work
-		work.push_back(output.reshape(1,1));
+		// Over-allocate by a cache line so the first row
+		// can be moved up to a 64 byte boundary. With the
+		// stride a multiple of 16 floats, every other row
+		// then lands on one too
+		const int rows = max<int>(input.size(), batch_.rows);
+		batchBuf_.create(1, rows * stride + 16, CV_32FC1);
+		batch_ = Mat(rows, stride, CV_32FC1, alignPtr(batchBuf_.ptr<float>(), 64));
 	}
+	for (size_t i = 0; i < input.size(); i++)
+		NormalizeInto(input[i], batch_.ptr<float>(i));
 #ifdef DEBUG_TIME
 	double end = gtod_wrapper();
 	cout << "create work " << end - start << endl;
@@ -318,38 +363,32 @@ vector<Mat> ZCA::Transform32FC3(const vector<Mat> &input)
 	// Apply ZCA transform matrix
 	// Math here is weights * images = output images
 	// This works if each image is a column of data
-	// The natural way to add data above using push_back
-	//  creates a transpose of that instead (i.e. each image is its
+	// The natural way to store the data above
+	//  is a transpose of that instead (i.e. each image is its
 	//  own row rather than its own column).  Take advantage
 	//  of the identiy (AB)^T = B^T A^T.  A=weights, B=images
 	// Since we want to pull images apart in the same transposed
 	// order, this saves a few transposes and gives a
 	// slight performance bump.
-
-	// GPU is faster so use it if it exists.
-#if 0
-	if (!weightsGPU_.empty())
-	{
-		gm_.upload(work);
-		gemm(gm_, weightsGPU_, 1.0, buf_, 0.0, gmOut_);
-
-		gmOut_.download(output);
-	}
-	else if (!weights_.empty())
-#endif
-	{
+	// This gets a new Mat each call since the images
+	// returned point into it
+	const size_t m = input.size();
+	const size_t n = weights_.cols;
+	const size_t k = weights_.rows;
+	Mat output(m, n, CV_32FC1);
 #ifdef USE_MKL
-		const size_t m = work.rows;
-		const size_t n = weights_.rows;
-		const size_t k = weights_.cols;
-
-		output = Mat(work.rows, work.cols, CV_32FC1);
-		cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, 
-                m, n, k, 1.0, (const float *)work.data, k, (const float *)weights_.data, n, 0.0, (float *)output.data, n);
+	cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, 
+			m, n, k, 1.0, batch_.ptr<float>(), stride, weights_.ptr<float>(), weights_.step1(), 0.0, output.ptr<float>(), n);
 #else
-		gemm(work, weights_, 1.0, Mat(), 0.0, output);
+	// Eigen's gemm is cache blocked and vectorized - much
+	// quicker than OpenCV's for these sizes
+	typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMatrixXf;
+	typedef Eigen::Map<const RowMatrixXf, Eigen::Unaligned, Eigen::OuterStride<> > ConstStridedMap;
+	ConstStridedMap work(batch_.ptr<float>(), m, k, Eigen::OuterStride<>(stride));
+	ConstStridedMap weights(weights_.ptr<float>(), k, n, Eigen::OuterStride<>(weights_.step1()));
+	Eigen::Map<RowMatrixXf> out(output.ptr<float>(), m, n);
+	out.noalias() = work * weights;
 #endif
-	}
 
 #ifdef DEBUG_TIME
 	end = gtod_wrapper();
@@ -369,7 +408,7 @@ vector<Mat> ZCA::Transform32FC3(const vector<Mat> &input)
 	for (int i = 0; i < output.rows; i++)
 	{
 		// Turn each row back into a 2-d mat with 3 float color channels
-		ret.push_back(output.row(i).reshape(input[i].channels(), size_.height));
+		ret.push_back(output.row(i).reshape(3, size_.height));
 	}
 
 #ifdef DEBUG_TIME
@@ -48,6 +48,11 @@ class ZCA
 		cv::Size size(void) const;
 
 	private:
+		// Resize if needed, apply global contrast normalization
+		// and write the result as a flattened row of
+		// interleaved B,G,R floats starting at dest
+		void NormalizeInto(const cv::Mat &input, float *dest);
+
 		cv::Size size_;
 
 		// The weights, stored in both
@@ -62,6 +67,17 @@ class ZCA
 
 		PtrStepSz<float> *dPssIn_;
 
+		// CPU buffers, reused between calls. batch_ holds
+		// one normalized image per row, with rows padded
+		// out to a multiple of 16 floats so each one
+		// starts on a cache line.  It is a view into
+		// batchBuf_, offset so the first row is 64 byte
+		// aligned.  resizeBuf_ is used for inputs which
+		// aren't already size_
+		cv::Mat  batch_;
+		cv::Mat  batchBuf_;
+		cv::Mat  resizeBuf_;
+
 		float            epsilon_;
 		double           overallMin_;
 		double           overallMax_;
@@ -0,0 +1,355 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <zlib.h>
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "zmsformat.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Fixed-width little endian helpers. Used instead of
+// writing structs directly so the layout doesn't depend
+// on compiler padding or the size of size_t
+static void putU32(char *buf, uint32_t val)
+{
+	for (int i = 0; i < 4; i++)
+		buf[i] = (char)((val >> (8 * i)) & 0xff);
+}
+
+static uint32_t getU32(const char *buf)
+{
+	uint32_t val = 0;
+	for (int i = 0; i < 4; i++)
+		val |= (uint32_t)(unsigned char)buf[i] << (8 * i);
+	return val;
+}
+
+void zmsPutU64(char *buf, uint64_t val)
+{
+	for (int i = 0; i < 8; i++)
+		buf[i] = (char)((val >> (8 * i)) & 0xff);
+}
+
+uint64_t zmsGetU64(const char *buf)
+{
+	uint64_t val = 0;
+	for (int i = 0; i < 8; i++)
+		val |= (uint64_t)(unsigned char)buf[i] << (8 * i);
+	return val;
+}
+
+size_t zmsAlign(size_t size)
+{
+	return (size + ZMS_ALIGN - 1) & ~(ZMS_ALIGN - 1);
+}
+
+void zmsEncodeFileHeader(const ZMSFileHeader &header, char *buf)
+{
+	memset(buf, 0, ZMS_FILE_HEADER_SIZE);
+	memcpy(buf, ZMS_FILE_MAGIC, 4);
+	putU32(buf + 4, header.version);
+	putU32(buf + 8, header.codec);
+}
+
+bool zmsDecodeFileHeader(const char *buf, ZMSFileHeader &header)
+{
+	if (memcmp(buf, ZMS_FILE_MAGIC, 4))
+		return false;
+	header.version = getU32(buf + 4);
+	header.codec   = getU32(buf + 8);
+	return true;
+}
+
+void zmsEncodeChunkHeader(const ZMSChunkHeader &header, char *buf)
+{
+	memset(buf, 0, ZMS_CHUNK_HEADER_SIZE);
+	memcpy(buf, ZMS_CHUNK_MAGIC, 4);
+	putU32(buf + 4, header.codec);
+	zmsPutU64(buf + 8, header.rawSize);
+	zmsPutU64(buf + 16, header.storedSize);
+}
+
+bool zmsDecodeChunkHeader(const char *buf, ZMSChunkHeader &header)
+{
+	if (memcmp(buf, ZMS_CHUNK_MAGIC, 4))
+		return false;
+	header.codec      = getU32(buf + 4);
+	header.rawSize    = zmsGetU64(buf + 8);
+	header.storedSize = zmsGetU64(buf + 16);
+	return true;
+}
+
+void zmsEncodeFooter(const ZMSFooter &footer, char *buf)
+{
+	memset(buf, 0, ZMS_FOOTER_SIZE);
+	zmsPutU64(buf, footer.indexOffset);
+	zmsPutU64(buf + 8, footer.frameCount);
+	memcpy(buf + 16, ZMS_FOOTER_MAGIC, 4);
+	putU32(buf + 20, ZMS_VERSION);
+}
+
+bool zmsDecodeFooter(const char *buf, ZMSFooter &footer)
+{
+	if (memcmp(buf + 16, ZMS_FOOTER_MAGIC, 4))
+		return false;
+	footer.indexOffset = zmsGetU64(buf);
+	footer.frameCount  = zmsGetU64(buf + 8);
+	return true;
+}
+
+// Bytes needed to store a single Mat, including
+// its header and padding
+static size_t packedMatSize(const Mat &mat)
+{
+	return ZMS_MAT_HEADER_SIZE + zmsAlign(mat.total() * mat.elemSize());
+}
+
+static char *packMat(const Mat &mat, char *buf)
+{
+	memset(buf, 0, ZMS_MAT_HEADER_SIZE);
+	putU32(buf,     mat.rows);
+	putU32(buf + 4, mat.cols);
+	putU32(buf + 8, mat.type());
+	buf += ZMS_MAT_HEADER_SIZE;
+
+	// Copy row by row in case the Mat is
+	// a sub-image rather than continuous
+	const size_t rowSize = mat.cols * mat.elemSize();
+	for (int r = 0; r < mat.rows; r++)
+	{
+		memcpy(buf, mat.ptr(r), rowSize);
+		buf += rowSize;
+	}
+	const size_t dataSize = rowSize * mat.rows;
+	memset(buf, 0, zmsAlign(dataSize) - dataSize);
+	return buf + zmsAlign(dataSize) - dataSize;
+}
+
+// The header comes straight from the file, so check
+// it describes a Mat which fits in what's left of the
+// chunk before building anything on top of it
+static const char *unpackMat(const char *buf, const char *end, Mat &mat, bool copy)
+{
+	if ((end - buf) < (ptrdiff_t)ZMS_MAT_HEADER_SIZE)
+		return NULL;
+	const int rows = getU32(buf);
+	const int cols = getU32(buf + 4);
+	const int type = getU32(buf + 8);
+	buf += ZMS_MAT_HEADER_SIZE;
+
+	if ((rows < 0) || (cols < 0) ||
+		(type & ~CV_MAT_TYPE_MASK) || (CV_MAT_DEPTH(type) > CV_64F))
+	{
+		cerr << "zmsUnpackMats : bad Mat header " << rows << "x" << cols << " type " << type << endl;
+		return NULL;
+	}
+
+	// Reject sizes which would overflow size_t before
+	// checking the data - plus the padding written after
+	// every Mat - fits in what's left of the chunk
+	const size_t elemSize = CV_ELEM_SIZE(type);
+	if (cols && ((size_t)rows > SIZE_MAX / elemSize / cols))
+	{
+		cerr << "zmsUnpackMats : " << rows << "x" << cols << " Mat is too big" << endl;
+		return NULL;
+	}
+	const size_t dataSize = (size_t)rows * cols * elemSize;
+	if ((dataSize > (size_t)(end - buf)) || (zmsAlign(dataSize) > (size_t)(end - buf)))
+	{
+		cerr << "zmsUnpackMats : " << rows << "x" << cols << " Mat doesn't fit in chunk" << endl;
+		return NULL;
+	}
+
+	if ((rows == 0) || (cols == 0))
+		mat = Mat();
+	else if (copy)
+		Mat(rows, cols, type, const_cast<char *>(buf)).copyTo(mat);
+	else
+		mat = Mat(rows, cols, type, const_cast<char *>(buf));
+
+	return buf + zmsAlign(dataSize);
+}
+
+void zmsPackMats(const Mat &frame, const Mat &depth, vector<char> &buf)
+{
+	buf.resize(packedMatSize(frame) + packedMatSize(depth));
+	char *p = packMat(frame, &buf[0]);
+	packMat(depth, p);
+}
+
+bool zmsUnpackMats(const char *buf, size_t len, Mat &frame, Mat &depth, bool copy)
+{
+	const char *end = buf + len;
+	buf = unpackMat(buf, end, frame, copy);
+	if (!buf)
+		return false;
+	return unpackMat(buf, end, depth, copy) != NULL;
+}
+
+// zstd is used for archiving, so trade some speed
+// for a better compression ratio
+#ifdef USE_ZSTD
+static const int zstdLevel = 9;
+#endif
+
+bool zmsCodecFromName(const string &name, ZMSCodec &codec)
+{
+	if (name == "none")
+		codec = ZMS_CODEC_NONE;
+	else if (name == "zlib")
+		codec = ZMS_CODEC_ZLIB;
+	else if (name == "lz4")
+		codec = ZMS_CODEC_LZ4;
+	else if (name == "zstd")
+		codec = ZMS_CODEC_ZSTD;
+	else
+		return false;
+	return true;
+}
+
+const char *zmsCodecName(ZMSCodec codec)
+{
+	switch (codec)
+	{
+		case ZMS_CODEC_NONE: return "none";
+		case ZMS_CODEC_ZLIB: return "zlib";
+		case ZMS_CODEC_LZ4:  return "lz4";
+		case ZMS_CODEC_ZSTD: return "zstd";
+	}
+	return "unknown";
+}
+
+bool zmsCodecAvailable(ZMSCodec codec)
+{
+	switch (codec)
+	{
+		case ZMS_CODEC_NONE:
+		case ZMS_CODEC_ZLIB:
+			return true;
+		case ZMS_CODEC_LZ4:
+#ifdef USE_LZ4
+			return true;
+#else
+			return false;
+#endif
+		case ZMS_CODEC_ZSTD:
+#ifdef USE_ZSTD
+			return true;
+#else
+			return false;
+#endif
+	}
+	return false;
+}
+
+bool zmsCompress(ZMSCodec codec, const vector<char> &in, vector<char> &out)
+{
+	switch (codec)
+	{
+		case ZMS_CODEC_NONE:
+			out = in;
+			return true;
+
+		case ZMS_CODEC_ZLIB:
+		{
+			uLongf outLen = compressBound(in.size());
+			out.resize(outLen);
+			if (compress2((Bytef *)&out[0], &outLen,
+						(const Bytef *)&in[0], in.size(), Z_BEST_SPEED) != Z_OK)
+			{
+				cerr << "zmsCompress : zlib compress failed" << endl;
+				return false;
+			}
+			out.resize(outLen);
+			return true;
+		}
+
+#ifdef USE_LZ4
+		case ZMS_CODEC_LZ4:
+		{
+			out.resize(LZ4_compressBound(in.size()));
+			const int outLen = LZ4_compress_default(&in[0], &out[0], in.size(), out.size());
+			if (outLen <= 0)
+			{
+				cerr << "zmsCompress : LZ4 compress failed" << endl;
+				return false;
+			}
+			out.resize(outLen);
+			return true;
+		}
+#endif
+
+#ifdef USE_ZSTD
+		case ZMS_CODEC_ZSTD:
+		{
+			out.resize(ZSTD_compressBound(in.size()));
+			const size_t outLen = ZSTD_compress(&out[0], out.size(), &in[0], in.size(), zstdLevel);
+			if (ZSTD_isError(outLen))
+			{
+				cerr << "zmsCompress : zstd compress failed : " << ZSTD_getErrorName(outLen) << endl;
+				return false;
+			}
+			out.resize(outLen);
+			return true;
+		}
+#endif
+	}
+	cerr << "zmsCompress : unsupported codec " << zmsCodecName(codec) << endl;
+	return false;
+}
+
+bool zmsDecompress(ZMSCodec codec, const char *in, size_t inLen, char *out, size_t outLen)
+{
+	switch (codec)
+	{
+		case ZMS_CODEC_NONE:
+			if (inLen != outLen)
+				return false;
+			memcpy(out, in, outLen);
+			return true;
+
+		case ZMS_CODEC_ZLIB:
+		{
+			uLongf destLen = outLen;
+			if ((uncompress((Bytef *)out, &destLen, (const Bytef *)in, inLen) != Z_OK) ||
+				(destLen != outLen))
+			{
+				cerr << "zmsDecompress : zlib uncompress failed" << endl;
+				return false;
+			}
+			return true;
+		}
+
+#ifdef USE_LZ4
+		case ZMS_CODEC_LZ4:
+			if (LZ4_decompress_safe(in, out, inLen, outLen) != (int)outLen)
+			{
+				cerr << "zmsDecompress : LZ4 decompress failed" << endl;
+				return false;
+			}
+			return true;
+#endif
+
+#ifdef USE_ZSTD
+		case ZMS_CODEC_ZSTD:
+		{
+			const size_t destLen = ZSTD_decompress(out, outLen, in, inLen);
+			if (ZSTD_isError(destLen) || (destLen != outLen))
+			{
+				cerr << "zmsDecompress : zstd decompress failed" << endl;
+				return false;
+			}
+			return true;
+		}
+#endif
+	}
+	cerr << "zmsDecompress : unsupported codec " << zmsCodecName(codec) << endl;
+	return false;
+}
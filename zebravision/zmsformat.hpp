@@ -0,0 +1,122 @@
+// Layout of version 2 ZMS files.
+//
+// Version 1 files were a single zlib stream wrapped around
+// a boost archive of frame, depth, frame, depth, ...  That
+// works but the only way to get to frame N is to decompress
+// everything before it.  Version 2 instead stores each
+// frame + depth pair as an independently compressed chunk
+// and writes an index of chunk offsets at the end of the file :
+//
+//   file header   - magic "ZMS2", version, default codec
+//   chunk 0       - chunk header + compressed frame 0
+//   chunk 1       - chunk header + compressed frame 1
+//   ...
+//   index         - frameCount file offsets, one per chunk
+//   footer        - index offset, frame count, magic "ZMSI"
+//
+// Seeking to any frame is then a lookup in the index plus
+// a single read.  If a file wasn't closed cleanly (crash,
+// power loss) the footer is missing.  In that case readers
+// rebuild the index by hopping from chunk header to chunk
+// header, which only reads a few bytes per frame.
+//
+// All header fields are fixed width, little endian.  Pixel
+// data is stored as raw Mat data - fine since all the
+// platforms we run on are little endian.
+//
+// Headers and chunks are padded out to a multiple of 16 bytes
+// so uncompressed Mat data starts on an aligned boundary.
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+// How each chunk's payload is compressed.  LZ4 is fast enough
+// to keep up with live capture, zstd is slower but gives smaller
+// files for archiving.  Support for those two depends on the
+// libraries being found at build time (USE_LZ4 / USE_ZSTD).
+// Every chunk records the codec used so files can mix them
+enum ZMSCodec
+{
+	ZMS_CODEC_NONE = 0,
+	ZMS_CODEC_ZLIB = 1,
+	ZMS_CODEC_LZ4  = 2,
+	ZMS_CODEC_ZSTD = 3
+};
+
+const char     ZMS_FILE_MAGIC[4]   = {'Z', 'M', 'S', '2'};
+const char     ZMS_CHUNK_MAGIC[4]  = {'Z', 'M', 'S', 'C'};
+const char     ZMS_FOOTER_MAGIC[4] = {'Z', 'M', 'S', 'I'};
+const uint32_t ZMS_VERSION         = 2;
+
+const size_t ZMS_FILE_HEADER_SIZE  = 32;
+const size_t ZMS_CHUNK_HEADER_SIZE = 32;
+const size_t ZMS_FOOTER_SIZE       = 32;
+const size_t ZMS_MAT_HEADER_SIZE   = 16;
+const size_t ZMS_ALIGN             = 16;
+
+// Upper limit on a chunk's decompressed size - a 4096x4096
+// BGR frame plus float depth, well past anything the ZED
+// produces. Readers use it to reject corrupt chunk headers
+// before allocating a buffer for them
+const uint64_t ZMS_MAX_RAW_SIZE = 2 * ZMS_MAT_HEADER_SIZE + 4096 * 4096 * (3 + 4);
+
+struct ZMSFileHeader
+{
+	uint32_t version;
+	uint32_t codec;   // codec used for chunks by default
+};
+
+struct ZMSChunkHeader
+{
+	uint32_t codec;       // codec for this chunk's payload
+	uint64_t rawSize;     // size of payload once decompressed
+	uint64_t storedSize;  // size of payload in the file
+};
+
+struct ZMSFooter
+{
+	uint64_t indexOffset; // file offset of the chunk index
+	uint64_t frameCount;  // number of entries in the index
+};
+
+// Convert headers to and from their on-disk form. buf must
+// be the matching *_SIZE in bytes.  Decode returns false
+// if the magic number doesn't match
+void zmsEncodeFileHeader(const ZMSFileHeader &header, char *buf);
+bool zmsDecodeFileHeader(const char *buf, ZMSFileHeader &header);
+void zmsEncodeChunkHeader(const ZMSChunkHeader &header, char *buf);
+bool zmsDecodeChunkHeader(const char *buf, ZMSChunkHeader &header);
+void zmsEncodeFooter(const ZMSFooter &footer, char *buf);
+bool zmsDecodeFooter(const char *buf, ZMSFooter &footer);
+
+void     zmsPutU64(char *buf, uint64_t val);
+uint64_t zmsGetU64(const char *buf);
+
+// Round a size up to the next multiple of ZMS_ALIGN
+size_t zmsAlign(size_t size);
+
+// Pack frame and depth into a single uncompressed payload and
+// back.  Each Mat is written as rows, cols, type followed by its
+// pixels.  When copy is false, the Mats returned by unpack point
+// into buf rather than having their own copy of the data - the
+// caller has to keep buf around as long as the Mats are in use
+void zmsPackMats(const cv::Mat &frame, const cv::Mat &depth, std::vector<char> &buf);
+bool zmsUnpackMats(const char *buf, size_t len, cv::Mat &frame, cv::Mat &depth, bool copy = true);
+
+// Map between codecs and the names used on the command
+// line ("none", "zlib", "lz4", "zstd")
+bool        zmsCodecFromName(const std::string &name, ZMSCodec &codec);
+const char *zmsCodecName(ZMSCodec codec);
+
+// True if this build can read and write the codec
+bool zmsCodecAvailable(ZMSCodec codec);
+
+// Compress / decompress a chunk payload with the requested codec.
+// Decompress needs to be told the expected raw size, which is
+// stored in the chunk header, and fails if the actual size
+// doesn't match
+bool zmsCompress(ZMSCodec codec, const std::vector<char> &in, std::vector<char> &out);
+bool zmsDecompress(ZMSCodec codec, const char *in, size_t inLen, char *out, size_t outLen);
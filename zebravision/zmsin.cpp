@@ -6,6 +6,12 @@
 // but later versions were changed to be useable
 // on both ARM and x86.  Handle loading both types,
 // at least for the time being
+// Version 2 files (see zmsformat.hpp) compress each frame
+// separately and add an index so any frame can be read
+// without decoding the ones before it.  Those are checked
+// for first, falling back to the older formats if the
+// file doesn't start with the v2 header
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include "zmsin.hpp"
@@ -15,6 +21,7 @@
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "cvMatSerialize.hpp"
+#include "zmsformat.hpp"
 #include "ZvSettings.hpp"
 
 using namespace std;
@@ -26,14 +33,23 @@ ZMSIn::ZMSIn(const char *inFileName, ZvSettings *settings) :
 	serializeIn_(NULL),
 	filtSBIn_(NULL),
 	archiveIn_(NULL),
-	portableArchiveIn_(NULL)
+	portableArchiveIn_(NULL),
+	mappedIn_(NULL),
+	fileSize_(0),
+	indexed_(false),
+	nextFrame_(0)
 {
 	width_ = 0;
 	height_ = 0;
 	// Grab the first frame to figure out image size
 	cerr << "Loading " << inFileName << " for reading" << endl;
 	bool loaded = false;
-	if (openSerializeInput(inFileName, true) ||
+	if (openIndexedInput(inFileName))
+	{
+		Mat storage;
+		loaded = readIndexedFrame(0, frame_, depth_, storage);
+	}
+	else if (openSerializeInput(inFileName, true) ||
 		openSerializeInput(inFileName, false))
 	{
 		loaded = true;
@@ -57,11 +73,18 @@ ZMSIn::ZMSIn(const char *inFileName, ZvSettings *settings) :
 		return;
 	}
 
+	// The first frame is only needed for its size. For
+	// indexed files it points into storage, which is gone
 	width_  = frame_.cols;
 	height_ = frame_.rows;
+	frame_.release();
+	depth_.release();
 
 	// Reopen the file so callers can get the first frame
-	if (!openSerializeInput(inFileName, archiveIn_ == NULL))
+	// Indexed files can just go back to the first chunk
+	if (indexed_)
+		nextFrame_ = 0;
+	else if (!openSerializeInput(inFileName, archiveIn_ == NULL))
 	{
 		cerr << "Zed init : Could not reopen " << inFileName << " for reading" << endl;
 		return;
@@ -138,6 +161,236 @@ bool ZMSIn::openSerializeInput(const char *inFileName, bool portable)
 	return true;
 }
 
+// Check for a version 2 file. If the header matches, load
+// the chunk index from the end of the file. Returns false
+// for older files so the caller can try those formats instead
+// The file is memory mapped if possible. If not (e.g. running
+// out of address space on a 32-bit system) it is read
+// through an ifstream instead
+bool ZMSIn::openIndexedInput(const char *inFileName)
+{
+	deleteInputPointers();
+	try
+	{
+		mappedIn_ = new boost::iostreams::mapped_file_source(inFileName);
+		fileSize_ = mappedIn_->size();
+	}
+	catch (const std::exception &e)
+	{
+		delete mappedIn_;
+		mappedIn_ = NULL;
+	}
+	if (!mappedIn_)
+	{
+		serializeIn_ = new ifstream(inFileName, ios::in | ios::binary);
+		if (!serializeIn_ || !serializeIn_->is_open())
+		{
+			cerr << "Could not open ifstream(" << inFileName << ")" << endl;
+			deleteInputPointers();
+			return false;
+		}
+		serializeIn_->seekg(0, ios::end);
+		fileSize_ = serializeIn_->tellg();
+	}
+
+	ZMSFileHeader header;
+	const char *headerBuf = fileData(0, ZMS_FILE_HEADER_SIZE, storedBuffer_);
+	if (!headerBuf || !zmsDecodeFileHeader(headerBuf, header))
+	{
+		deleteInputPointers();
+		return false;
+	}
+	if (header.version != ZMS_VERSION)
+	{
+		cerr << "ZMSIn : unsupported version " << header.version << endl;
+		deleteInputPointers();
+		return false;
+	}
+
+	indexed_ = true;
+	if (!readIndex())
+	{
+		cerr << "ZMSIn : could not read frame index from " << inFileName << endl;
+		deleteInputPointers();
+		return false;
+	}
+	return true;
+}
+
+// Get a pointer to len bytes starting at offset.  For mapped
+// files this points directly into the mapping.  Otherwise
+// the data is read into buf.  Returns NULL if the requested
+// range goes past the end of the file
+const char *ZMSIn::fileData(uint64_t offset, uint64_t len, vector<char> &buf)
+{
+	if ((offset > fileSize_) || (len > (fileSize_ - offset)))
+		return NULL;
+	if (mappedIn_)
+		return mappedIn_->data() + offset;
+
+	buf.resize(len);
+	serializeIn_->clear();
+	serializeIn_->seekg(offset);
+	if (!serializeIn_->read(buf.data(), len))
+		return NULL;
+	return buf.data();
+}
+
+// Read the footer and the index it points to.  If those
+// are missing or don't make sense (file wasn't closed
+// properly) fall back to scanning the chunk headers
+bool ZMSIn::readIndex(void)
+{
+	frameOffsets_.clear();
+	if (fileSize_ >= (ZMS_FILE_HEADER_SIZE + ZMS_FOOTER_SIZE))
+	{
+		// The index sits right before the footer. Check the
+		// footer agrees with that one term at a time so a
+		// corrupt count or offset can't wrap the math around
+		// into something which looks valid
+		const uint64_t indexEnd = fileSize_ - ZMS_FOOTER_SIZE;
+		ZMSFooter footer;
+		const char *footerBuf = fileData(indexEnd, ZMS_FOOTER_SIZE, storedBuffer_);
+		if (footerBuf && zmsDecodeFooter(footerBuf, footer) &&
+			(footer.frameCount <= (indexEnd / sizeof(uint64_t))) &&
+			(footer.indexOffset == (indexEnd - footer.frameCount * sizeof(uint64_t))))
+		{
+			const char *indexBuf = fileData(footer.indexOffset, footer.frameCount * sizeof(uint64_t), storedBuffer_);
+			bool valid = indexBuf != NULL;
+			for (size_t i = 0; valid && (i < footer.frameCount); i++)
+			{
+				// Every chunk has to start before the index
+				const uint64_t offset = zmsGetU64(indexBuf + i * sizeof(uint64_t));
+				if ((offset < ZMS_FILE_HEADER_SIZE) || (offset >= footer.indexOffset))
+					valid = false;
+				else
+					frameOffsets_.push_back(offset);
+			}
+			if (valid)
+				return true;
+			frameOffsets_.clear();
+		}
+	}
+
+	cerr << "ZMSIn : no index found, rebuilding" << endl;
+	return rebuildIndex();
+}
+
+// Walk the file chunk by chunk, saving the offset
+// of each complete one.  Stops at the first partial
+// or corrupt chunk - probably where the recording
+// was cut off
+bool ZMSIn::rebuildIndex(void)
+{
+	frameOffsets_.clear();
+	uint64_t offset = ZMS_FILE_HEADER_SIZE;
+	while (true)
+	{
+		ZMSChunkHeader chunkHeader;
+		const char *chunkBuf = fileData(offset, ZMS_CHUNK_HEADER_SIZE, storedBuffer_);
+		if (!chunkBuf || !zmsDecodeChunkHeader(chunkBuf, chunkHeader) ||
+			(chunkHeader.storedSize > (fileSize_ - offset - ZMS_CHUNK_HEADER_SIZE)))
+			break;
+		const uint64_t next = offset + ZMS_CHUNK_HEADER_SIZE + zmsAlign(chunkHeader.storedSize);
+		if (next > fileSize_)
+			break;
+		frameOffsets_.push_back(offset);
+		offset = next;
+	}
+	return !frameOffsets_.empty();
+}
+
+// Read a single chunk from a version 2 file.
+// frame and depth are headers pointing into storage
+// rather than owning their data. Compressed chunks are
+// decompressed straight into storage, allocating it only
+// if it isn't big enough - when called from SyncIn it
+// comes back from the FramePool already the right size.
+// For uncompressed chunks in a mapped file, storage is a
+// header over the chunk's bytes in the mapping so nothing
+// is allocated or copied at all. The mapping doesn't
+// change until the file is closed, which is why the
+// FramePool can hand those out without copying them -
+// but it also means frames from a mapped file have to be
+// dropped before the ZMSIn is destroyed.
+// The Mats point at read-only memory and must not
+// be written to.
+bool ZMSIn::readIndexedFrame(size_t index, Mat &frame, Mat &depth, Mat &storage)
+{
+	if (index >= frameOffsets_.size())
+		return false;
+
+	ZMSChunkHeader chunkHeader;
+	const char *chunkBuf = fileData(frameOffsets_[index], ZMS_CHUNK_HEADER_SIZE, storedBuffer_);
+	if (!chunkBuf || !zmsDecodeChunkHeader(chunkBuf, chunkHeader))
+	{
+		cerr << "ZMSIn : bad chunk header for frame " << index << endl;
+		return false;
+	}
+
+	const char *payload = fileData(frameOffsets_[index] + ZMS_CHUNK_HEADER_SIZE,
+								   chunkHeader.storedSize, storedBuffer_);
+	if (!payload)
+	{
+		cerr << "ZMSIn : truncated chunk for frame " << index << endl;
+		return false;
+	}
+
+	// Every payload holds at least the two Mat headers
+	if ((chunkHeader.rawSize < (2 * ZMS_MAT_HEADER_SIZE)) ||
+		(chunkHeader.rawSize > ZMS_MAX_RAW_SIZE))
+	{
+		cerr << "ZMSIn : bad size for frame " << index << endl;
+		return false;
+	}
+
+	if ((chunkHeader.codec == ZMS_CODEC_NONE) && (chunkHeader.rawSize != chunkHeader.storedSize))
+	{
+		cerr << "ZMSIn : bad size for frame " << index << endl;
+		return false;
+	}
+
+	if ((chunkHeader.codec == ZMS_CODEC_NONE) && mappedIn_)
+	{
+		storage = Mat(1, (int)chunkHeader.rawSize, CV_8UC1, const_cast<char *>(payload));
+	}
+	else
+	{
+		// Headers into the mapping can't be written to
+		if (inMapping(storage) || (storage.total() < chunkHeader.rawSize))
+			storage = Mat(1, (int)chunkHeader.rawSize, CV_8UC1);
+
+		// Uncompressed chunks read through the ifstream
+		// are in storedBuffer_, which the next read reuses
+		if (chunkHeader.codec == ZMS_CODEC_NONE)
+			memcpy(storage.data, payload, chunkHeader.rawSize);
+		else if (!zmsDecompress((ZMSCodec)chunkHeader.codec,
+					payload, chunkHeader.storedSize,
+					storage.ptr<char>(), chunkHeader.rawSize))
+		{
+			cerr << "ZMSIn : could not decompress frame " << index << endl;
+			return false;
+		}
+	}
+
+	if (!zmsUnpackMats(storage.ptr<char>(), chunkHeader.rawSize, frame, depth, false))
+	{
+		cerr << "ZMSIn : could not read frame " << index << endl;
+		return false;
+	}
+	return true;
+}
+
+// True if mat is a header pointing into the file
+// mapping rather than a buffer of its own
+bool ZMSIn::inMapping(const Mat &mat) const
+{
+	if (!mappedIn_ || mat.empty())
+		return false;
+	const char *data = reinterpret_cast<const char *>(mat.data);
+	return (data >= mappedIn_->data()) && (data < (mappedIn_->data() + fileSize_));
+}
+
 // Helper to easily delete and NULL out input file pointers
 void ZMSIn::deleteInputPointers(void)
 {
@@ -161,6 +414,13 @@ void ZMSIn::deleteInputPointers(void)
 		delete serializeIn_;
 		serializeIn_ = NULL;
 	}
+	if (mappedIn_)
+	{
+		delete mappedIn_;
+		mappedIn_ = NULL;
+	}
+	indexed_ = false;
+	frameOffsets_.clear();
 }
 
 
@@ -173,12 +433,52 @@ ZMSIn::~ZMSIn()
 
 bool ZMSIn::isOpened(void) const
 {
-	return archiveIn_ || portableArchiveIn_;
+	return archiveIn_ || portableArchiveIn_ || indexed_;
+}
+
+
+// Only indexed files know how many frames
+// they hold without reading the whole thing
+int ZMSIn::frameCount(void) const
+{
+	if (indexed_)
+		return frameOffsets_.size();
+	return -1;
+}
+
+
+// Called by SyncIn, which passes storage on to its
+// FramePool along with frame and depth
+bool ZMSIn::postLockUpdateWithStorage(cv::Mat &frame, cv::Mat &depth, cv::Mat &storage)
+{
+	if (!indexed_)
+	{
+		storage.release();
+		return postLockUpdate(frame, depth);
+	}
+
+	// Running off the end of the index is EOF
+	if (!readIndexedFrame(nextFrame_, frame, depth, storage))
+		return false;
+	nextFrame_ += 1;
+	return true;
 }
 
 
 bool ZMSIn::postLockUpdate(cv::Mat &frame, cv::Mat &depth)
 {
+	if (indexed_)
+	{
+		// Nowhere to keep the storage frame and
+		// depth point into, so give them their own copy
+		Mat storage;
+		if (!postLockUpdateWithStorage(frame, depth, storage))
+			return false;
+		frame = frame.clone();
+		depth = depth.clone();
+		return true;
+	}
+
 	// Ugly try-catch to detect EOF
 	try
 	{
@@ -197,14 +497,15 @@ bool ZMSIn::postLockUpdate(cv::Mat &frame, cv::Mat &depth)
 }
 
 
-// Can't randomly seek in ZMS yet
-// TOOD : if moving forward, read frames sequentially?
-//        if moving backwards, reopen then read forward sequentially?
+// Indexed files can jump straight to any frame. Older
+// files are one long compressed stream so seeking isn't
+// supported for those
 bool ZMSIn::postLockFrameNumber(int framenumber)
 {
-	(void) framenumber;
-	return false;
-
+	if (!indexed_ || (framenumber < 0) || ((size_t)framenumber >= frameOffsets_.size()))
+		return false;
+	nextFrame_ = framenumber;
+	return true;
 }
 
 
@@ -4,7 +4,9 @@
 #include <opencv2/core/core.hpp>
 #include "syncin.hpp"
 
+#include <vector>
 #include <boost/archive/binary_iarchive.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/iostreams/filtering_streambuf.hpp>
 
 #include "portable_binary_iarchive.hpp"
@@ -16,6 +18,7 @@ class ZMSIn : public SyncIn
 		~ZMSIn();
 
 		bool isOpened(void) const;
+		int frameCount(void) const;
 
 		CameraParams getCameraParams(void) const;
 
@@ -25,11 +28,18 @@ class ZMSIn : public SyncIn
 		// source.  preLock happens before the mutex
 		// while postLock happens inside it
 		bool postLockUpdate(cv::Mat &frame, cv::Mat &depth);
+		bool postLockUpdateWithStorage(cv::Mat &frame, cv::Mat &depth, cv::Mat &storage);
 		bool postLockFrameNumber(int framenumber);
 
 	private:
 		void deleteInputPointers(void);
 		bool openSerializeInput(const char *filename, bool portable);
+		bool openIndexedInput(const char *filename);
+		const char *fileData(uint64_t offset, uint64_t len, std::vector<char> &buf);
+		bool readIndex(void);
+		bool rebuildIndex(void);
+		bool readIndexedFrame(size_t index, cv::Mat &frame, cv::Mat &depth, cv::Mat &storage);
+		bool inMapping(const cv::Mat &mat) const;
 		void update(void);
 
 		// frame_ is the most recent frame grabbed from 
@@ -48,4 +58,16 @@ class ZMSIn : public SyncIn
 		boost::iostreams::filtering_streambuf<boost::iostreams::input> *filtSBIn_;
 		boost::archive::binary_iarchive *archiveIn_;
 		portable_binary_iarchive *portableArchiveIn_;
+
+		// Version 2 files are memory mapped if possible,
+		// falling back to reading from serializeIn_.
+		// Frames are found using the chunk index.
+		// nextFrame_ is the index of the chunk
+		// the next postLockUpdate call will read
+		boost::iostreams::mapped_file_source *mappedIn_;
+		uint64_t              fileSize_;
+		bool                  indexed_;
+		std::vector<uint64_t> frameOffsets_;
+		size_t                nextFrame_;
+		std::vector<char>     storedBuffer_;
 };
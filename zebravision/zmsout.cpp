@@ -1,13 +1,12 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include <boost/filesystem.hpp>
-#include <boost/iostreams/filter/zlib.hpp>
 
 #include "zmsout.hpp"
-#include "cvMatSerialize.hpp"
 
 using namespace std;
 using namespace cv;
@@ -16,43 +15,120 @@ using namespace boost::filesystem;
 // Save the raw camera stream to disk.  This uses a home-brew
 // method to serialize image and depth data to disk rather than
 // relying on Stereolab's SVO format.
-ZMSOut::ZMSOut(const char *outFile, int frameSkip) :
-	MediaOut(frameSkip, 150),
+ZMSOut::ZMSOut(const char *outFile, int frameSkip, ZMSCodec codec) :
+	MediaOut(frameSkip, 150, 0),
 	fileName_(outFile),
 	serializeOut_(NULL),
-	filtSBOut_(NULL),
-	archiveOut_(NULL)
+	codec_(codec),
+	writeOffset_(0),
+	rawBytes_(0),
+	storedBytes_(0),
+	compressTicks_(0)
 {
+	if (!zmsCodecAvailable(codec_))
+	{
+		cerr << "ZMSOut : " << zmsCodecName(codec_) << " support not compiled in, using zlib" << endl;
+		codec_ = ZMS_CODEC_ZLIB;
+	}
 }
 
 // Clean up pointers, which will also 
-// close the files they point to
+// close the files they point to.  Wait for
+// the writer thread to finish up first so the
+// last frames make it into the file index
 ZMSOut::~ZMSOut()
 {
+	sync();
 	deleteOutputPointers();
 }
 
-// Serialize the frame plus depth info
-bool ZMSOut::write(const Mat &frame, const Mat &depth)
+bool ZMSOut::writeBytes(const char *data, size_t len)
+{
+	serializeOut_->write(data, len);
+	if (!*serializeOut_)
+		return false;
+	writeOffset_ += len;
+	return true;
+}
+
+// Bytes tacked on after each encoded chunk to pass the
+// time spent compressing it along to writeEncoded()
+static const size_t COMPRESS_TICKS_SIZE = sizeof(uint64_t);
+
+// Compress the frame plus depth info into a complete
+// chunk - header, payload and padding. This runs on
+// several of MediaOut's encode threads at once so it
+// only uses per-thread scratch buffers.  The compress
+// time is appended after the chunk rather than added to
+// a shared counter - with several frames in flight the
+// counter could be reset for a new file between the
+// encode of a frame and its write to the old one
+bool ZMSOut::encode(const Mat &frame, const Mat &depth, vector<char> &encoded)
 {
-	if (!archiveOut_)
+	static thread_local vector<char> rawBuffer;
+	static thread_local vector<char> compressedBuffer;
+
+	zmsPackMats(frame, depth, rawBuffer);
+	const int64_t startTicks = getTickCount();
+	if (!zmsCompress(codec_, rawBuffer, compressedBuffer))
 		return false;
+	const int64_t ticks = getTickCount() - startTicks;
 
-	*archiveOut_ << frame << depth;
+	ZMSChunkHeader chunkHeader;
+	chunkHeader.codec      = codec_;
+	chunkHeader.rawSize    = rawBuffer.size();
+	chunkHeader.storedSize = compressedBuffer.size();
+
+	// Pad the payload so the next chunk
+	// starts on an aligned offset
+	const size_t chunkSize = ZMS_CHUNK_HEADER_SIZE + zmsAlign(compressedBuffer.size());
+	encoded.assign(chunkSize + COMPRESS_TICKS_SIZE, 0);
+	zmsEncodeChunkHeader(chunkHeader, &encoded[0]);
+	copy(compressedBuffer.begin(), compressedBuffer.end(), encoded.begin() + ZMS_CHUNK_HEADER_SIZE);
+	zmsPutU64(&encoded[chunkSize], ticks);
 	return true;
 }
 
+// Append a chunk created by encode() to the file. Called
+// from MediaOut's writer thread in frame order, so the
+// per-file stats only ever count frames in that file
+bool ZMSOut::writeEncoded(const vector<char> &encoded)
+{
+	if (!serializeOut_)
+		return false;
 
-// Output needs 3 things. First is a standard ofstream to write to
-// Next is an (optional) filtered stream buffer. This is used to
-// compress on the fly - uncompressed files take up way too
-// much space. Last item is the actual boost binary archive template
-// If all three are opened, return true. If not, delete and set to
-// NULL all pointers related to serialized Output
+	ZMSChunkHeader chunkHeader;
+	zmsDecodeChunkHeader(&encoded[0], chunkHeader);
+
+	// Strip off the compress time encode() left at the end
+	const size_t chunkSize = encoded.size() - COMPRESS_TICKS_SIZE;
+	const uint64_t chunkOffset = writeOffset_;
+	if (!writeBytes(&encoded[0], chunkSize))
+	{
+		cerr << "ZMSOut : error writing frame" << endl;
+		return false;
+	}
+	frameOffsets_.push_back(chunkOffset);
+	rawBytes_    += chunkHeader.rawSize;
+	storedBytes_ += chunkHeader.storedSize;
+	compressTicks_ += zmsGetU64(&encoded[chunkSize]);
+	return true;
+}
+
+// Not normally used since encode() handles every
+// frame, but keep a working version just in case
+bool ZMSOut::write(const Mat &frame, const Mat &depth)
+{
+	vector<char> encoded;
+	return encode(frame, depth, encoded) && writeEncoded(encoded);
+}
+
+
+// Open the output file and write the file header.
+// Closes out any previously open file first
 bool ZMSOut::openSerializeOutput(const char *fileName)
 {
 	deleteOutputPointers();
-	// First create an ofstream to write to
 	serializeOut_ = new ofstream(fileName, ios::out | ios::binary);
 	if (!serializeOut_ || !serializeOut_->is_open())
 	{
@@ -60,25 +136,22 @@ bool ZMSOut::openSerializeOutput(const char *fileName)
 		deleteOutputPointers();
 		return false;
 	}
-	// Create a filtering streambuf.  Push zlib and then
-	// the ofstream created above so output is automatically
-	// compressed before writing to disk
-	filtSBOut_= new boost::iostreams::filtering_streambuf<boost::iostreams::output>;
-	if (!filtSBOut_)
-	{
-		cerr << "Could not create filtering_streambuf<output> in constructor" <<endl;
-		deleteOutputPointers();
-		return false;
-	}
-	filtSBOut_->push(boost::iostreams::zlib_compressor(boost::iostreams::zlib::best_speed));
-	filtSBOut_->push(*serializeOut_);
 
-	// Create an output archive which writes to the previously
-	// created output chain (zlib->output file path)
-	archiveOut_ = new portable_binary_oarchive(*filtSBOut_);
-	if (!archiveOut_)
+	writeOffset_     = 0;
+	frameOffsets_.clear();
+	currentFileName_ = fileName;
+	rawBytes_        = 0;
+	storedBytes_     = 0;
+	compressTicks_   = 0;
+
+	ZMSFileHeader fileHeader;
+	fileHeader.version = ZMS_VERSION;
+	fileHeader.codec   = codec_;
+	char headerBuf[ZMS_FILE_HEADER_SIZE];
+	zmsEncodeFileHeader(fileHeader, headerBuf);
+	if (!writeBytes(headerBuf, sizeof(headerBuf)))
 	{
-		cerr << "Could not create binary_oarchive in constructor" <<endl;
+		cerr << "Could not write header to " << fileName << endl;
 		deleteOutputPointers();
 		return false;
 	}
@@ -103,21 +176,40 @@ bool ZMSOut::openNext(int fileCounter)
 
 
 // Helper to easily delete and NULLize output file pointers
+// Before closing the file, write the chunk index and
+// footer so readers can seek directly to any frame
 void ZMSOut::deleteOutputPointers(void)
 {
-	if (archiveOut_)
-	{
-		delete archiveOut_;
-		archiveOut_ = NULL;
-	}
-	if (filtSBOut_)
-	{
-		delete filtSBOut_;
-		filtSBOut_ = NULL;
-	}
 	if (serializeOut_)
 	{
+		if (serializeOut_->is_open())
+		{
+			ZMSFooter footer;
+			footer.indexOffset = writeOffset_;
+			footer.frameCount  = frameOffsets_.size();
+
+			vector<char> indexBuf(frameOffsets_.size() * sizeof(uint64_t));
+			for (size_t i = 0; i < frameOffsets_.size(); i++)
+				zmsPutU64(&indexBuf[i * sizeof(uint64_t)], frameOffsets_[i]);
+			char footerBuf[ZMS_FOOTER_SIZE];
+			zmsEncodeFooter(footer, footerBuf);
+
+			if ((indexBuf.size() && !writeBytes(&indexBuf[0], indexBuf.size())) ||
+				!writeBytes(footerBuf, sizeof(footerBuf)))
+				cerr << "ZMSOut : error writing index" << endl;
+
+			// Report how well the codec is keeping up and
+			// how much it is saving
+			if (rawBytes_ && storedBytes_)
+			{
+				const double seconds = compressTicks_ / getTickFrequency();
+				cout << "ZMSOut : " << currentFileName_ << " " << frameOffsets_.size() << " frames, "
+					 << zmsCodecName(codec_) << " " << (rawBytes_ / (1024. * 1024.)) / max(seconds, 1e-6) << " MB/sec per thread, "
+					 << "ratio " << (double)rawBytes_ / storedBytes_ << endl;
+			}
+		}
 		delete serializeOut_;
 		serializeOut_ = NULL;
 	}
+	frameOffsets_.clear();
 }
@@ -1,14 +1,19 @@
 #pragma once
-#include <portable_binary_oarchive.hpp>
-#include <boost/iostreams/filtering_streambuf.hpp>
+#include <fstream>
+#include <vector>
 #include "mediaout.hpp"
+#include "zmsformat.hpp"
 
 // Hack up a way to save zed data - serialize both
 // BGR frame and depth frame
+// Output is in the indexed version 2 ZMS format, see
+// zmsformat.hpp for details
 class ZMSOut : public MediaOut
 {
 	public:
-		ZMSOut(const char *outFile, int frameSkip = 0);
+		// codec is used to compress each frame. Falls back
+		// to zlib if support for it wasn't compiled in
+		ZMSOut(const char *outFile, int frameSkip = 0, ZMSCodec codec = ZMS_CODEC_ZLIB);
 		~ZMSOut();
 
 	private :
@@ -16,10 +21,27 @@ class ZMSOut : public MediaOut
 		void deleteOutputPointers(void);
 		bool openSerializeOutput(const char *filename);
 		bool write(const cv::Mat &frame, const cv::Mat &depth);
+		bool encode(const cv::Mat &frame, const cv::Mat &depth, std::vector<char> &encoded);
+		bool writeEncoded(const std::vector<char> &encoded);
+		bool writeBytes(const char *data, size_t len);
 
 		std::string fileName_;
+		std::string currentFileName_;
 
 		std::ofstream *serializeOut_;
-		boost::iostreams::filtering_streambuf<boost::iostreams::output> *filtSBOut_;
-		portable_binary_oarchive *archiveOut_;
+		ZMSCodec       codec_;
+
+		// Current write position plus the offset of each
+		// chunk written so far.  The offsets are written
+		// out as an index when the file is closed
+		uint64_t              writeOffset_;
+		std::vector<uint64_t> frameOffsets_;
+
+		// Stats for the current file, printed when it
+		// is closed. compressTicks_ is the time spent
+		// compressing summed over all encode threads.
+		// All three are only touched by the writer thread
+		uint64_t rawBytes_;
+		uint64_t storedBytes_;
+		uint64_t compressTicks_;
 };
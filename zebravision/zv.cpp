@@ -32,6 +32,8 @@
 #include "Utilities.hpp"
 #include "FlowLocalizer.hpp"
 #include "ZvSettings.hpp"
+#include "framepipeline.hpp"
+#include "zvtelemetry.hpp"
 #include "version.hpp"
 
 using namespace std;
@@ -44,7 +46,7 @@ using namespace cv::cuda;
 #endif
 
 //function prototypes
-void sendZMQData(size_t objectCount, zmq::socket_t& publisher, const vector<TrackedObjectDisplay>& displayList, const GoalDetector& gd, long long timestamp);
+void sendZMQData(size_t objectCount, zmq::socket_t& publisher, const vector<TrackedObjectDisplay>& displayList, float goalDist, float goalAngle, int frameNumber, long long timestamp);
 void writeImage(const Mat& frame, const vector<Rect>& rects, size_t index, const char *path, int frameNumber);
 string getDateTimeString(void);
 void drawRects(Mat image, const vector<Rect> &detectRects, Scalar rectColor = Scalar(0,0,255), bool text = true);
@@ -281,13 +283,14 @@ int main( int argc, const char** argv )
 	DetectState *detectState = NULL;
 	if (args.detection)
 	{
-		bool hasGPU = getCudaEnabledDeviceCount() > 0;
+		// --cpuNet forces everything to run on the CPU
+		bool hasGPU = !args.cpuNet && (getCudaEnabledDeviceCount() > 0);
 		detectState = new DetectState(
 				ClassifierIO(args.d12BaseDir, args.d12DirNum, args.d12StageNum),
 				ClassifierIO(args.d24BaseDir, args.d24DirNum, args.d24StageNum),
 				ClassifierIO(args.c12BaseDir, args.c12DirNum, args.c12StageNum),
 				ClassifierIO(args.c24BaseDir, args.c24DirNum, args.c24StageNum),
-				camParams.fov.x, hasGPU);
+				camParams.fov.x, hasGPU, false, args.cpuNet);
 	}
 
 	// Find the first frame number which has ground truth data
@@ -309,7 +312,15 @@ int main( int argc, const char** argv )
 		if (depth.empty())
 			rawOut = new AVIOut(getVideoOutName(true, ".avi").c_str(), frame.size(), args.writeVideoSkip);
 		else
-			rawOut = new ZMSOut(getVideoOutName(true, ".zms").c_str(), args.writeVideoSkip);
+		{
+			ZMSCodec codec;
+			if (!zmsCodecFromName(args.captureCodec, codec))
+			{
+				cerr << "Unknown capture codec " << args.captureCodec << ", using zlib" << endl;
+				codec = ZMS_CODEC_ZLIB;
+			}
+			rawOut = new ZMSOut(getVideoOutName(true, ".zms").c_str(), args.writeVideoSkip, codec);
+		}
 	}
 
 	// No point in saving ZMS files of processed output, since
@@ -336,6 +347,24 @@ int main( int argc, const char** argv )
 	//Creating Goaldetection object
 	GoalDetector gd(camParams.fov, Size(cap->width(),cap->height()), !args.batchMode);
 
+	// Used to find the depth of each detected object
+	DepthStats depthStats;
+
+	// In batch mode the per-frame stages can run in separate
+	// threads so capture and goal detection of the next frame
+	// overlap with object detection of the current one.
+	// Interactive mode, ground truth and frame skipping all
+	// seek around in the input from the main loop, so
+	// run everything in order for those
+	FramePipeline *pipeline = NULL;
+	if (args.pipeline)
+	{
+		if (args.batchMode && !args.groundTruth && (args.skip == 0) && (cap->frameCount() != 1))
+			pipeline = new FramePipeline(cap, frame, depth, gd, fllc, detectState, filterUsingDepth);
+		else
+			cerr << "--pipeline only works in batch mode without --groundTruth or --skip, ignoring" << endl;
+	}
+
 	// Start of the main loop
 	//  -- grab a frame
 	//  -- update the angle of tracked objects
@@ -345,51 +374,85 @@ int main( int argc, const char** argv )
 	{
 		frameTicker.mark(); // mark start of new frame
 
+		// Output of goal detect, optical flow and object
+		// detection for this frame
+		FrameResult result;
+		if (pipeline)
+		{
+			// Stages are running in separate threads,
+			// grab the next finished frame in order
+			if (!pipeline->getResult(result))
+				break;
+			// The input buffers are shared with the
+			// capture side and get reused once the
+			// result is dropped. Markup only gets
+			// drawn on frame when saving processed
+			// video, so only make a copy for that
+			if (args.saveVideo && processedOut)
+				frame = result.input->frame.clone();
+			else
+				frame = result.input->frame;
+			depth = result.input->depth;
+		}
+
 		// Write raw video before anything gets drawn on it
 		if (rawOut)
 			rawOut->saveFrame(frame, depth);
 
-		// This code will load a classifier if none is loaded - this handles
-		// initializing the classifier the first time through the loop.
-		// It also handles cases where the user changes the classifer
-		// being used - this forces a reload
-		// Finally, it allows a switch between CPU and GPU on the fly
-		if (detectState && (detectState->update() == false))
-			break;
+		if (!pipeline)
+		{
+			result.frameNumber = cap->frameNumber();
+			result.timeStamp   = cap->timeStamp();
+
+			// This code will load a classifier if none is loaded - this handles
+			// initializing the classifier the first time through the loop.
+			// It also handles cases where the user changes the classifer
+			// being used - this forces a reload
+			// Finally, it allows a switch between CPU and GPU on the fly
+			if (detectState && (detectState->update() == false))
+				break;
 
-		// run Goaldetector
-		gd.processFrame(frame, depth);
+			// run Goaldetector
+			gd.processFrame(frame, depth);
+			result.goalDist  = gd.dist_to_goal();
+			result.goalAngle = gd.angle_to_goal();
+			result.goalRect  = gd.goal_rect();
+			result.goalPos   = gd.goal_pos();
 
-		if (gd.goal_pos() != Point3f())
-			cout << "Goal Position=" << gd.goal_pos() << endl;
+			//compute optical flow
+			if (detectState)
+			{
+				fllc.processFrame(frame);
+				result.flowTransform = fllc.transform_mat();
+			}
+
+			// Apply the classifier to the frame
+			// detectRects is a vector of rectangles, one for each detected object
+			if (detectState)
+				detectState->detector()->Detect(frame, filterUsingDepth ? depth : Mat(), result.detectRects, result.uncalibDetectRects);
+		}
+		const vector<Rect> &detectRects        = result.detectRects;
+		const vector<Rect> &uncalibDetectRects = result.uncalibDetectRects;
+
+		if (result.goalPos != Point3f())
+			cout << "Goal Position=" << result.goalPos << endl;
 
 		//if we are using a goal_truth.txt file that has the actual locations of the goal mark that we detected correctly
         vector<Rect> goalTruthHitList;
         if (cap->frameCount() >= 0)
         {
             vector<Rect> goalDetects;
-            goalDetects.push_back(gd.goal_rect());
-            goalTruthHitList = goalTruth.processFrame(cap->frameNumber(), goalDetects);
+            goalDetects.push_back(result.goalRect);
+            goalTruthHitList = goalTruth.processFrame(result.frameNumber, goalDetects);
         }
 
-		//compute optical flow
-		if (detectState)
-			fllc.processFrame(frame);
-
-		// Apply the classifier to the frame
-		// detectRects is a vector of rectangles, one for each detected object
-		vector<Rect> detectRects;
-		vector<Rect> uncalibDetectRects;
-		if (detectState)
-			detectState->detector()->Detect(frame, filterUsingDepth ? depth : Mat(), detectRects, uncalibDetectRects);
-
 		// If args.captureAll is enabled, write each detected rectangle
 		// to their own output image file. Do it before anything else
 		// so there's nothing else drawn to frame yet, just the raw
 		// input image
 		if (args.captureAll)
 			for (size_t index = 0; index < detectRects.size(); index++)
-				writeImage(frame, detectRects, index, capPath.c_str(), cap->frameNumber());
+				writeImage(frame, detectRects, index, capPath.c_str(), result.frameNumber);
 
 		//adjust object locations based on optical flow information
 		if (detectState)
@@ -401,7 +464,7 @@ int main( int argc, const char** argv )
 
 			// TODO : switch this on and off based on depth info availability?
 			//objectTrackingList.adjustLocation(fvlc.transform_eigen());
-			objectTrackingList.adjustLocation(fllc.transform_mat());
+			objectTrackingList.adjustLocation(result.flowTransform);
 
 #if 0
 			cout << "Locations after adjustment: " << endl;
@@ -424,8 +487,7 @@ int main( int argc, const char** argv )
 			//when we use optical flow to adjust we need to recompute the depth based on the new locations.
 			//to do this shrink the bounding rectangle and take the minimum rect of the inside
 			shrinkRect(depthRect,depthRectScale);
-			Mat emptyMask(depth.rows,depth.cols,CV_8UC1,Scalar(255));
-			float objectDepth = minOfDepthMat(depth, emptyMask, depthRect, 10).first;
+			float objectDepth = depthStats.minMax(depth, depthRect, 10).first;
 
 			// If no depth data is available, calculate a fake
 			// depth value as if the object were at the perfect
@@ -460,26 +522,26 @@ int main( int argc, const char** argv )
 		// Send data over the network
 		// If objdetction is enabled, send detection data
 		// always send goal detection info
-        sendZMQData(detectState ? netTableArraySize : 0, publisher, displayList, gd, cap->timeStamp());
+        sendZMQData(detectState ? netTableArraySize : 0, publisher, displayList, result.goalDist, result.goalAngle, result.frameNumber, result.timeStamp);
 
 		// Ground truth is a way of storing known locations of objects in a file.
 		// Check ground truth data on videos and images,
 		// but not on camera input
 		vector<Rect> groundTruthHitList;
 		if (cap->frameCount() >= 0)
-			groundTruthHitList = groundTruth.processFrame(cap->frameNumber(), detectRects);
+			groundTruthHitList = groundTruth.processFrame(result.frameNumber, detectRects);
 
 		// For interactive mode, update the FPS as soon as we have
 		// a complete array of frame time entries
 		// For args.batch mode, only update every frameTicksLength frames to
 		// avoid printing too much stuff
 		if (frameTicker.valid() &&
-			( (!args.batchMode && ((cap->frameNumber() % frameDisplayFrequency) == 0)) ||
-			  ( args.batchMode && (((cap->frameNumber() * ((args.skip > 0) ? args.skip : 1)) % 1) == 0))))
+			( (!args.batchMode && ((result.frameNumber % frameDisplayFrequency) == 0)) ||
+			  ( args.batchMode && (((result.frameNumber * ((args.skip > 0) ? args.skip : 1)) % 1) == 0))))
 		{
 			int frames = cap->frameCount();
 			stringstream frameStr;
-			frameStr << cap->frameNumber();
+			frameStr << result.frameNumber;
 			if (frames > 0)
 				frameStr << '/' << frames;
 
@@ -509,7 +571,7 @@ int main( int argc, const char** argv )
 		// frames. Normally this value is 1 so we display every frame. When exporting
 		// X over a network, though, we can speed up processing by only displaying every
 		// 3, 5 or whatever frames instead.
-		if ((!args.batchMode && ((cap->frameNumber() % frameDisplayFrequency) == 0)) ||
+		if ((!args.batchMode && ((result.frameNumber % frameDisplayFrequency) == 0)) ||
 			(args.saveVideo && processedOut))
 		{
 			if (args.rects)
@@ -527,10 +589,10 @@ int main( int argc, const char** argv )
 			// Check is needed in case we're saving in batch mode
 			// which means generate all the GUI data to write to 
 			// disk but don't actually display on screen
-			if (!args.batchMode && ((cap->frameNumber() % frameDisplayFrequency) == 0)) 
+			if (!args.batchMode && ((result.frameNumber % frameDisplayFrequency) == 0)) 
 			{
 				vector<TrackedObjectDisplay> emptyDisplayList;
-				drawTrackingTopDown(top_frame, args.tracking ? displayList : emptyDisplayList, gd.goal_pos());
+				drawTrackingTopDown(top_frame, args.tracking ? displayList : emptyDisplayList, result.goalPos);
 				imshow("Top view", top_frame);
 			}
 
@@ -552,7 +614,7 @@ int main( int argc, const char** argv )
 			{
 			   line (frame, Point(frame.cols/2, 0) , Point(frame.cols/2, frame.rows), Scalar(255,255,0));
 			   line (frame, Point(0, frame.rows/2) , Point(frame.cols, frame.rows/2), Scalar(255,255,0));
-			   Rect gr = gd.goal_rect();
+			   Rect gr = result.goalRect;
 			   if (gr != Rect())
 			   {
 
@@ -566,9 +628,9 @@ int main( int argc, const char** argv )
             // if none is available for this particular video frame
 			if (args.rects)
 			{
-				drawRects(frame, groundTruth.get(cap->frameNumber() - 1), Scalar(128, 0, 0), false);
+				drawRects(frame, groundTruth.get(result.frameNumber - 1), Scalar(128, 0, 0), false);
 				drawRects(frame, groundTruthHitList, Scalar(128, 128, 128), false);
-				drawRects(frame, goalTruth.get(cap->frameNumber() - 1), Scalar(0, 0, 128), false);
+				drawRects(frame, goalTruth.get(result.frameNumber - 1), Scalar(0, 0, 128), false);
 				drawRects(frame, goalTruthHitList, Scalar(128, 128, 128), false);
 			}
 
@@ -576,11 +638,11 @@ int main( int argc, const char** argv )
 			if (gdDraw)
 				gd.drawOnFrame(frame);
 			if (args.rects)
-				rectangle(frame, gd.goal_rect(), Scalar(0, 255, 0));
+				rectangle(frame, result.goalRect, Scalar(0, 255, 0));
 
 			// Main call to display output for this frame after all
 			// info has been written on it.
-			if (!args.batchMode && ((cap->frameNumber() % frameDisplayFrequency) == 0)) 
+			if (!args.batchMode && ((result.frameNumber % frameDisplayFrequency) == 0)) 
 				imshow(windowName, frame);
 
 			// If saveVideo is set, write the marked-up frame to a file
@@ -662,7 +724,7 @@ int main( int argc, const char** argv )
             {
                 stringstream output_line;
                 output_line << args.inputName << " " << cap->frameNumber() - 1 << " ";
-                Rect r = gd.goal_rect();
+                Rect r = result.goalRect;
                 output_line << r.x << " " << r.y << " " << r.width << " " << r.height;
                 ofstream tag_file("goal_truth.txt", std::ios_base::app | std::ios_base::out);
                 tag_file << output_line.str() << endl;
@@ -832,10 +894,15 @@ int main( int argc, const char** argv )
 		if (args.batchMode && (cap->frameCount() == 1))
 			break;
 
-		if (!cap->getFrame(frame, depth, pause))
+		if (!pipeline && !cap->getFrame(frame, depth, pause))
 			break;
 	}
 
+	// Shut down the stage threads before
+	// deleting the objects they use
+	if (pipeline)
+		delete pipeline;
+
 	if (detectState)
 	{
 		cout << "Ball detect ground truth : " << endl;
@@ -851,45 +918,37 @@ int main( int argc, const char** argv )
 	return 0;
 }
 
-void sendZMQData(size_t objectCount, zmq::socket_t& publisher, const vector<TrackedObjectDisplay>& displayList, const GoalDetector& gd, long long timestamp)
+// Send goal and object detection results for this frame as
+// a single binary message - see zvtelemetry.hpp for the layout.
+// objectCount is the max number of objects to send, 0 if
+// object detection isn't running
+void sendZMQData(size_t objectCount, zmq::socket_t& publisher, const vector<TrackedObjectDisplay>& displayList, float goalDist, float goalAngle, int frameNumber, long long timestamp)
 {
-	// Only send objdetect data if the objdetection code is running
-	if (objectCount)
-	{
-		stringstream objdetString;
+	// Only called from the main loop, so keep these around
+	// between frames rather than reallocating each time
+	static TelemetryFrame telemetry;
+	static vector<char> buf;
 
-		objdetString << "B ";
-		for (size_t i = 0; i < objectCount; i++)
-		{
-			if (i < displayList.size())
-			{
-				objdetString << fixed << setprecision(2) << displayList[i].ratio << " ";
-				objdetString << fixed << setprecision(2) << displayList[i].position.x << " ";
-				objdetString << fixed << setprecision(2) << displayList[i].position.y << " ";
-				objdetString << fixed << setprecision(2) << displayList[i].position.z << " ";
-			}
-			else
-			{
-				objdetString << "0.00 0.00 0.00 0.00 ";
-			}
-		}
+	telemetry.frameNumber  = frameNumber;
+	telemetry.timestamp    = timestamp;
+	telemetry.objectsValid = objectCount > 0;
+	telemetry.goalDist     = goalDist;
+	telemetry.goalAngle    = goalAngle;
 
-		cout << "B : " << timestamp << " : " << objdetString.str() << endl;
-		zmq::message_t request(objdetString.str().length() - 1);
-		memcpy((void *)request.data(), objdetString.str().c_str(), objdetString.str().length() - 1);
-		publisher.send(request);
+	// Only send objdetect data if the objdetection code is running
+	telemetry.objects.resize(min(objectCount, displayList.size()));
+	for (size_t i = 0; i < telemetry.objects.size(); i++)
+	{
+		telemetry.objects[i].ratio = displayList[i].ratio;
+		telemetry.objects[i].x     = displayList[i].position.x;
+		telemetry.objects[i].y     = displayList[i].position.y;
+		telemetry.objects[i].z     = displayList[i].position.z;
 	}
 
-    //Creates immutable strings for 0MQ Output
-    stringstream goalString;
-    goalString << "G ";
-    goalString << fixed << setprecision(4) << gd.dist_to_goal() << " ";
-    goalString << fixed << setprecision(2) << gd.angle_to_goal();
-
-    cout << "G " << timestamp << " : " << goalString.str().length() << " : " << goalString.str() << endl;
-    zmq::message_t grequest(goalString.str().length() - 1);
-    memcpy((void *)grequest.data(), goalString.str().c_str(), goalString.str().length() - 1);
-    publisher.send(grequest);
+	telemetryEncode(telemetry, buf);
+	zmq::message_t message(buf.size());
+	memcpy(message.data(), &buf[0], buf.size());
+	publisher.send(message);
 }
 
 
@@ -0,0 +1,123 @@
+#include <cstring>
+
+#include "zvtelemetry.hpp"
+
+using namespace std;
+
+// Fixed-width little endian helpers, same idea
+// as the ones used for ZMS files
+static void putU16(char *buf, uint16_t val)
+{
+	buf[0] = (char)(val & 0xff);
+	buf[1] = (char)(val >> 8);
+}
+
+static uint16_t getU16(const char *buf)
+{
+	return (uint16_t)((unsigned char)buf[0] | ((unsigned char)buf[1] << 8));
+}
+
+static void putU32(char *buf, uint32_t val)
+{
+	for (int i = 0; i < 4; i++)
+		buf[i] = (char)((val >> (8 * i)) & 0xff);
+}
+
+static uint32_t getU32(const char *buf)
+{
+	uint32_t val = 0;
+	for (int i = 0; i < 4; i++)
+		val |= (uint32_t)(unsigned char)buf[i] << (8 * i);
+	return val;
+}
+
+static void putU64(char *buf, uint64_t val)
+{
+	for (int i = 0; i < 8; i++)
+		buf[i] = (char)((val >> (8 * i)) & 0xff);
+}
+
+static uint64_t getU64(const char *buf)
+{
+	uint64_t val = 0;
+	for (int i = 0; i < 8; i++)
+		val |= (uint64_t)(unsigned char)buf[i] << (8 * i);
+	return val;
+}
+
+static void putFloat(char *buf, float val)
+{
+	uint32_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	putU32(buf, bits);
+}
+
+static float getFloat(const char *buf)
+{
+	const uint32_t bits = getU32(buf);
+	float val;
+	memcpy(&val, &bits, sizeof(val));
+	return val;
+}
+
+void telemetryEncode(const TelemetryFrame &frame, vector<char> &buf)
+{
+	const size_t objectCount = frame.objects.size();
+	buf.resize(ZV_TELEMETRY_HEADER_SIZE + objectCount * ZV_TELEMETRY_OBJECT_SIZE);
+
+	char *p = &buf[0];
+	memset(p, 0, ZV_TELEMETRY_HEADER_SIZE);
+	memcpy(p, ZV_TELEMETRY_MAGIC, 2);
+	p[2] = (char)ZV_TELEMETRY_VERSION;
+	p[3] = (char)(frame.objectsValid ? ZV_TELEMETRY_OBJECTS_VALID : 0);
+	putU32(p + 4, frame.frameNumber);
+	putU64(p + 8, (uint64_t)frame.timestamp);
+	putFloat(p + 16, frame.goalDist);
+	putFloat(p + 20, frame.goalAngle);
+	putU16(p + 24, (uint16_t)objectCount);
+	putU16(p + 26, (uint16_t)ZV_TELEMETRY_OBJECT_SIZE);
+
+	p += ZV_TELEMETRY_HEADER_SIZE;
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		const TelemetryObject &obj = frame.objects[i];
+		putFloat(p,      obj.ratio);
+		putFloat(p + 4,  obj.x);
+		putFloat(p + 8,  obj.y);
+		putFloat(p + 12, obj.z);
+		p += ZV_TELEMETRY_OBJECT_SIZE;
+	}
+}
+
+bool telemetryDecode(const char *buf, size_t len, TelemetryFrame &frame)
+{
+	if ((len < ZV_TELEMETRY_HEADER_SIZE) ||
+		memcmp(buf, ZV_TELEMETRY_MAGIC, 2) ||
+		((uint8_t)buf[2] != ZV_TELEMETRY_VERSION))
+		return false;
+
+	const size_t objectCount = getU16(buf + 24);
+	const size_t objectSize  = getU16(buf + 26);
+	if ((objectSize < ZV_TELEMETRY_OBJECT_SIZE) ||
+		(len < ZV_TELEMETRY_HEADER_SIZE + objectCount * objectSize))
+		return false;
+
+	frame.objectsValid = (buf[3] & ZV_TELEMETRY_OBJECTS_VALID) != 0;
+	frame.frameNumber  = getU32(buf + 4);
+	frame.timestamp    = (int64_t)getU64(buf + 8);
+	frame.goalDist     = getFloat(buf + 16);
+	frame.goalAngle    = getFloat(buf + 20);
+
+	frame.objects.resize(objectCount);
+	const char *p = buf + ZV_TELEMETRY_HEADER_SIZE;
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		TelemetryObject &obj = frame.objects[i];
+		obj.ratio = getFloat(p);
+		obj.x     = getFloat(p + 4);
+		obj.y     = getFloat(p + 8);
+		obj.z     = getFloat(p + 12);
+		p += objectSize;
+	}
+	return true;
+}
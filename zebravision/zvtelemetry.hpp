@@ -0,0 +1,74 @@
+// Binary telemetry messages published by zv over ZMQ.
+//
+// Each processed frame is sent as a single message with
+// a fixed size header followed by one fixed size record
+// per tracked object :
+//
+//   offset  size  field
+//   0       2     magic "ZV"
+//   2       1     protocol version (ZV_TELEMETRY_VERSION)
+//   3       1     flags - ZV_TELEMETRY_OBJECTS_VALID is set if
+//                 object detection ran for this frame
+//   4       4     frame number
+//   8       8     frame timestamp
+//   16      4     goal distance (float)
+//   20      4     goal angle (float)
+//   24      2     number of object records
+//   26      2     size of each object record in bytes
+//   28      4     reserved, zero
+//   32      ...   object records :
+//                   ratio, x, y, z (floats)
+//
+// All fields are little endian.  Records carry their own size
+// so newer senders can tack fields onto the end of a record
+// without breaking older receivers - they just skip the extra
+// bytes.  Anything which changes existing fields needs a new
+// version number.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+const char     ZV_TELEMETRY_MAGIC[2]      = {'Z', 'V'};
+const uint8_t  ZV_TELEMETRY_VERSION       = 1;
+const uint8_t  ZV_TELEMETRY_OBJECTS_VALID = 0x01;
+const size_t   ZV_TELEMETRY_HEADER_SIZE   = 32;
+const size_t   ZV_TELEMETRY_OBJECT_SIZE   = 16;
+
+struct TelemetryObject
+{
+	float ratio;
+	float x;
+	float y;
+	float z;
+};
+
+struct TelemetryFrame
+{
+	TelemetryFrame(void) :
+		frameNumber(0),
+		timestamp(0),
+		objectsValid(false),
+		goalDist(0),
+		goalAngle(0)
+	{
+	}
+
+	uint32_t frameNumber;
+	int64_t  timestamp;
+	bool     objectsValid;
+	float    goalDist;
+	float    goalAngle;
+	std::vector<TelemetryObject> objects;
+};
+
+// Build a message from a frame's data.  buf is resized
+// to fit - reusing the same buffer each frame means no
+// allocation once it has grown big enough
+void telemetryEncode(const TelemetryFrame &frame, std::vector<char> &buf);
+
+// Parse a received message.  Returns false if it isn't
+// a telemetry message, is from an unknown protocol version
+// or is truncated
+bool telemetryDecode(const char *buf, size_t len, TelemetryFrame &frame);